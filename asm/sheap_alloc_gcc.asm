@@ -3,6 +3,7 @@
 	.global sheap_malloc_lr
 	.global sheap_calloc_lr
 	.global sheap_free_lr
+	.global sheap_realloc_lr
 
 
 sheap_malloc_lr:
@@ -35,5 +36,15 @@ sheap_free_lr:
 
 	.endfunc
 
+sheap_realloc_lr:
+	.func
+
+	push       {r1, r2, lr}
+	mov        r2, lr
+	bl         sheap_realloc
+	pop        {r1, r2, pc}
+
+	.endfunc
+
 
 	.end
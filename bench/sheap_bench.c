@@ -0,0 +1,330 @@
+/** @file sheap_bench.c
+ *  @brief Host benchmark of the sheap allocator (see README.md).
+ *
+ *  Each workload is generated into a list of operations first, then replayed twice on a freshly initialized heap:
+ *  	1. timed pass: only the sheap calls, the time per operation is measured with the monotonic clock of the host
+ *  	2. metric pass: the heap statistic is sampled after each operation (fragmentation, metadata overhead), the visited
+ *  	   blocks per allocation are taken from the latency statistic
+ *  Both passes execute the same operations, the results of all allocator configurations are therefore comparable.
+ *
+ *  @author JK
+ *  @bug No known bugs.
+ */
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "sheap.h"
+
+#ifndef BENCH_HEAP_SIZE
+	#define BENCH_HEAP_SIZE				(256 * 1024)
+#endif
+#define BENCH_MAX_SLOTS					4096
+#define BENCH_MAX_OPS					(1024 * 1024)
+#define BENCH_SEED						12345u
+
+typedef enum{
+	BENCH_OP_ALLOC,
+	BENCH_OP_FREE
+} bench_opType_t;
+
+typedef struct{
+	uint8_t		type;
+	uint16_t	slot;
+	uint32_t	size;
+} bench_op_t;
+
+typedef struct{
+	const char*	name;
+	bench_op_t*	ops;
+	uint32_t	count;
+} bench_workload_t;
+
+typedef struct{
+	double		nsPerOp;
+	uint32_t	meanBlocksVisited;
+	uint32_t	maxBlocksVisited;
+	double		peakFragmentation;
+	double		overheadAtPeak;
+	uint32_t	failedAllocations;
+	uint32_t	asserts;
+} bench_result_t;
+
+static uint32_t gHeap[BENCH_HEAP_SIZE / sizeof(uint32_t)];
+static void* gSlots[BENCH_MAX_SLOTS];
+static uint32_t gRandom = BENCH_SEED;
+static uint32_t gAsserts;
+
+static void assertionCallback(sheaperd_assertion_t assert, char msg[]){
+	if(assert != SHEAP_OUT_OF_MEMORY){
+		gAsserts++;
+		fprintf(stderr, "assert %d: %s\n", assert, msg);
+	}
+}
+
+static uint32_t nextRandom(){
+	// xorshift32, the workloads must not depend on the rand() of the host
+	gRandom ^= gRandom << 13;
+	gRandom ^= gRandom >> 17;
+	gRandom ^= gRandom << 5;
+	return gRandom;
+}
+
+static uint32_t randomRange(uint32_t min, uint32_t max){
+	return min + nextRandom() % (max - min + 1);
+}
+
+static bench_workload_t newWorkload(const char* name){
+	bench_workload_t workload = { name, malloc(BENCH_MAX_OPS * sizeof(bench_op_t)), 0 };
+	if(workload.ops == NULL){
+		fprintf(stderr, "out of host memory\n");
+		exit(1);
+	}
+	return workload;
+}
+
+static void addOp(bench_workload_t* workload, bench_opType_t type, uint32_t slot, uint32_t size){
+	if(workload->count < BENCH_MAX_OPS && slot < BENCH_MAX_SLOTS){
+		workload->ops[workload->count].type = type;
+		workload->ops[workload->count].slot = slot;
+		workload->ops[workload->count].size = size;
+		workload->count++;
+	}
+}
+
+/* few fixed message sizes, random alloc/free with up to 512 live blocks */
+static bench_workload_t generateFixedChurn(){
+	static const uint32_t sizes[] = { 16, 32, 64, 128 };
+	bench_workload_t workload = newWorkload("fixed churn");
+	bool live[512] = { false };
+	for(uint32_t i = 0; i < 200000; i++){
+		uint32_t slot = nextRandom() % 512;
+		addOp(&workload, live[slot] ? BENCH_OP_FREE : BENCH_OP_ALLOC, slot, sizes[nextRandom() % 4]);
+		live[slot] = !live[slot];
+	}
+	for(uint32_t slot = 0; slot < 512; slot++){
+		if(live[slot]){
+			addOp(&workload, BENCH_OP_FREE, slot, 0);
+		}
+	}
+	return workload;
+}
+
+/* messages of random size are queued (up to 512) and freed in allocation order, the queue length varies */
+static bench_workload_t generateProducerConsumer(){
+	bench_workload_t workload = newWorkload("producer/consumer");
+	uint32_t head = 0;
+	uint32_t tail = 0;
+	for(uint32_t i = 0; i < 200000; i++){
+		uint32_t queued = head - tail;
+		bool produce = queued == 0 || (queued < 512 && nextRandom() % 100 < 52);
+		if(produce){
+			addOp(&workload, BENCH_OP_ALLOC, head % 1024, randomRange(8, 512));
+			head++;
+		} else {
+			addOp(&workload, BENCH_OP_FREE, tail % 1024, 0);
+			tail++;
+		}
+	}
+	while(tail != head){
+		addOp(&workload, BENCH_OP_FREE, tail % 1024, 0);
+		tail++;
+	}
+	return workload;
+}
+
+/* 384 long lived blocks (rarely replaced) and bursts of up to 256 temporary blocks freed in random order */
+static bench_workload_t generateLongLivedBurst(){
+	bench_workload_t workload = newWorkload("long lived + burst");
+	uint32_t order[256];
+	for(uint32_t slot = 0; slot < 384; slot++){
+		addOp(&workload, BENCH_OP_ALLOC, slot, randomRange(16, 256));
+	}
+	for(uint32_t burst = 0; burst < 800; burst++){
+		uint32_t count = randomRange(16, 256);
+		for(uint32_t i = 0; i < count; i++){
+			addOp(&workload, BENCH_OP_ALLOC, 384 + i, randomRange(4, 1024));
+			order[i] = 384 + i;
+		}
+		for(uint32_t i = count - 1; i > 0; i--){
+			uint32_t j = nextRandom() % (i + 1);
+			uint32_t swap = order[i];
+			order[i] = order[j];
+			order[j] = swap;
+		}
+		for(uint32_t i = 0; i < count; i++){
+			addOp(&workload, BENCH_OP_FREE, order[i], 0);
+		}
+		uint32_t replaced = nextRandom() % 384;
+		addOp(&workload, BENCH_OP_FREE, replaced, 0);
+		addOp(&workload, BENCH_OP_ALLOC, replaced, randomRange(16, 256));
+	}
+	for(uint32_t slot = 0; slot < 384; slot++){
+		addOp(&workload, BENCH_OP_FREE, slot, 0);
+	}
+	return workload;
+}
+
+/* trace format (one operation per line): 'a <slot> <size>' allocates, 'f <slot>' frees, lines starting with '#' are ignored */
+static bool loadTrace(const char* path, bench_workload_t* workload){
+	FILE* file = fopen(path, "r");
+	if(file == NULL){
+		fprintf(stderr, "cannot open trace '%s'\n", path);
+		return false;
+	}
+	*workload = newWorkload(path);
+	char line[128];
+	uint32_t lineNumber = 0;
+	while(fgets(line, sizeof(line), file) != NULL){
+		lineNumber++;
+		unsigned long slot;
+		unsigned long size;
+		if(line[0] == '#' || line[0] == '\n'){
+			continue;
+		} else if(sscanf(line, "a %lu %lu", &slot, &size) == 2){
+			addOp(workload, BENCH_OP_ALLOC, slot, size);
+		} else if(sscanf(line, "f %lu", &slot) == 1){
+			addOp(workload, BENCH_OP_FREE, slot, 0);
+		} else {
+			fprintf(stderr, "%s:%u: invalid operation\n", path, lineNumber);
+			continue;
+		}
+		if(slot >= BENCH_MAX_SLOTS){
+			fprintf(stderr, "%s:%u: slot exceeds %u\n", path, lineNumber, BENCH_MAX_SLOTS);
+		}
+	}
+	fclose(file);
+	return true;
+}
+
+static void resetHeap(){
+	sheap_init(gHeap, sizeof(gHeap));
+	memset(gSlots, 0, sizeof(gSlots));
+}
+
+static uint32_t replay(const bench_workload_t* workload, bool sample, bench_result_t* result){
+	uint32_t failed = 0;
+	for(uint32_t i = 0; i < workload->count; i++){
+		const bench_op_t* op = &workload->ops[i];
+		if(op->type == BENCH_OP_ALLOC){
+			if(gSlots[op->slot] != NULL){
+				// a trace may reuse a slot without free, the previous block is released first
+				sheap_free(gSlots[op->slot], 0);
+			}
+			gSlots[op->slot] = sheap_malloc(op->size, 0);
+			if(gSlots[op->slot] == NULL){
+				failed++;
+			}
+		} else if(gSlots[op->slot] != NULL){
+			sheap_free(gSlots[op->slot], 0);
+			gSlots[op->slot] = NULL;
+		}
+		if(sample){
+			sheap_heapStat_t stat;
+			sheap_getHeapStatistic(&stat);
+			uint32_t freeBytes = stat.size - stat.totalBytesAllocated;
+			if(freeBytes > 0){
+				double fragmentation = 1.0 - (double)stat.largestFreeBlock / freeBytes;
+				if(fragmentation > result->peakFragmentation){
+					result->peakFragmentation = fragmentation;
+				}
+			}
+			if(stat.totalBytesAllocated == stat.peakTotalBytesAllocated && stat.totalBytesAllocated > 0){
+				result->overheadAtPeak = (double)(stat.totalBytesAllocated - stat.userDataAllocated) / stat.totalBytesAllocated;
+			}
+		}
+	}
+	for(uint32_t slot = 0; slot < BENCH_MAX_SLOTS; slot++){
+		if(gSlots[slot] != NULL){
+			sheap_free(gSlots[slot], 0);
+			gSlots[slot] = NULL;
+		}
+	}
+	return failed;
+}
+
+static bench_result_t runWorkload(const bench_workload_t* workload){
+	bench_result_t result = { 0 };
+	struct timespec start, end;
+
+	resetHeap();
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	result.failedAllocations = replay(workload, false, &result);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	double ns = (end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec);
+	result.nsPerOp = workload->count > 0 ? ns / workload->count : 0;
+
+	uint32_t asserts = gAsserts;
+	resetHeap();
+	replay(workload, true, &result);
+	sheap_latencyStatistic_t latency;
+	sheap_getLatencyStatistic(&latency);
+	result.meanBlocksVisited = latency.malloc.meanBlocksVisited;
+	result.maxBlocksVisited = latency.malloc.maxBlocksVisited;
+	result.asserts = gAsserts - asserts;
+	return result;
+}
+
+static const char* getStrategyName(){
+#if SHEAPERD_SHEAP_MEMORY_ALLOCATION_STRATEGY == SHEAPERD_SHEAP_MEMORY_ALLOCATION_FIRST_FIT
+	return "first fit";
+#elif SHEAPERD_SHEAP_MEMORY_ALLOCATION_STRATEGY == SHEAPERD_SHEAP_MEMORY_ALLOCATION_TLSF
+	return "TLSF";
+#elif SHEAPERD_SHEAP_MEMORY_ALLOCATION_STRATEGY == SHEAPERD_SHEAP_MEMORY_ALLOCATION_NEXT_FIT
+	return "next fit";
+#elif SHEAPERD_SHEAP_MEMORY_ALLOCATION_STRATEGY == SHEAPERD_SHEAP_MEMORY_ALLOCATION_BEST_FIT
+	return "best fit";
+#endif
+}
+
+static const char* getIntegrityName(){
+#if SHEAPERD_SHEAP_INTEGRITY_LEVEL == SHEAPERD_SHEAP_INTEGRITY_NONE
+	return "none";
+#elif SHEAPERD_SHEAP_INTEGRITY_LEVEL == SHEAPERD_SHEAP_INTEGRITY_CANARY
+	return "canary";
+#elif SHEAPERD_SHEAP_INTEGRITY_LEVEL == SHEAPERD_SHEAP_INTEGRITY_CRC16
+	return "CRC16";
+#elif SHEAPERD_SHEAP_INTEGRITY_LEVEL == SHEAPERD_SHEAP_INTEGRITY_CRC32
+	return "CRC32";
+#endif
+}
+
+int main(int argc, char* argv[]){
+	sheaperd_init(assertionCallback);
+	printf("strategy: %s, header: %s, boundary tags: %s, check word: %s, heap: %u bytes\n", getStrategyName(),
+			SHEAPERD_SHEAP_USE_EXTENDED_HEADER == 1 ? "extended" : "without id",
+			SHEAPERD_SHEAP_COMPACT_HEADER == 1 ? "free blocks" : "all blocks", getIntegrityName(), (unsigned)BENCH_HEAP_SIZE);
+	printf("%-24s %9s %8s %12s %11s %10s %10s %8s\n", "workload", "ops", "ns/op", "visited avg", "visited max", "peak frag", "overhead", "failed");
+
+	bench_workload_t workloads[3 + 16];
+	uint32_t count = 0;
+	if(argc > 1){
+		for(int i = 1; i < argc && count < sizeof(workloads) / sizeof(workloads[0]); i++){
+			if(loadTrace(argv[i], &workloads[count])){
+				count++;
+			}
+		}
+	} else {
+		workloads[count++] = generateFixedChurn();
+		workloads[count++] = generateProducerConsumer();
+		workloads[count++] = generateLongLivedBurst();
+	}
+
+	int status = 0;
+	for(uint32_t i = 0; i < count; i++){
+		bench_result_t result = runWorkload(&workloads[i]);
+		printf("%-24s %9u %8.1f %12u %11u %9.1f%% %9.1f%% %8u\n", workloads[i].name, workloads[i].count, result.nsPerOp,
+				result.meanBlocksVisited, result.maxBlocksVisited, 100.0 * result.peakFragmentation, 100.0 * result.overheadAtPeak,
+				result.failedAllocations);
+		if(result.asserts > 0){
+			printf("%-24s %u assertions\n", "", result.asserts);
+			status = 1;
+		}
+		free(workloads[i].ops);
+	}
+	return status;
+}
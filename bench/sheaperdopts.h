@@ -0,0 +1,31 @@
+/*
+ * sheaperdopts.h
+ *
+ *  Host configuration of the sheap benchmark (see README.md). Placed before ../inc in the include path, so it replaces the
+ *  target configuration. The strategy and the header layout can be given on the command line.
+ */
+
+#ifndef SHEAPERDOPTS_H_
+#define SHEAPERDOPTS_H_
+
+#define SHEAPERD_SHEAP 									1
+#define SHEAPERD_NO_OS 									1
+#define SHEAPERD_STACK_GUARD 							0
+#define SHEAPERD_DISABLE_CORTEXM3_M4_WRITE_BUFFERING 	0
+
+/* no interrupts on the host: disableIRQs/enableIRQs are empty, the ISR check does not read the IPSR */
+#define SHEAPERD_SHEAP_DISABLE_IRQS         			0
+#define SHEAPERD_IS_ISR_CONTEXT()						0
+
+#ifndef SHEAPERD_SHEAP_MEMORY_ALLOCATION_STRATEGY
+	#define SHEAPERD_SHEAP_MEMORY_ALLOCATION_STRATEGY	SHEAPERD_SHEAP_MEMORY_ALLOCATION_FIRST_FIT
+#endif
+#ifndef SHEAPERD_SHEAP_USE_EXTENDED_HEADER
+	#define SHEAPERD_SHEAP_USE_EXTENDED_HEADER  		1
+#endif
+
+/* only the visited block count of the latency statistic is used, the time is measured by the driver */
+#define SHEAPERD_SHEAP_LATENCY_STATISTIC				1
+#define SHEAPERD_GET_CYCLE_COUNT()						0u
+
+#endif /* SHEAPERDOPTS_H_ */
@@ -11,17 +11,48 @@
 //included first so any user settings take precedence
 #include "sheaperdopts.h"
 
+/* Lock of the sheap instances, the pools and the stackguard:
+ * 	+ CMSIS:	CMSIS mutex ('SHEAPERD_CMSIS_1' or 'SHEAPERD_CMSIS_2'), see port/cmsis_ti_rtos.c for a CMSIS port
+ * 	+ FREERTOS, ZEPHYR, THREADX, TIRTOS: native lock of the rtos without the CMSIS layer (port/lock_<rtos>.c). A non recursive mutex
+ * 				(binary semaphore) with timeout, or the scheduler is suspended if 'SHEAPERD_LOCK_PORT_SCHEDULER_LOCK' is set (the cheapest
+ * 				lock for the short sheap calls, the locked code never blocks). Interrupt handlers use a non blocking try lock
+ * 				('SHEAPERD_SHEAP_ISR_SAFE')
+ */
+#define SHEAPERD_LOCK_PORT_CMSIS			0
+#define SHEAPERD_LOCK_PORT_FREERTOS			1
+#define SHEAPERD_LOCK_PORT_ZEPHYR			2
+#define SHEAPERD_LOCK_PORT_THREADX			3
+#define SHEAPERD_LOCK_PORT_TIRTOS			4
+#ifndef SHEAPERD_LOCK_PORT
+	#define SHEAPERD_LOCK_PORT				SHEAPERD_LOCK_PORT_CMSIS
+#endif
+#ifndef SHEAPERD_LOCK_PORT_SCHEDULER_LOCK
+	#define SHEAPERD_LOCK_PORT_SCHEDULER_LOCK	0
+#endif
+// semaphore storage of the Zephyr and ThreadX ports: one lock per sheap instance and pool and one for the stackguard
+#ifndef SHEAPERD_LOCK_PORT_MAX_LOCKS
+	#define SHEAPERD_LOCK_PORT_MAX_LOCKS	4
+#endif
+
 #if SHEAPERD_NO_OS == 0
 	#if SHEAPERD_CMSIS_1 == 1
 		#include <cmsis_os.h>
 	#elif SHEAPERD_CMSIS_2 == 1
 		#include <cmsis_os2.h>
-	#elif SHEAPERD_CMSIS_1 == 0 && SHEAPERD_CMSIS_2 == 0
+	#elif SHEAPERD_CMSIS_1 == 0 && SHEAPERD_CMSIS_2 == 0 && SHEAPERD_LOCK_PORT == SHEAPERD_LOCK_PORT_CMSIS
 		#define SHEAPERD_NO_OS 1
 	#endif
 #endif
 
-#if SHEAPERD_STACK_GUARD == 0
+// the native lock takes precedence over the CMSIS mutex
+#if SHEAPERD_NO_OS == 0 && SHEAPERD_LOCK_PORT != SHEAPERD_LOCK_PORT_CMSIS
+	#define SHEAPERD_USE_LOCK_PORT			1
+#else
+	#define SHEAPERD_USE_LOCK_PORT			0
+#endif
+
+// the MPU type is also needed by the guarded allocations of the sheap
+#if SHEAPERD_STACK_GUARD == 0 && SHEAPERD_SHEAP_GUARDED_ALLOCATIONS != 1
 	#define SHEAPERD_STACK_GUARD 			0
 	#define SHEAPERD_MPU_M0PLUS				0
 	#define SHEAPERD_MPU_M3_M4_M7			0
@@ -51,6 +82,46 @@
     #define SHEAPERD_SHEAP_DISABLE_IRQS 0
 #endif
 
+/* Critical section of the sheap calls if 'SHEAPERD_SHEAP_DISABLE_IRQS' is set. The previous mask is restored on exit, so sheap calls
+ * can be nested in critical sections of the application (or the RTOS):
+ * 	+ PRIMASK:	all interrupts are disabled (cpsid i)
+ * 	+ BASEPRI:	only interrupts with a priority value >= 'SHEAPERD_SHEAP_BASEPRI_MASK' are masked, interrupts with a higher priority
+ * 				keep running (not available on ARMv6-M). ATTENTION: these interrupt handlers must not call any sheap function
+ * The stackguard and the guarded allocations update their MPU regions in this critical section, the task switch handler which calls
+ * 'stackguard_taskSwitchInHandle' (e.g. PendSV) must be masked by it.
+ */
+#define SHEAPERD_CRITICAL_SECTION_PRIMASK	1
+#define SHEAPERD_CRITICAL_SECTION_BASEPRI	2
+#ifndef SHEAPERD_SHEAP_CRITICAL_SECTION
+	#define SHEAPERD_SHEAP_CRITICAL_SECTION		SHEAPERD_CRITICAL_SECTION_PRIMASK
+#endif
+/* Already shifted to the implemented priority bits, e.g. 0x50 is priority 5 with 4 priority bits */
+#ifndef SHEAPERD_SHEAP_BASEPRI_MASK
+	#define SHEAPERD_SHEAP_BASEPRI_MASK			0x50
+#endif
+#if SHEAPERD_SHEAP_CRITICAL_SECTION == SHEAPERD_CRITICAL_SECTION_BASEPRI && SHEAPERD_ARMV6 == 1
+	#error "BASEPRI is not available on ARMv6-M, use SHEAPERD_CRITICAL_SECTION_PRIMASK"
+#endif
+
+/* The busy flags detecting overlapping sheap calls are claimed with LDREX/STREX (ARMv7-M/ARMv8-M mainline) instead of a plain
+ * read-modify-write. Required if no critical section is used ('SHEAPERD_SHEAP_DISABLE_IRQS' 0) and sheap is called from interrupts */
+#ifndef SHEAPERD_SHEAP_ATOMIC_BUSY_FLAGS
+	#define SHEAPERD_SHEAP_ATOMIC_BUSY_FLAGS	0
+#endif
+#if SHEAPERD_SHEAP_ATOMIC_BUSY_FLAGS == 1 && SHEAPERD_ARMV6 == 1
+	#error "LDREX/STREX are not available on ARMv6-M, use SHEAPERD_SHEAP_DISABLE_IRQS instead"
+#endif
+
+/* Calls from an interrupt handler do not acquire the mutex (an ISR must not block), they are only serialized by the busy flags.
+ * Every locked call (also free and the statistic getters) holds the heap exclusively. If the heap is busy the call returns without
+ * result (NULL, SHEAP_BUSY) instead of asserting an overlapping call */
+#ifndef SHEAPERD_SHEAP_ISR_SAFE
+	#define SHEAPERD_SHEAP_ISR_SAFE				0
+#endif
+#if SHEAPERD_SHEAP_ISR_SAFE == 1 && SHEAPERD_SHEAP_DISABLE_IRQS == 0 && SHEAPERD_SHEAP_ATOMIC_BUSY_FLAGS == 0
+	#warning "SHEAPERD_SHEAP_ISR_SAFE without critical section should use SHEAPERD_SHEAP_ATOMIC_BUSY_FLAGS"
+#endif
+
 #if SHEAPERD_SHEAP_MINIMUM_MALLOC_SIZE == 0
 	#define SHEAPERD_SHEAP_MINIMUM_MALLOC_SIZE 		4
 #endif
@@ -72,6 +143,30 @@
 	#if STACKGUARD_DEFAULT_TASK_SWITCH_OUT_PERMISSION == 0
 		#define STACKGUARD_DEFAULT_TASK_SWITCH_OUT_PERMISSION MPU_REGION_PRIVELEGED_RO
 	#endif
+	/* ARMv8-M: memory attributes of the stack regions, MAIR[STACKGUARD_MPU_ATTRIBUTE_INDEX] is set by 'stackguard_init' */
+	#ifndef STACKGUARD_MPU_ATTRIBUTE_INDEX
+		#define STACKGUARD_MPU_ATTRIBUTE_INDEX				0
+	#endif
+	#ifndef STACKGUARD_MPU_ATTRIBUTES
+		#define STACKGUARD_MPU_ATTRIBUTES					MPU_MAIR_NORMAL_WRITE_THROUGH
+	#endif
+	/* high watermark: stacks are painted with the pattern when added ('stackguard_paintStack' otherwise), the scan takes a probe of
+	 * STACKGUARD_WATERMARK_PROBE_WORDS painted words as unused stack */
+	#ifndef STACKGUARD_PAINT_STACK_ON_ADD
+		#define STACKGUARD_PAINT_STACK_ON_ADD				0
+	#endif
+	#ifndef STACKGUARD_STACK_PAINT_PATTERN
+		#define STACKGUARD_STACK_PAINT_PATTERN				0xA5A5A5A5ul
+	#endif
+	#ifndef STACKGUARD_WATERMARK_PROBE_WORDS
+		#define STACKGUARD_WATERMARK_PROBE_WORDS			4
+	#endif
+	#if STACKGUARD_WATERMARK_PROBE_WORDS == 0
+		#error "'STACKGUARD_WATERMARK_PROBE_WORDS' has to be at least 1"
+	#endif
+	#if STACKGUARD_USE_MEMFAULT_HANDLER == 1 && SHEAPERD_MPU_M23 == 1
+		#error "The Cortex-M23 has no MemManage fault, disable 'STACKGUARD_USE_MEMFAULT_HANDLER'"
+	#endif
 #endif
 
 #define ASSERT_TYPE(TYPE, VALUE) ((TYPE){ 0 } = (VALUE))
@@ -103,12 +198,32 @@ do { 													\
 	#define SHEAPERD_DEFAULT_MUTEX_WAIT_TICKS			100
 #endif
 
-// TODO: implement logic in sheap.c
+/* See sheap.c for a description and a comparison of the allocation strategies */
 #define SHEAPERD_SHEAP_MEMORY_ALLOCATION_FIRST_FIT			1
+#define SHEAPERD_SHEAP_MEMORY_ALLOCATION_TLSF				2
+#define SHEAPERD_SHEAP_MEMORY_ALLOCATION_NEXT_FIT			3
+#define SHEAPERD_SHEAP_MEMORY_ALLOCATION_BEST_FIT			4
 #ifndef SHEAPERD_SHEAP_MEMORY_ALLOCATION_STRATEGY
 	#define SHEAPERD_SHEAP_MEMORY_ALLOCATION_STRATEGY  		SHEAPERD_SHEAP_MEMORY_ALLOCATION_FIRST_FIT
 #endif
 
+#if SHEAPERD_SHEAP_MEMORY_ALLOCATION_STRATEGY == SHEAPERD_SHEAP_MEMORY_ALLOCATION_TLSF
+	/* Number of second level size classes per power of two (log2). The second level bitmap is a uint32_t, therefore at most 5 */
+	#ifndef SHEAPERD_SHEAP_TLSF_SL_INDEX_COUNT_LOG2
+		#define SHEAPERD_SHEAP_TLSF_SL_INDEX_COUNT_LOG2		4
+	#endif
+	/* Free blocks must be smaller than 2 ^ SHEAPERD_SHEAP_TLSF_FL_INDEX_MAX bytes. The size of the bin table grows with this value */
+	#ifndef SHEAPERD_SHEAP_TLSF_FL_INDEX_MAX
+		#define SHEAPERD_SHEAP_TLSF_FL_INDEX_MAX			20
+	#endif
+	#if SHEAPERD_SHEAP_TLSF_SL_INDEX_COUNT_LOG2 > 5
+		#error "SHEAPERD_SHEAP_TLSF_SL_INDEX_COUNT_LOG2 must not be greater than 5"
+	#endif
+	#if SHEAPERD_SHEAP_TLSF_FL_INDEX_MAX > 31
+		#error "SHEAPERD_SHEAP_TLSF_FL_INDEX_MAX must not be greater than 31"
+	#endif
+#endif
+
 #ifndef SHEAPERD_SHEAP_USE_EXTENDED_HEADER
 	#define SHEAPERD_SHEAP_USE_EXTENDED_HEADER				1
 #endif
@@ -119,9 +234,213 @@ do { 													\
     #endif
 #endif
 
-//TODO: implement logic in sheap.c
-#define SHEAPERD_SHEAP_CHECK_ALL_BLOCKS_ON_FREE		0
-#define SHEAPERD_SHEAP_CHECK_ALL_BLOCKS_ON_MALLOC	0
+/* Compact block layout: allocated blocks only carry the header, the boundary tag is written for free blocks only (within the last bytes
+ * of the free payload). The header holds a "previous block free" flag, the boundary tag of the previous block is only read if it is set.
+ * Saves sizeof(header) (8 or 12 bytes) per allocated block, the out of bound detection of an allocated block relies on the header CRC
+ * of the next block */
+#ifndef SHEAPERD_SHEAP_COMPACT_HEADER
+	#define SHEAPERD_SHEAP_COMPACT_HEADER					0
+#endif
+
+/* Check word stored in the header and boundary tag of each block:
+ * 	+ NONE:		the blocks are not checked, the check word is kept as padding
+ * 	+ CANARY:	16 bit XOR of the header half words and SHEAPERD_SHEAP_CANARY_VALUE. Detects overwritten headers, but not all multi bit errors
+ * 	+ CRC16:	CRC-16/CCITT-FALSE calculated with the SHEAPERD_CRC16_BACKEND
+ * 	+ CRC32:	CRC-32 (SHEAPERD_CRC32_POLY, bitwise), the check word and the alignment offset are 32 bit wide (header +4 bytes) */
+#define SHEAPERD_SHEAP_INTEGRITY_NONE					0
+#define SHEAPERD_SHEAP_INTEGRITY_CANARY					1
+#define SHEAPERD_SHEAP_INTEGRITY_CRC16					2
+#define SHEAPERD_SHEAP_INTEGRITY_CRC32					3
+#ifndef SHEAPERD_SHEAP_INTEGRITY_LEVEL
+	#define SHEAPERD_SHEAP_INTEGRITY_LEVEL				SHEAPERD_SHEAP_INTEGRITY_CRC16
+#endif
+#if SHEAPERD_SHEAP_INTEGRITY_LEVEL < SHEAPERD_SHEAP_INTEGRITY_NONE || SHEAPERD_SHEAP_INTEGRITY_LEVEL > SHEAPERD_SHEAP_INTEGRITY_CRC32
+	#error "Invalid 'SHEAPERD_SHEAP_INTEGRITY_LEVEL'"
+#endif
+#ifndef SHEAPERD_SHEAP_CANARY_VALUE
+	#define SHEAPERD_SHEAP_CANARY_VALUE					0xA53C
+#endif
+
+/* Per task allocation caches: allocations up to the largest size class are served from a magazine of the calling task without
+ * acquiring the sheap mutex or disabling irqs. Magazines are refilled from and drained to the sheap in batches. A cached allocation
+ * is accounted with the size of its class.
+ * Size classes: SHEAPERD_SHEAP_TASK_CACHE_MIN_CLASS_SIZE * 2^n (n = 0 .. SHEAPERD_SHEAP_TASK_CACHE_CLASSES - 1) */
+#ifndef SHEAPERD_SHEAP_TASK_CACHE
+	#define SHEAPERD_SHEAP_TASK_CACHE						0
+#endif
+#if SHEAPERD_SHEAP_TASK_CACHE == 1
+	#ifndef SHEAPERD_SHEAP_TASK_CACHE_TASKS
+		#define SHEAPERD_SHEAP_TASK_CACHE_TASKS				8
+	#endif
+	#ifndef SHEAPERD_SHEAP_TASK_CACHE_CLASSES
+		#define SHEAPERD_SHEAP_TASK_CACHE_CLASSES			4
+	#endif
+	#ifndef SHEAPERD_SHEAP_TASK_CACHE_MIN_CLASS_SIZE
+		#define SHEAPERD_SHEAP_TASK_CACHE_MIN_CLASS_SIZE	16
+	#endif
+	#ifndef SHEAPERD_SHEAP_TASK_CACHE_DEPTH
+		#define SHEAPERD_SHEAP_TASK_CACHE_DEPTH				8
+	#endif
+	#ifndef SHEAPERD_SHEAP_TASK_CACHE_BATCH
+		#define SHEAPERD_SHEAP_TASK_CACHE_BATCH				(SHEAPERD_SHEAP_TASK_CACHE_DEPTH / 2)
+	#endif
+	#if SHEAPERD_SHEAP_TASK_CACHE_BATCH > SHEAPERD_SHEAP_TASK_CACHE_DEPTH || SHEAPERD_SHEAP_TASK_CACHE_BATCH == 0
+		#error "SHEAPERD_SHEAP_TASK_CACHE_BATCH must be in the range 1 .. SHEAPERD_SHEAP_TASK_CACHE_DEPTH"
+	#endif
+#endif
+
+/* Arenas ('sheap_arena_create'): an exhausted arena allocates a growth chunk of at least its capacity from the sheap, the chunks are freed
+ * by 'sheap_arena_reset' (SHEAPERD_SHEAP_ARENA_GROWTH). A canary after the object memory of the arena and of each chunk is checked by
+ * 'sheap_arena_reset' and 'sheap_arena_destroy' (SHEAPERD_SHEAP_ARENA_CANARY) */
+#ifndef SHEAPERD_SHEAP_ARENA_GROWTH
+	#define SHEAPERD_SHEAP_ARENA_GROWTH					1
+#endif
+#ifndef SHEAPERD_SHEAP_ARENA_CANARY
+	#define SHEAPERD_SHEAP_ARENA_CANARY					1
+#endif
+
+/* Pool routing of the C++ adapters (sheap.hpp): objects with a compile time size up to the largest size class are taken from the pool
+ * bound to their size class ('sheap::bind_pool'). Size classes: powers of two from SHEAPERD_CPP_POOL_MIN_CLASS_SIZE to
+ * SHEAPERD_CPP_POOL_MAX_CLASS_SIZE */
+#ifndef SHEAPERD_CPP_POOL_MIN_CLASS_SIZE
+	#define SHEAPERD_CPP_POOL_MIN_CLASS_SIZE			8
+#endif
+#ifndef SHEAPERD_CPP_POOL_MAX_CLASS_SIZE
+	#define SHEAPERD_CPP_POOL_MAX_CLASS_SIZE			256
+#endif
+
+/* Checks all blocks of the heap on each free/malloc call. The time of each call grows with the number of blocks, use 'sheap_scrub_step'
+ * (e.g. from the idle hook) for an incremental check instead. If an invalid block is found (and the assert returns), the call returns
+ * without allocation or without freeing: the blocks to be freed are not written into the altered heap and stay allocated */
+#ifndef SHEAPERD_SHEAP_CHECK_ALL_BLOCKS_ON_FREE
+	#define SHEAPERD_SHEAP_CHECK_ALL_BLOCKS_ON_FREE		0
+#endif
+#ifndef SHEAPERD_SHEAP_CHECK_ALL_BLOCKS_ON_MALLOC
+	#define SHEAPERD_SHEAP_CHECK_ALL_BLOCKS_ON_MALLOC	0
+#endif
+
+/* sheap_init only writes the header and the boundary of the initial free block instead of overwriting the whole heap. The block is marked
+ * as not overwritten (as a deferred overwrite on free), it is overwritten by 'sheap_scrub_step' and an allocation from it only overwrites the
+ * unused bytes after the requested size. Intended for large heaps in external memory, needs SHEAPERD_SHEAP_DEFER_OVERWRITE_ON_FREE */
+#ifndef SHEAPERD_SHEAP_LAZY_INIT
+	#define SHEAPERD_SHEAP_LAZY_INIT					0
+#endif
+
+/* The overwrite of freed payloads (SHEAPERD_SHEAP_OVERWRITE_ON_FREE) is not done within the free call but by 'sheap_scrub_step' */
+#ifndef SHEAPERD_SHEAP_DEFER_OVERWRITE_ON_FREE
+	#define SHEAPERD_SHEAP_DEFER_OVERWRITE_ON_FREE		SHEAPERD_SHEAP_LAZY_INIT
+#endif
+#if SHEAPERD_SHEAP_LAZY_INIT == 1 && SHEAPERD_SHEAP_DEFER_OVERWRITE_ON_FREE == 0
+	#error "SHEAPERD_SHEAP_LAZY_INIT needs SHEAPERD_SHEAP_DEFER_OVERWRITE_ON_FREE"
+#endif
+/* Bytes of a not yet overwritten free block which are overwritten per block step of 'sheap_scrub_step' (0: the whole block). A large block
+ * is overwritten from its end over several steps, the progress is kept while the end of the block does not change */
+#ifndef SHEAPERD_SHEAP_SCRUB_OVERWRITE_CHUNK
+	#define SHEAPERD_SHEAP_SCRUB_OVERWRITE_CHUNK		4096
+#endif
+
+/* MPU guarded allocations ('sheap_malloc_guarded'): the requested size of the allocation ends at a 32 byte no access MPU region, an
+ * overflow faults at the writing instruction (MemManage, HardFault on Cortex-M23). SHEAPERD_SHEAP_GUARD_SLOTS allocations (default instance)
+ * are guarded at the same time, slot n uses the MPU region SHEAPERD_SHEAP_GUARD_FIRST_MPU_REGION + n. 'sheap_malloc' guards every
+ * SHEAPERD_SHEAP_GUARD_SAMPLE_INTERVAL th allocation (0: none) and the allocations with the id set by 'sheap_guard_setSuspectId' while a
+ * slot is free. Needs an ARMv7-M or ARMv8-M MPU (SHEAPERD_MPU_*), the MPU is enabled by the application or the stackguard */
+#ifndef SHEAPERD_SHEAP_GUARDED_ALLOCATIONS
+	#define SHEAPERD_SHEAP_GUARDED_ALLOCATIONS			0
+#endif
+#if SHEAPERD_SHEAP_GUARDED_ALLOCATIONS == 1
+	#ifndef SHEAPERD_SHEAP_GUARD_SLOTS
+		#define SHEAPERD_SHEAP_GUARD_SLOTS				2
+	#endif
+	#ifndef SHEAPERD_SHEAP_GUARD_FIRST_MPU_REGION
+		#define SHEAPERD_SHEAP_GUARD_FIRST_MPU_REGION	6
+	#endif
+	#ifndef SHEAPERD_SHEAP_GUARD_SAMPLE_INTERVAL
+		#define SHEAPERD_SHEAP_GUARD_SAMPLE_INTERVAL	0
+	#endif
+	/* ARMv8-M: MAIR index of the guard regions, set by 'sheap_init' if the stackguard is not used (which sets its own index) */
+	#ifndef SHEAPERD_SHEAP_GUARD_MPU_ATTRIBUTE_INDEX
+		#if SHEAPERD_STACK_GUARD == 1
+			#define SHEAPERD_SHEAP_GUARD_MPU_ATTRIBUTE_INDEX	STACKGUARD_MPU_ATTRIBUTE_INDEX
+		#else
+			#define SHEAPERD_SHEAP_GUARD_MPU_ATTRIBUTE_INDEX	0
+		#endif
+	#endif
+	#if SHEAPERD_ARMV7 != 1 && SHEAPERD_ARMV8 != 1
+		#error "SHEAPERD_SHEAP_GUARDED_ALLOCATIONS needs an ARMv7-M or ARMv8-M MPU (SHEAPERD_MPU_M3_M4_M7, SHEAPERD_MPU_M23, SHEAPERD_MPU_M33_M35P)"
+	#endif
+	#if SHEAPERD_SHEAP_GUARD_SLOTS == 0 || SHEAPERD_SHEAP_GUARD_FIRST_MPU_REGION + SHEAPERD_SHEAP_GUARD_SLOTS > 16
+		#error "The guard regions SHEAPERD_SHEAP_GUARD_FIRST_MPU_REGION .. + SHEAPERD_SHEAP_GUARD_SLOTS - 1 must be in the range 0 .. 15"
+	#endif
+	#if SHEAPERD_STACK_GUARD == 1 && SHEAPERD_SHEAP_GUARD_FIRST_MPU_REGION < STACKGUARD_NUMBER_OF_MPU_REGIONS
+		#error "The guard regions overlap with the stackguard regions, reduce STACKGUARD_NUMBER_OF_MPU_REGIONS"
+	#endif
+	#ifndef MEMORY_PROTECTION
+		#define MEMORY_PROTECTION						1
+	#endif
+#endif
+
+/* Size classes of 'allocationsPerSizeClass' in sheap_heapStat_t: class 0 counts the requests below 2 * SHEAPERD_SHEAP_MINIMUM_MALLOC_SIZE,
+ * class n the requests of SHEAPERD_SHEAP_MINIMUM_MALLOC_SIZE * 2^n up to SHEAPERD_SHEAP_MINIMUM_MALLOC_SIZE * 2^(n + 1) - 1, the last class all above */
+#ifndef SHEAPERD_SHEAP_STAT_SIZE_CLASSES
+	#define SHEAPERD_SHEAP_STAT_SIZE_CLASSES			12
+#endif
+
+/* Measures the cycles of the allocations and frees (see 'sheap_getLatencyStatistic'). The cycle counter is read with
+ * 'SHEAPERD_GET_CYCLE_COUNT', by default the DWT cycle counter (ARMv7-M/ARMv8-M mainline) which is enabled within 'sheap_init'.
+ * A port can define 'SHEAPERD_GET_CYCLE_COUNT' to use another (incrementing, 32 bit) timer */
+#ifndef SHEAPERD_SHEAP_LATENCY_STATISTIC
+	#define SHEAPERD_SHEAP_LATENCY_STATISTIC			0
+#endif
+#if SHEAPERD_SHEAP_LATENCY_STATISTIC == 1
+	/* Bin n counts the calls with 2^n <= cycles < 2^(n + 1), the last bin all calls above */
+	#ifndef SHEAPERD_SHEAP_LATENCY_HISTOGRAM_BINS
+		#define SHEAPERD_SHEAP_LATENCY_HISTOGRAM_BINS	16
+	#endif
+#endif
+
+/* Records a binary event (sheap_traceEvent_t) for each allocation, reallocation and free into a ring buffer of
+ * SHEAPERD_SHEAP_TRACE_EVENTS entries per instance. The buffer is emptied by 'sheap_trace_drain' (e.g. from the idle hook), either
+ * to the sink set with 'sheap_trace_setSink' or to the ITM stimulus port SHEAPERD_SHEAP_TRACE_ITM_PORT (SWO).
+ * Events are dropped if the buffer is full, a gap of the sequence number shows the loss. The timestamp is read with
+ * 'SHEAPERD_GET_CYCLE_COUNT'. Decoder: tools/sheap_trace_decode.c */
+#ifndef SHEAPERD_SHEAP_TRACE
+	#define SHEAPERD_SHEAP_TRACE						0
+#endif
+#if SHEAPERD_SHEAP_TRACE == 1
+	#ifndef SHEAPERD_SHEAP_TRACE_EVENTS
+		#define SHEAPERD_SHEAP_TRACE_EVENTS				64
+	#endif
+	#if SHEAPERD_SHEAP_TRACE_EVENTS == 0 || (SHEAPERD_SHEAP_TRACE_EVENTS & (SHEAPERD_SHEAP_TRACE_EVENTS - 1)) != 0
+		#error "SHEAPERD_SHEAP_TRACE_EVENTS must be a power of two"
+	#endif
+	/* 0 disables the ITM output, 'sheap_trace_drain' discards the events if no sink is set */
+	#ifndef SHEAPERD_SHEAP_TRACE_USE_ITM
+		#define SHEAPERD_SHEAP_TRACE_USE_ITM			1
+	#endif
+	#ifndef SHEAPERD_SHEAP_TRACE_ITM_PORT
+		#define SHEAPERD_SHEAP_TRACE_ITM_PORT			1
+	#endif
+	#if SHEAPERD_SHEAP_TRACE_ITM_PORT > 31
+		#error "SHEAPERD_SHEAP_TRACE_ITM_PORT must be in the range 0 .. 31"
+	#endif
+	#if SHEAPERD_SHEAP_TRACE_USE_ITM == 1 && SHEAPERD_ARMV6 == 1
+		#error "ARMv6-M has no ITM, set 'SHEAPERD_SHEAP_TRACE_USE_ITM' to 0 and use 'sheap_trace_setSink'"
+	#endif
+	/* calls served by the task cache do not lock the heap and cannot be recorded */
+	#if SHEAPERD_SHEAP_TASK_CACHE == 1
+		#error "SHEAPERD_SHEAP_TRACE cannot be combined with SHEAPERD_SHEAP_TASK_CACHE"
+	#endif
+#endif
+
+#if SHEAPERD_SHEAP_LATENCY_STATISTIC == 1 || SHEAPERD_SHEAP_TRACE == 1
+	#ifndef SHEAPERD_GET_CYCLE_COUNT
+		#define SHEAPERD_GET_CYCLE_COUNT()				(*((volatile uint32_t*)0xE0001004ul))
+		#define SHEAPERD_USE_DWT_CYCLE_COUNTER			1
+	#endif
+	#if SHEAPERD_USE_DWT_CYCLE_COUNTER == 1 && SHEAPERD_ARMV6 == 1
+		#error "ARMv6-M has no DWT cycle counter, define 'SHEAPERD_GET_CYCLE_COUNT' with a timer of the port"
+	#endif
+#endif
 
 #define SHEAPERD_CRC32_POLY				0x04C11DB7
 #define SHEAPERD_CRC32_XOR_OUT			0xFFFFFFFF
@@ -129,4 +448,43 @@ do { 													\
 #define SHEAPERD_CRC16_POLY				0x1021
 #define SHEAPERD_CRC16_XOR_OUT			0x0000
 
+/* Implementation used for the CRC16 of the sheap block headers. All backends calculate the same checksum (CRC-16/CCITT-FALSE):
+ * 	+ BITWISE:	bit serial loop, no lookup table
+ * 	+ TABLE:	one 256 entry lookup table (512 bytes const data)
+ * 	+ NIBBLE:	one 16 entry lookup table (32 bytes const data), two lookups per byte
+ * 	+ WORD:		processes 4 bytes per step using four 256 entry lookup tables (2 KB const data). A 6 byte header takes one word and
+ * 				one half word step, a 10 byte header two word and one half word step
+ * 	+ PORT:		calls 'sheaperd_port_crc16_calculate' which has to be provided by the port, e.g. using a CRC peripheral (see port/crc_stm32.c)
+ */
+#define SHEAPERD_CRC16_BACKEND_BITWISE	1
+#define SHEAPERD_CRC16_BACKEND_TABLE		2
+#define SHEAPERD_CRC16_BACKEND_NIBBLE		3
+#define SHEAPERD_CRC16_BACKEND_WORD		4
+#define SHEAPERD_CRC16_BACKEND_PORT		5
+#ifndef SHEAPERD_CRC16_BACKEND
+	#define SHEAPERD_CRC16_BACKEND			SHEAPERD_CRC16_BACKEND_BITWISE
+#endif
+
+/* Implementation of the memory fills (heap initialization, overwrite of freed blocks, calloc payloads):
+ * 	+ BYTE:		byte loop
+ * 	+ WORD:		word stores after the unaligned head, four words per loop iteration
+ * 	+ BURST:	eight words per loop iteration written by two STM instructions (Cortex-M, e.g. one burst of an external SDRAM)
+ */
+#define SHEAPERD_FILL_KERNEL_BYTE		1
+#define SHEAPERD_FILL_KERNEL_WORD		2
+#define SHEAPERD_FILL_KERNEL_BURST		3
+#ifndef SHEAPERD_FILL_KERNEL
+	#define SHEAPERD_FILL_KERNEL			SHEAPERD_FILL_KERNEL_WORD
+#endif
+
+/* Fills of at least SHEAPERD_DMA_FILL_MIN_SIZE bytes are passed to 'sheaperd_port_dmaFill' which has to be provided by the port, e.g. using
+ * a memory to memory DMA or the register to memory mode of the STM32 DMA2D (see port/fill_stm32_dma2d.c). The bytes not filled by the
+ * port are filled by the CPU. Not used with SHEAPERD_FILL_KERNEL_BYTE */
+#ifndef SHEAPERD_DMA_FILL
+	#define SHEAPERD_DMA_FILL				0
+#endif
+#ifndef SHEAPERD_DMA_FILL_MIN_SIZE
+	#define SHEAPERD_DMA_FILL_MIN_SIZE		1024
+#endif
+
 #endif /* INTERNAL_OPT_H_ */
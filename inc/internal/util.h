@@ -10,6 +10,10 @@
 
 #include "sheaperd.h"
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 typedef enum {
 	ERROR_MUTEX_CREATION_FAILED,
 	ERROR_MUTEX_DELETION_FAILED,
@@ -25,18 +29,183 @@ util_error_t util_initMutex(osMutexId_t* mutexId, const osMutexAttr_t* mutexAttr
 #endif
 
 #if SHEAPERD_CMSIS_1 == 1
+/**
+ * Mutex definition with its own control block (the size of the control block defined by 'osMutexDef'). 'osMutexDef' defines a single
+ * static control block per name, a mutex of each instance of an object has to be created from a definition of its own.
+ */
+typedef struct {
+	osMutexDef_t			def;
+	uint32_t				controlBlock[4];
+} util_mutexDef_t;
+
 util_error_t util_initMutex(const osMutexDef_t* mutexDef, osMutexId* mutexId);
+
+/**
+ * Clears the control block and creates the mutex from the definition @param mutexDef, a mutex created before (@param mutexId not
+ * NULL) is deleted.
+ */
+util_error_t util_initInstanceMutex(util_mutexDef_t* mutexDef, osMutexId* mutexId);
 #endif
 
 #if SHEAPERD_CMSIS_1 == 1
 util_error_t util_acquireMutex(osMutexId mutexId, uint32_t timeout);
 util_error_t util_releaseMutex(osMutexId mutexId);
+util_error_t util_deleteMutex(osMutexId* mutexId);
 #elif SHEAPERD_CMSIS_2 == 1
 util_error_t util_acquireMutex(osMutexId_t mutexId, uint32_t timeout);
 util_error_t util_releaseMutex(osMutexId_t mutexId);
+util_error_t util_deleteMutex(osMutexId_t* mutexId);
 #endif
 
+#if SHEAPERD_USE_LOCK_PORT == 1
+/**
+ * Native rtos lock selected by 'SHEAPERD_LOCK_PORT', implemented by the lock port (port/lock_<rtos>.c). The lock is not recursive.
+ */
+typedef struct {
+	// native semaphore, NULL with 'SHEAPERD_LOCK_PORT_SCHEDULER_LOCK'
+	void*					handle;
+	// scheduler lock: state restored on release (e.g. the previous preemption threshold)
+	uint32_t				key;
+	// scheduler lock: set while the lock is held, tested by the try lock of the interrupt handlers
+	volatile bool			isLocked;
+} sheaperd_portLock_t;
+
+/**
+ * Creates the native lock, a lock created before (handle not NULL) is deleted or reused.
+ *
+ * @return false if the rtos could not create the lock
+ */
+bool sheaperd_port_lockInit(sheaperd_portLock_t* lock, const char* name);
+void sheaperd_port_lockDelete(sheaperd_portLock_t* lock);
+/**
+ * Waits at most @param timeout rtos ticks for the lock, must not be called from interrupt handlers.
+ */
+bool sheaperd_port_lockAcquire(sheaperd_portLock_t* lock, uint32_t timeout);
+void sheaperd_port_lockRelease(sheaperd_portLock_t* lock);
+/**
+ * Acquires the lock without waiting, can be called from interrupt handlers.
+ *
+ * @return false if the lock is held by a task or by a preempted interrupt handler
+ */
+bool sheaperd_port_lockTryAcquireFromISR(sheaperd_portLock_t* lock);
+void sheaperd_port_lockReleaseFromISR(sheaperd_portLock_t* lock);
+/**
+ * Returns the handle of the running task (owner of the sheap task caches).
+ */
+void* sheaperd_port_threadId();
+#endif
+
+/**
+ * Reads the IPSR register.
+ *
+ * @return true if called from an exception/interrupt handler
+ */
+bool util_isInterruptContext();
+
+#if SHEAPERD_SHEAP_DISABLE_IRQS == 1 || SHEAPERD_SHEAP_GUARDED_ALLOCATIONS == 1 || SHEAPERD_STACK_GUARD == 1
+/**
+ * Masks the interrupts according to 'SHEAPERD_SHEAP_CRITICAL_SECTION' (PRIMASK or BASEPRI). Calls can be nested, the mask
+ * active before the outermost call is restored by the matching util_exitCriticalSection.
+ */
+void util_enterCriticalSection();
+void util_exitCriticalSection();
+#endif
+
+#if SHEAPERD_USE_DWT_CYCLE_COUNTER == 1
+/**
+ * Enables the trace unit and the DWT cycle counter (DEMCR.TRCENA, DWT_CTRL.CYCCNTENA).
+ */
+void util_enableCycleCounter();
+#endif
+
+#if SHEAPERD_SHEAP_TRACE == 1
+/**
+ * Orders the memory accesses before and after the call (DMB).
+ */
+void util_dataMemoryBarrier();
+#if SHEAPERD_SHEAP_TRACE_USE_ITM == 1
+/**
+ * Writes @param n words to the ITM stimulus @param port, waits while the stimulus FIFO is full.
+ *
+ * @return false without writing if the ITM or the port is not enabled (no debugger attached)
+ */
+bool util_itmWrite(uint32_t port, const uint32_t words[], uint32_t n);
+#endif
+#endif
+
+#if SHEAPERD_SHEAP_ATOMIC_BUSY_FLAGS == 1
+/**
+ * Atomically sets @param flags in @param word (LDREX/STREX).
+ *
+ * @return false without modifying @param word if any of the flags is already set
+ */
+bool util_claimFlags(volatile uint32_t* word, uint32_t flags);
+/**
+ * Atomically clears @param flags in @param word (LDREX/STREX).
+ */
+void util_releaseFlags(volatile uint32_t* word, uint32_t flags);
+#endif
+
+/**
+ * Bit scan helpers. Both return -1 if no bit is set in @param word.
+ *
+ * util_fls returns the index of the most significant set bit (find last set)
+ * util_ffs returns the index of the least significant set bit (find first set)
+ */
+int32_t util_fls(uint32_t word);
+int32_t util_ffs(uint32_t word);
+
 uint16_t util_crc16_sw_calculate(uint8_t const data[], int n);
 uint32_t util_crc32_sw_calculate(uint8_t const data[], int n);
 
+#if SHEAPERD_CRC16_BACKEND == SHEAPERD_CRC16_BACKEND_TABLE
+uint16_t util_crc16_table_calculate(uint8_t const data[], int n);
+#elif SHEAPERD_CRC16_BACKEND == SHEAPERD_CRC16_BACKEND_NIBBLE
+uint16_t util_crc16_nibble_calculate(uint8_t const data[], int n);
+#elif SHEAPERD_CRC16_BACKEND == SHEAPERD_CRC16_BACKEND_WORD
+uint16_t util_crc16_word_calculate(uint8_t const data[], int n);
+#elif SHEAPERD_CRC16_BACKEND == SHEAPERD_CRC16_BACKEND_PORT
+/**
+ * Has to be implemented by the port if 'SHEAPERD_CRC16_BACKEND_PORT' is selected.
+ * The result must be equal to 'util_crc16_sw_calculate' (polynomial 0x1021, initial value 0xFFFF, no reflection, xor out 0x0000).
+ */
+uint16_t sheaperd_port_crc16_calculate(uint8_t const data[], int n);
+#endif
+
+/**
+ * Calculates the CRC16 with the backend selected by 'SHEAPERD_CRC16_BACKEND'
+ */
+#if SHEAPERD_CRC16_BACKEND == SHEAPERD_CRC16_BACKEND_BITWISE
+	#define util_crc16_calculate(data, n)	util_crc16_sw_calculate(data, n)
+#elif SHEAPERD_CRC16_BACKEND == SHEAPERD_CRC16_BACKEND_TABLE
+	#define util_crc16_calculate(data, n)	util_crc16_table_calculate(data, n)
+#elif SHEAPERD_CRC16_BACKEND == SHEAPERD_CRC16_BACKEND_NIBBLE
+	#define util_crc16_calculate(data, n)	util_crc16_nibble_calculate(data, n)
+#elif SHEAPERD_CRC16_BACKEND == SHEAPERD_CRC16_BACKEND_WORD
+	#define util_crc16_calculate(data, n)	util_crc16_word_calculate(data, n)
+#elif SHEAPERD_CRC16_BACKEND == SHEAPERD_CRC16_BACKEND_PORT
+	#define util_crc16_calculate(data, n)	sheaperd_port_crc16_calculate(data, n)
+#else
+	#error "Invalid 'SHEAPERD_CRC16_BACKEND'"
+#endif
+
+/**
+ * Sets @param size bytes at @param ptr to @param value with the kernel selected by 'SHEAPERD_FILL_KERNEL' (and 'SHEAPERD_DMA_FILL').
+ */
+void util_fillMemory(void* ptr, uint8_t value, size_t size);
+
+#if SHEAPERD_DMA_FILL == 1
+/**
+ * Has to be implemented by the port if 'SHEAPERD_DMA_FILL' is enabled. Fills the words at @param ptr (word aligned, @param size a multiple
+ * of 4) with @param pattern and waits until the transfer has completed. Can be called with masked interrupts (sheap lock).
+ *
+ * @return the number of bytes filled from @param ptr on (0 if the engine is in use), the remaining bytes are filled by the CPU
+ */
+size_t sheaperd_port_dmaFill(uint32_t* ptr, uint32_t pattern, size_t size);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
 #endif /* INTERNAL_UTIL_H_ */
@@ -9,12 +9,56 @@
 #define INC_INTERNAL_VERSIONING_H_
 
 #define SHEAPERD_VERSION_MAJOR			0
-#define SHEAPERD_VERSION_MINOR			1
-#define SHEAPERD_VERSION_PATCH			2
+#define SHEAPERD_VERSION_MINOR			2
+#define SHEAPERD_VERSION_PATCH			0
 
 /** @file versioning.h
  *  @brief Provides the current version of the sheaperd library as well as the changelog.
  *
+ *  V 0.2.0:
+ *      Feature:
+ *          - Added two level segregated fit (TLSF) allocation strategy with constant time malloc/free
+ *          - Added next fit and best fit allocation strategies
+ *          - Added selectable CRC16 backends (lookup table, nibble table, word wise, port hook) and STM32 CRC unit port
+ *          - Added fixed size block pools (sheap_pool_*) with 4 byte per block tags
+ *          - Added optional per task allocation caches (SHEAPERD_SHEAP_TASK_CACHE)
+ *          - Added incremental heap check 'sheap_scrub_step', optional deferred overwrite of freed blocks and full heap check on malloc/free
+ *          - Added 'sheap_realloc' (and 'sheap_realloc_lr') with in place growth and shrinking
+ *          - Added 'sheap_malloc_batch' and 'sheap_free_batch'
+ *          - Added sheap instances ('sheap_init_instance' and the '_instance' functions), the existing api uses a default instance
+ *          - Added 'sheap_memalign' for aligned allocations
+ *          - Added BASEPRI critical sections, LDREX/STREX busy flags and an ISR safe mode ('SHEAPERD_SHEAP_CRITICAL_SECTION',
+ *            'SHEAPERD_SHEAP_ATOMIC_BUSY_FLAGS', 'SHEAPERD_SHEAP_ISR_SAFE'). Nested critical sections restore the previous mask
+ *          - Added cycle latency statistic of malloc, calloc and free ('SHEAPERD_SHEAP_LATENCY_STATISTIC', 'sheap_getLatencyStatistic')
+ *          - Added high watermarks, free block count, largest free block and allocations per size class to 'sheap_heapStat_t'
+ *          - Added host benchmark with synthetic workloads and trace replay (bench folder)
+ *          - Added binary allocation event trace drained to ITM/SWO or a sink ('SHEAPERD_SHEAP_TRACE', 'sheap_trace_drain') and host decoder (tools folder)
+ *          - Added compact block layout with boundary tags on free blocks only ('SHEAPERD_SHEAP_COMPACT_HEADER')
+ *          - Added selectable block check word: none, canary, CRC16 or CRC32 ('SHEAPERD_SHEAP_INTEGRITY_LEVEL')
+ *          - Stackguard task switch only rewrites the regions of the previous and the next task with precalculated register values
+ *          - Added 'memory_protection_configureRegions' writing four regions per burst through the RBAR/RASR alias registers
+ *          - Stackguard task descriptors are mapped to the MPU regions on task switch (LRU), more tasks than regions ('stackguard_setTaskTable')
+ *          - Added ARMv8-M MPU backend (base/limit regions, MAIR attributes), stack sizes of any multiple of 32 bytes on ARMv8-M
+ *          - Sub-region fitting of non power of two stacks on ARMv7-M ('stackguard_fitStack'), stacks spanning two MPU regions
+ *          - Stack painting and high watermark scan ('stackguard_getHighWatermark', 'stackguard_getStackUsage')
+ *          - MPU guarded allocations ('sheap_malloc_guarded', sampling and suspect id), overflows fault at the writing instruction
+ *          - Stackguard switch fast path by task handle ('stackguard_taskSwitchInHandle'), FreeRTOS, Zephyr and ThreadX switch hook ports
+ *          - Native FreeRTOS, Zephyr, ThreadX and TI RTOS lock ports ('SHEAPERD_LOCK_PORT') with scheduler lock and ISR try lock
+ *          - Added header only C++ adapters (sheap.hpp): memory resource, allocator, make_unique with compile time pool routing, extern "C" headers
+ *          - Added incremental heap walk ('sheap_walk_next') restarting on heap modification, binary heap snapshot ('sheap_snapshot_step') and host decoder
+ *          - Word and STM burst fill kernels ('SHEAPERD_FILL_KERNEL'), DMA fill port hook with STM32 DMA2D port, lazy heap initialization
+ *            ('SHEAPERD_SHEAP_LAZY_INIT') and chunked overwrite of large free blocks by the scrub step
+ *          - Added arenas ('sheap_arena_create', 'sheap_arena_alloc', 'sheap_arena_reset'): bump allocation from one sheap block with optional
+ *            growth chunks ('SHEAPERD_SHEAP_ARENA_GROWTH') and end canary check ('SHEAPERD_SHEAP_ARENA_CANARY')
+ *      Bugfix:
+ *          - First fit search read the block header past the end of the heap
+ *          - Caller id log index overflow after 32767 logged accesses
+ *          - Allocation of size 0 did not release the mutex
+ *          - Tasks calling sheap concurrently failed with an overlap assertion instead of waiting for the mutex
+ *          - Undefined shift of the CRC32 software implementation
+ *          - Stackguard used more regions than 'STACKGUARD_NUMBER_OF_MPU_REGIONS' on MPUs with 16 regions, removed task regions stayed enabled
+ *          - Calloc overwrote the unused bytes after the requested size, the free of the block reported an out of bound write
+ *
  *  V 0.1.2:
  *      Feature:
  *          - Added TI RTOS port for currently used CMSIS APIs
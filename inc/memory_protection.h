@@ -10,8 +10,21 @@
 
 #include "sheaperd.h"
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 #define MPU_DEFAULT_TEX		0x00
 
+// maximum number of regions of the ARMv7-M/ARMv8-M MPU
+#define MPU_MAX_NUMBER_OF_REGIONS	16
+
+/* ARMv8-M memory attributes (MAIR) used with 'mpu_region_t.attributeIndex', see 'memory_protection_setMemoryAttributes' */
+#define MPU_MAIR_DEVICE_nGnRE				0x04
+#define MPU_MAIR_NORMAL_NON_CACHEABLE		0x44
+#define MPU_MAIR_NORMAL_WRITE_THROUGH		0xAA
+#define MPU_MAIR_NORMAL_WRITE_BACK			0xFF
+
 #define MPU_ACTIVATE_REGION(region)				\
 do{												\
 	mpu_region_t* r = &region;					\
@@ -81,6 +94,7 @@ typedef enum {
 	INVALID_REGION_ADDRESS				= -0x02,
 	INVALID_REGION_ADDRESS_ALIGNMENT	= -0x03,
 	INVALID_REGION_NUMBER				= -0x04,
+	INVALID_REGION_LIMIT				= -0x05,
 
 	NO_ERROR							= 0x00
 } mpu_error_t;
@@ -97,13 +111,99 @@ typedef struct {
 	bool shareable;
 	uint8_t tex;
 	bool xn;
+#if SHEAPERD_ARMV8
+	/* ARMv8-M: the region spans address .. limit (last byte, 32 byte granularity), size, srd, tex, cachable and bufferable are not used.
+	 * The memory attributes are taken from MAIR[attributeIndex]. ARMv8-M has no permission without privileged access,
+	 * MPU_REGION_ALL_ACCESS_DENIED is mapped to privileged read only and execute never,
+	 * MPU_REGION_PRIVELEGED_RW_UNPRIVILEGED_RO to privileged read/write */
+	uint32_t limit;
+	uint8_t attributeIndex;
+#endif
 } mpu_region_t;
 
+#if SHEAPERD_ARMV8
+/**
+ * Register values of a region (region number, RBAR, RLAR)
+ */
+typedef struct {
+	uint32_t rbar;
+	uint32_t rlar;
+	uint32_t number;
+} mpu_regionRegisters_t;
+#else
+/**
+ * Register values of a region (RBAR including the valid bit and the region number, RASR)
+ */
+typedef struct {
+	uint32_t rbar;
+	uint32_t rasr;
+} mpu_regionRegisters_t;
+#endif
+
+/**
+ * Changes the region number of register values calculated by 'memory_protection_encodeRegion'
+ */
+static inline void memory_protection_setRegisterNumber(mpu_regionRegisters_t* registers, uint8_t number){
+#if SHEAPERD_ARMV8
+	registers->number = number;
+#else
+	registers->rbar = (registers->rbar & ~0xFul) | number;
+#endif
+}
+
 mpu_error_t memory_protection_enableMPU();
 mpu_error_t memory_protection_disableMPU();
 
 bool memory_protection_isMPUEnabled();
 mpu_error_t memory_protection_configureRegion(mpu_region_t* region, bool activateMPU);
+
+/**
+ * Validates the region and calculates its register values without writing them to the MPU.
+ *
+ * @return error	INVALID_REGION_ADDRESS, INVALID_REGION_ADDRESS_ALIGNMENT, INVALID_REGION_LIMIT (ARMv8-M) or INVALID_REGION_NUMBER if the
+ * 					region can not be configured
+ */
+mpu_error_t memory_protection_encodeRegion(const mpu_region_t* region, mpu_regionRegisters_t* registers);
+
+/**
+ * Writes register values calculated by 'memory_protection_encodeRegion' to the MPU. The values are not validated and the MPU is not
+ * disabled, a changed region becomes active after the next DSB/ISB (e.g. 'memory_protection_enableMPU').
+ * ARMv8-M: RNR is changed.
+ */
+void memory_protection_writeRegion(const mpu_regionRegisters_t* registers);
+
+/**
+ * Disables the region with one store of RASR (ARMv7-M) or RLAR (ARMv8-M) after selecting it with RNR. Its address and size are not
+ * changed, so the region can be moved afterwards with 'memory_protection_writeRegion' while the MPU is enabled.
+ */
+void memory_protection_disableRegion(uint8_t number);
+
+/**
+ * Configures n regions with one MPU disable. All regions are validated and encoded before the MPU is disabled, the register values are
+ * written in bursts of four regions using the RBAR/RASR alias registers.
+ *
+ * @return error	NO_MPU_AVAILABLE, INVALID_REGION_NUMBER (also if n > MPU_MAX_NUMBER_OF_REGIONS) or the error of the first invalid region,
+ * 					in that case the MPU is not changed
+ */
+mpu_error_t memory_protection_configureRegions(const mpu_region_t regions[], uint32_t n, bool activateMPU);
+
+/**
+ * Writes n register values calculated by 'memory_protection_encodeRegion' in bursts of four regions (see 'memory_protection_writeRegion').
+ * ARMv8-M: the aliases address the regions RNR[7:2]:n, a burst is only used for four consecutive regions starting at a multiple of four
+ * (not available on the Cortex-M23)
+ */
+void memory_protection_writeRegions(const mpu_regionRegisters_t registers[], uint32_t n);
+
+#if SHEAPERD_ARMV8
+/**
+ * Sets the memory attributes MAIR[index] (index 0 .. 7) used by the regions with this attribute index
+ */
+void memory_protection_setMemoryAttributes(uint8_t index, uint8_t attributes);
+#endif
 uint8_t memory_protection_getNumberOfMPURegions();
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif /* INC_MEMORY_PROTECTION_H_ */
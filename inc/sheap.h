@@ -10,10 +10,16 @@
 
 #include "sheaperd.h"
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 typedef enum {
 	SHEAP_OK,
 	SHEAP_INVALID_POINTER,
-	SHEAP_ERROR
+	SHEAP_ERROR,
+	SHEAP_BUSY,
+	SHEAP_WALK_RESTARTED
 } sheap_status_t;
 
 typedef struct{
@@ -24,14 +30,119 @@ typedef struct{
 	uint32_t	userDataAllocatedAlligned;
 	uint32_t	userDataAllocated;
 	size_t 		size;
+	// high watermarks since the initialization
+	uint32_t	peakTotalBytesAllocated;
+	uint32_t	peakAllocations;
+	// fragmentation of the free memory
+	uint32_t	freeBlocks;
+	uint32_t	largestFreeBlock;
+	// number of allocations by requested size since the initialization (see 'SHEAPERD_SHEAP_STAT_SIZE_CLASSES')
+	uint32_t	allocationsPerSizeClass[SHEAPERD_SHEAP_STAT_SIZE_CLASSES];
 } sheap_heapStat_t;
 
+#if SHEAPERD_SHEAP_LATENCY_STATISTIC == 1
+typedef struct{
+	uint32_t	count;
+	uint32_t	minCycles;
+	uint32_t	maxCycles;
+	uint32_t	meanCycles;
+	uint32_t	histogram[SHEAPERD_SHEAP_LATENCY_HISTOGRAM_BINS];
+	// blocks visited by the free block search of the allocation strategy
+	uint32_t	maxBlocksVisited;
+	uint32_t	meanBlocksVisited;
+	// size and id of the call with maxCycles
+	size_t		worstCaseSize;
+	uint32_t	worstCaseId;
+} sheap_latencyStat_t;
+
+typedef struct{
+	sheap_latencyStat_t	malloc;
+	sheap_latencyStat_t	calloc;
+	sheap_latencyStat_t	free;
+} sheap_latencyStatistic_t;
+#endif
+
+#if SHEAPERD_SHEAP_TRACE == 1
+#define SHEAP_TRACE_MAGIC	0xA5
+
+typedef enum{
+	SHEAP_TRACE_MALLOC = 1,
+	SHEAP_TRACE_CALLOC,
+	SHEAP_TRACE_MEMALIGN,
+	// new block of a reallocation, preceded by a SHEAP_TRACE_FREE of the old block if the reallocation succeeded
+	SHEAP_TRACE_REALLOC,
+	SHEAP_TRACE_FREE
+} sheap_traceOp_t;
+
+/* Streamed as five little endian words, the first word is magic | op << 8 | sequence << 16 */
+typedef struct{
+	uint8_t		magic;
+	uint8_t		op;
+	// incremented for each event (including dropped events) of the instance
+	uint16_t	sequence;
+	uint32_t	id;
+	// requested size, 0 for frees
+	uint32_t	size;
+	// payload address, 0 if the allocation failed
+	uint32_t	address;
+	uint32_t	timestamp;
+} sheap_traceEvent_t;
+
+typedef void (*sheap_traceSink_cb) (const sheap_traceEvent_t* event);
+#endif
+
+/**
+ * A sheap instance with its own heap memory, lock, statistics and caller id log (see 'sheap_init_instance').
+ * The sheap_* functions without instance parameter use a default instance which is initialized with 'sheap_init'.
+ */
+typedef struct sheap_t sheap_t;
+
+/* Record of a block read by 'sheap_walk_next' */
+typedef struct{
+	// payload address
+	void*		address;
+	// aligned payload size
+	uint32_t	size;
+	// size requested by the allocation, 0 for free blocks
+	uint32_t	requestedSize;
+	// caller id of the allocation, 0 without extended header
+	uint32_t	id;
+	bool		isAllocated;
+	// header and boundary are valid
+	bool		isValid;
+} sheap_blockInfo_t;
+
+/* Cursor of a heap walk, owned by the caller (see 'sheap_walk_begin') */
+typedef struct{
+	sheap_t*	sheap;
+	// header of the next block, NULL after the last block
+	void*		next;
+	// generation of the heap at the last call
+	uint32_t	generation;
+	uint32_t	restarts;
+} sheap_walk_t;
+
+/* Called with the little endian words of one snapshot record */
+typedef void (*sheap_snapshotSink_cb) (const uint32_t words[], uint32_t count);
+
+typedef struct{
+	sheap_walk_t			walk;
+	sheap_snapshotSink_cb	sink;
+	// block records written since the last begin record
+	uint32_t				blocks;
+	// walk restarts at the last begin record
+	uint32_t				restarts;
+	bool					isHeaderWritten;
+	bool					isComplete;
+} sheap_snapshot_t;
+
 /**
  * The following function are implemented in assembler. See the ../asm folder
  */
 void* sheap_malloc_lr(size_t size);
 void* sheap_calloc_lr(size_t num, size_t size);
 void* sheap_free_lr(void* p);
+void* sheap_realloc_lr(void* p, size_t size);
 
 
 /**
@@ -47,6 +158,16 @@ void* sheap_free_lr(void* p);
  */
 void* sheap_malloc(size_t size, uint32_t id);
 void* sheap_calloc(size_t num, size_t size, uint32_t id);
+/**
+ * Allocates memory of the requested size with a payload aligned to @param alignment (power of two), e.g. the cache line size
+ * for DMA buffers or the region size for MPU regions. The memory before the aligned payload is kept as free block, the returned
+ * pointer is freed with sheap_free. A reallocation (sheap_realloc) may move the memory to an address without this alignment.
+ *
+ * @param alignment the alignment of the returned pointer in bytes
+ * @param size the size of memory to be allocated
+ * @param id the value to identify the origin of the calling context
+ */
+void* sheap_memalign(size_t alignment, size_t size, uint32_t id);
 /**
  * Deallocates memory associated with the provided pointer.
  * For best error detection support one should use the provided
@@ -59,6 +180,39 @@ void* sheap_calloc(size_t num, size_t size, uint32_t id);
  * @param id the value to identify the origin of the calling context
  */
 void sheap_free(void* ptr, uint32_t id);
+/**
+ * Allocates n blocks within one critical section (one lock, one access log entry). The allocation is all or nothing, if one
+ * block cannot be allocated, the blocks of this batch are freed again and all entries of @param allocated are set to NULL.
+ * The task caches (SHEAPERD_SHEAP_TASK_CACHE) are not used for batches.
+ *
+ * @param sizes the requested size of each block
+ * @param allocated receives the pointer of each block
+ * @param n the number of blocks
+ * @param id the value to identify the origin of the calling context
+ * @return SHEAP_OK if all blocks are allocated, SHEAP_ERROR otherwise
+ */
+sheap_status_t sheap_malloc_batch(const size_t sizes[], void* allocated[], size_t n, uint32_t id);
+/**
+ * Deallocates n blocks within one critical section. The pointers are sorted by address (the order of @param ptrs is changed)
+ * so neighbouring blocks of the batch are merged into one free block at once. Each pointer is checked as with sheap_free, NULL entries
+ * are skipped. Guarded allocations are freed first (each with its own lock) and their entries are set to NULL.
+ *
+ * @param ptrs the pointers associated with the memory to be freed
+ * @param n the number of pointers
+ * @param id the value to identify the origin of the calling context
+ */
+void sheap_free_batch(void* ptrs[], size_t n, uint32_t id);
+/**
+ * Changes the size of the memory associated with the provided pointer. The block grows in place if the following block is free and
+ * large enough and shrinks in place by releasing its tail. Otherwise a new block is allocated, the content is copied and the old block is freed.
+ * If ptr is NULL this call is equal to sheap_malloc, if size is 0 the memory is freed and NULL is returned.
+ *
+ * @param ptr the pointer associated with the memory to be resized
+ * @param size the new size of the memory
+ * @param id the value to identify the origin of the calling context
+ * @return the pointer to the resized memory or NULL if no memory of the requested size is available (ptr stays valid in this case)
+ */
+void* sheap_realloc(void* ptr, size_t size, uint32_t id);
 size_t sheap_getHeapSize();
 size_t sheap_getAllocatedBytesAligned();
 size_t sheap_getAllocatedBytes();
@@ -68,6 +222,128 @@ void sheap_getHeapStatistic(sheap_heapStat_t* heapStat);
 sheap_status_t sheap_getAllocationID(void* allocatedPtr, uint32_t* id);
 #endif
 
+#if SHEAPERD_SHEAP_LATENCY_STATISTIC == 1
+/**
+ * Provides the cycles spent within sheap_malloc (including sheap_memalign), sheap_calloc and sheap_free. The time is measured
+ * while the heap is locked, waiting for the lock and calls served by the task cache are not included. Batch and realloc calls
+ * are not recorded.
+ */
+void sheap_getLatencyStatistic(sheap_latencyStatistic_t* latencyStat);
+void sheap_resetLatencyStatistic();
+#endif
+
+#if SHEAPERD_SHEAP_TRACE == 1
+/**
+ * Passes up to @param maxEvents recorded events of the trace buffer to the sink, intended to be called periodically from a single
+ * task (e.g. the idle hook). Events are recorded while the heap is locked, the drain does not lock the heap.
+ *
+ * @return the number of drained events
+ */
+uint32_t sheap_trace_drain(uint32_t maxEvents);
+/**
+ * Sets the sink of 'sheap_trace_drain' for all instances, NULL restores the ITM output (SHEAPERD_SHEAP_TRACE_USE_ITM).
+ */
+void sheap_trace_setSink(sheap_traceSink_cb sink);
+/**
+ * @return the number of events dropped because the trace buffer was full
+ */
+uint32_t sheap_trace_getDropped();
+#endif
+
+#if SHEAPERD_SHEAP_TASK_CACHE == 1
+/**
+ * Returns all blocks held by the allocation cache of the calling task to the sheap and releases the cache.
+ * Must be called by a task before it is deleted (see 'SHEAPERD_SHEAP_TASK_CACHE').
+ */
+void sheap_cache_flush();
+#endif
+
+#if SHEAPERD_SHEAP_GUARDED_ALLOCATIONS == 1
+/**
+ * Allocates memory from the default instance which is followed by a no access MPU region (see 'SHEAPERD_SHEAP_GUARDED_ALLOCATIONS'). The
+ * requested size ends at the guard (rounded up to 'SHEAP_MINIMUM_MALLOC_SIZE'), thus a write beyond the allocation faults immediately
+ * with the PC of the writing instruction, the bytes up to the guard are checked by the free. The allocation takes up to 63 bytes and the
+ * alignment slack of a 32 byte aligned block more than a sheap_malloc. It is freed/reallocated with sheap_free, sheap_free_batch and
+ * sheap_realloc of the default instance only, the *_instance functions do not accept a guarded pointer.
+ * ARMv8-M: privileged reads of the guard are not trapped (no privileged no access permission).
+ *
+ * @param size the size of memory to be allocated
+ * @param id the value to identify the origin of the calling context
+ * @return the pointer to the memory or NULL if all guard slots are used or no memory is available
+ */
+void* sheap_malloc_guarded(size_t size, uint32_t id);
+/**
+ * Allocations of sheap_malloc with this id (e.g. the caller address of 'sheap_malloc_lr') are guarded while a slot is free, 0 disables.
+ */
+void sheap_guard_setSuspectId(uint32_t id);
+/**
+ * Finds the guarded allocation whose guard contains @param faultAddress (MMFAR), intended for the MemManage handler or the
+ * memory fault callback of the stackguard. Does not lock the heap.
+ *
+ * @return SHEAP_OK and the allocation and its id if the address is within a guard, SHEAP_INVALID_POINTER otherwise
+ */
+sheap_status_t sheap_guard_findOverflow(uint32_t faultAddress, void** allocation, uint32_t* id);
+#endif
+
+/**
+ * Checks the next @param maxBlocks blocks of the heap (header and boundary CRC), intended to be called periodically, e.g. from the idle hook.
+ * The position is saved between the calls, after the last block of the heap the check continues with the first block.
+ * With 'SHEAPERD_SHEAP_DEFER_OVERWRITE_ON_FREE' the payload of the freed blocks within the checked range is overwritten as well.
+ *
+ * @return	SHEAP_OK		all checked blocks are valid
+ * 			SHEAP_ERROR		an invalid block was found (the check restarts at the first block with the next call)
+ * 			SHEAP_BUSY		the call overlapped with an allocation or free and nothing was checked
+ */
+sheap_status_t sheap_scrub_step(uint32_t maxBlocks);
+
+/**
+ * @return the number of completed passes over the whole heap of 'sheap_scrub_step'
+ */
+uint32_t sheap_scrub_getCompletedPasses();
+
+/**
+ * Starts a walk over all blocks of the heap with 'sheap_walk_next'. The walk does not lock the heap between the calls.
+ */
+void sheap_walk_begin(sheap_walk_t* walk);
+
+/**
+ * Reads the records of the next @param maxBlocks blocks of the walk into @param info, the number of records is returned in @param count.
+ * The heap is locked during the call only. If the heap was modified (malloc, free, realloc, cache refill/drain) since the last call, the
+ * walk restarts at the first block, the restarts are counted in 'walk->restarts'.
+ *
+ * @return	SHEAP_OK				the records continue the records of the last call (no record and SHEAP_OK after the last block)
+ * 			SHEAP_WALK_RESTARTED	the heap was modified, the records start again with the first block
+ * 			SHEAP_ERROR				an invalid block was found (record with isValid false), the walk ends with an invalid header
+ * 			SHEAP_BUSY				the call overlapped with an allocation or free and nothing was read
+ */
+sheap_status_t sheap_walk_next(sheap_walk_t* walk, sheap_blockInfo_t info[], uint32_t maxBlocks, uint32_t* count);
+
+/**
+ * @return true if the walk has read the last block of the heap
+ */
+bool sheap_walk_isComplete(const sheap_walk_t* walk);
+
+/**
+ * Starts a snapshot of the heap layout written as words to @param sink by 'sheap_snapshot_step' (format in tools/README.md).
+ */
+void sheap_snapshot_begin(sheap_snapshot_t* snapshot, sheap_snapshotSink_cb sink);
+
+/**
+ * Writes the records of the next @param maxBlocks blocks of the snapshot, the heap is locked for at most 8 blocks at a time and not
+ * during the calls of the sink. After the last block the end record is written. A restart of the walk writes a new begin record, a decoder
+ * discards the records before it.
+ *
+ * @return	SHEAP_OK		the records were written
+ * 			SHEAP_ERROR		an invalid block was found (written as invalid record)
+ * 			SHEAP_BUSY		the call overlapped with an allocation or free, the step has to be repeated
+ */
+sheap_status_t sheap_snapshot_step(sheap_snapshot_t* snapshot, uint32_t maxBlocks);
+
+/**
+ * @return true if the end record of the snapshot was written
+ */
+bool sheap_snapshot_isComplete(const sheap_snapshot_t* snapshot);
+
 /**
  * Initializes the sheap allocator
  * ATTENTION: this function must be called before the scheduler is started
@@ -88,4 +364,55 @@ void sheap_init(uint32_t* heapStart, size_t size);
  */
 size_t sheap_align(size_t n);
 
+/**
+ * Initializes an additional sheap instance within the provided memory, e.g. to place a heap into a specific memory (DTCM, SRAM of
+ * another core). The instance data is stored at the start of the memory, the remaining memory is used as heap.
+ * Each instance is locked independently of the other instances.
+ * ATTENTION: this function must be called before the instance is used by more than one task
+ *
+ * @param memoryStart	start of the memory for the instance (4 byte aligned)
+ * @param size			size of the memory in bytes
+ *
+ * @return the instance or NULL if the memory is too small
+ */
+sheap_t* sheap_init_instance(uint32_t* memoryStart, size_t size);
+
+/**
+ * The following functions are equal to the functions without the '_instance' suffix, but operate on the provided instance.
+ * A pointer must be freed/reallocated with the instance it was allocated from.
+ */
+void* sheap_malloc_instance(sheap_t* sheap, size_t size, uint32_t id);
+void* sheap_calloc_instance(sheap_t* sheap, size_t num, size_t size, uint32_t id);
+void* sheap_memalign_instance(sheap_t* sheap, size_t alignment, size_t size, uint32_t id);
+void* sheap_realloc_instance(sheap_t* sheap, void* ptr, size_t size, uint32_t id);
+void sheap_free_instance(sheap_t* sheap, void* ptr, uint32_t id);
+sheap_status_t sheap_malloc_batch_instance(sheap_t* sheap, const size_t sizes[], void* allocated[], size_t n, uint32_t id);
+void sheap_free_batch_instance(sheap_t* sheap, void* ptrs[], size_t n, uint32_t id);
+size_t sheap_getHeapSize_instance(sheap_t* sheap);
+size_t sheap_getAllocatedBytesAligned_instance(sheap_t* sheap);
+size_t sheap_getAllocatedBytes_instance(sheap_t* sheap);
+void sheap_getHeapStatistic_instance(sheap_t* sheap, sheap_heapStat_t* heapStat);
+#if SHEAPERD_SHEAP_USE_EXTENDED_HEADER == 1
+sheap_status_t sheap_getAllocationID_instance(sheap_t* sheap, void* allocatedPtr, uint32_t* id);
+#endif
+#if SHEAPERD_SHEAP_LATENCY_STATISTIC == 1
+void sheap_getLatencyStatistic_instance(sheap_t* sheap, sheap_latencyStatistic_t* latencyStat);
+void sheap_resetLatencyStatistic_instance(sheap_t* sheap);
+#endif
+#if SHEAPERD_SHEAP_TRACE == 1
+uint32_t sheap_trace_drain_instance(sheap_t* sheap, uint32_t maxEvents);
+uint32_t sheap_trace_getDropped_instance(sheap_t* sheap);
+#endif
+#if SHEAPERD_SHEAP_TASK_CACHE == 1
+void sheap_cache_flush_instance(sheap_t* sheap);
+#endif
+sheap_status_t sheap_scrub_step_instance(sheap_t* sheap, uint32_t maxBlocks);
+uint32_t sheap_scrub_getCompletedPasses_instance(sheap_t* sheap);
+void sheap_walk_begin_instance(sheap_t* sheap, sheap_walk_t* walk);
+void sheap_snapshot_begin_instance(sheap_t* sheap, sheap_snapshot_t* snapshot, sheap_snapshotSink_cb sink);
+
+#ifdef __cplusplus
+}
+#endif
+
 #endif /* INC_SHEAP_H_ */
@@ -0,0 +1,363 @@
+/** @file sheap.hpp
+ *  @brief Provides the header only C++ adapters of the sheap: a std::pmr::memory_resource, sheap::allocator<T> and
+ *  sheap::make_unique<T> (C++17).
+ *
+ *  The adapters pass the call site as id (like the '_lr' functions): the functions are inlined into the calling code and take the
+ *  return address of a call made from there. Objects with a size known at compile time (single objects of 'allocator<T>' and
+ *  'make_unique') are routed by a template to the pool bound to their size class ('bind_pool', 'create_pool'), without a size
+ *  dispatch at runtime. The heap is used if no pool is bound or the pool is exhausted. The pools are blocks of the default instance,
+ *  allocators of other instances always use their instance.
+ *
+ *  Failed allocations throw std::bad_alloc. Without exceptions (-fno-exceptions) the allocator and make_unique return nullptr
+ *  (the sheap asserts SHEAP_OUT_OF_MEMORY before) and the memory resource traps.
+ *
+ *  @author JK
+ *  @bug No known bugs.
+ */
+
+#ifndef INC_SHEAP_HPP_
+#define INC_SHEAP_HPP_
+
+#include "sheap.h"
+#include "sheap_pool.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#if __has_include(<memory_resource>)
+	#include <memory_resource>
+	#define SHEAPERD_CPP_MEMORY_RESOURCE	1
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+	#define SHEAPERD_CPP_INLINE		[[gnu::always_inline]] inline
+	#define SHEAPERD_CPP_NOINLINE	[[gnu::noinline]]
+#else
+	#error "The call site capture of sheap.hpp requires gcc or clang (__builtin_return_address)"
+#endif
+
+namespace sheap {
+
+// the payloads are word aligned, larger alignments are allocated with sheap_memalign
+constexpr std::size_t natural_alignment = 4;
+
+/**
+ * Size class of the pool routing for objects of @param size bytes (0 if the size is larger than the largest class).
+ */
+constexpr std::size_t pool_class_size(std::size_t size) {
+	if(size > SHEAPERD_CPP_POOL_MAX_CLASS_SIZE) {
+		return 0;
+	}
+	std::size_t classSize = SHEAPERD_CPP_POOL_MIN_CLASS_SIZE;
+	while(classSize < size) {
+		classSize <<= 1;
+	}
+	return classSize;
+}
+
+namespace detail {
+
+template<std::size_t ClassSize>
+struct pool_slot {
+	static inline sheap_pool_t* pool = nullptr;
+};
+
+// returns the address following the call, i.e. the call site of the inlined adapter which calls it
+SHEAPERD_CPP_NOINLINE inline uint32_t callSite() {
+	return static_cast<uint32_t>(reinterpret_cast<uintptr_t>(__builtin_return_address(0)));
+}
+
+inline void* heapAllocate(sheap_t* instance, std::size_t size, std::size_t alignment, uint32_t id) {
+	if(alignment <= natural_alignment) {
+		return instance == nullptr ? sheap_malloc(size, id) : sheap_malloc_instance(instance, size, id);
+	}
+	return instance == nullptr ? sheap_memalign(alignment, size, id) : sheap_memalign_instance(instance, alignment, size, id);
+}
+
+inline void heapDeallocate(sheap_t* instance, void* ptr, uint32_t id) {
+	if(instance == nullptr) {
+		sheap_free(ptr, id);
+	} else {
+		sheap_free_instance(instance, ptr, id);
+	}
+}
+
+template<std::size_t Size, std::size_t Alignment>
+constexpr bool isPoolRouted = pool_class_size(Size) != 0 && Alignment <= natural_alignment;
+
+// allocation of a single object of the default instance, a bound pool of the size class is used first
+template<std::size_t Size, std::size_t Alignment>
+inline void* fixedAllocate(uint32_t id) {
+	if constexpr (isPoolRouted<Size, Alignment>) {
+		sheap_pool_t* pool = pool_slot<pool_class_size(Size)>::pool;
+		// the free count is checked first, an exhausted pool must not assert as the heap is used then
+		if(pool != nullptr && sheap_pool_getNumberOfFreeBlocks(pool) != 0) {
+			void* ptr = sheap_pool_alloc(pool);
+			if(ptr != nullptr) {
+				return ptr;
+			}
+		}
+	}
+	return heapAllocate(nullptr, Size, Alignment, id);
+}
+
+template<std::size_t Size, std::size_t Alignment>
+inline void fixedDeallocate(void* ptr, uint32_t id) {
+	if constexpr (isPoolRouted<Size, Alignment>) {
+		sheap_pool_t* pool = pool_slot<pool_class_size(Size)>::pool;
+		if(sheap_pool_contains(pool, ptr)) {
+			sheap_pool_free(pool, ptr);
+			return;
+		}
+	}
+	heapDeallocate(nullptr, ptr, id);
+}
+
+[[noreturn]] inline void throwBadAlloc() {
+#if defined(__cpp_exceptions)
+	throw std::bad_alloc();
+#else
+	__builtin_trap();
+#endif
+}
+
+} // namespace detail
+
+/**
+ * Binds @param pool to the size class of objects with @param Size bytes (nullptr unbinds). The block size of the pool must be at
+ * least the class size. The frees of the class are routed by the bound pool, a pool can therefore only be unbound or replaced
+ * while none of its blocks is allocated. A bound pool must be unbound before it is destroyed ('destroy_pool').
+ *
+ * @return false if the size is not routed to a pool (see 'pool_class_size'), the blocks of the pool are too small or the bound
+ * pool has allocated blocks
+ */
+template<std::size_t Size>
+inline bool bind_pool(sheap_pool_t* pool) {
+	constexpr std::size_t classSize = pool_class_size(Size);
+	if constexpr (classSize == 0) {
+		return false;
+	} else {
+		if(pool != nullptr && sheap_pool_getBlockSize(pool) < classSize) {
+			return false;
+		}
+		sheap_pool_t* bound = detail::pool_slot<classSize>::pool;
+		if(bound != nullptr && bound != pool && sheap_pool_getNumberOfFreeBlocks(bound) != sheap_pool_getNumberOfBlocks(bound)) {
+			return false;
+		}
+		detail::pool_slot<classSize>::pool = pool;
+		return true;
+	}
+}
+
+/**
+ * Creates a pool of @param count blocks of the size class of @param Size and binds it ('bind_pool'). The pool is destroyed with
+ * 'destroy_pool'.
+ *
+ * @return the pool or nullptr if it could not be created or bound
+ */
+template<std::size_t Size>
+inline sheap_pool_t* create_pool(uint32_t count) {
+	static_assert(pool_class_size(Size) != 0, "The size is larger than SHEAPERD_CPP_POOL_MAX_CLASS_SIZE");
+	sheap_pool_t* pool = sheap_pool_create(pool_class_size(Size), count);
+	if(pool != nullptr && !bind_pool<Size>(pool)) {
+		sheap_pool_destroy(pool);
+		return nullptr;
+	}
+	return pool;
+}
+
+/**
+ * Unbinds the pool of the size class of @param Size and destroys it. A pool destroyed with sheap_pool_destroy while it is bound
+ * would still be used by the frees of the class.
+ *
+ * @return false if no pool is bound or the bound pool has allocated blocks (the pool stays bound)
+ */
+template<std::size_t Size>
+inline bool destroy_pool() {
+	static_assert(pool_class_size(Size) != 0, "The size is larger than SHEAPERD_CPP_POOL_MAX_CLASS_SIZE");
+	sheap_pool_t* pool = detail::pool_slot<pool_class_size(Size)>::pool;
+	if(pool == nullptr || !bind_pool<Size>(nullptr)) {
+		return false;
+	}
+	sheap_pool_destroy(pool);
+	return true;
+}
+
+/**
+ * Aligned allocation with the call site as id.
+ */
+SHEAPERD_CPP_INLINE void* memalign(std::size_t alignment, std::size_t size, sheap_t* instance = nullptr) {
+	uint32_t id = detail::callSite();
+	return instance == nullptr ? sheap_memalign(alignment, size, id) : sheap_memalign_instance(instance, alignment, size, id);
+}
+
+/**
+ * Batch allocation and free (see 'sheap_malloc_batch') with the call site as id.
+ */
+template<std::size_t N>
+SHEAPERD_CPP_INLINE sheap_status_t malloc_batch(const std::size_t (&sizes)[N], void* (&allocated)[N], sheap_t* instance = nullptr) {
+	uint32_t id = detail::callSite();
+	return instance == nullptr ? sheap_malloc_batch(sizes, allocated, N, id) : sheap_malloc_batch_instance(instance, sizes, allocated, N, id);
+}
+
+template<std::size_t N>
+SHEAPERD_CPP_INLINE void free_batch(void* (&ptrs)[N], sheap_t* instance = nullptr) {
+	uint32_t id = detail::callSite();
+	if(instance == nullptr) {
+		sheap_free_batch(ptrs, N, id);
+	} else {
+		sheap_free_batch_instance(instance, ptrs, N, id);
+	}
+}
+
+/**
+ * Allocator of a sheap instance (nullptr: the default instance) for the std containers. Single objects of the default instance are
+ * routed to the pool of their size class, allocations with a larger alignment than 'natural_alignment' use sheap_memalign.
+ */
+template<class T>
+class allocator {
+public:
+	using value_type = T;
+	using is_always_equal = std::false_type;
+
+	allocator() noexcept = default;
+	explicit allocator(sheap_t* instance) noexcept : mInstance(instance) {}
+	template<class U>
+	allocator(const allocator<U>& other) noexcept : mInstance(other.instance()) {}
+
+	SHEAPERD_CPP_INLINE T* allocate(std::size_t n) {
+		uint32_t id = detail::callSite();
+		void* ptr;
+		if(n == 1 && mInstance == nullptr) {
+			ptr = detail::fixedAllocate<sizeof(T), alignof(T)>(id);
+		} else if(n > std::numeric_limits<std::size_t>::max() / sizeof(T)) {
+			ptr = nullptr;
+		} else {
+			ptr = detail::heapAllocate(mInstance, n * sizeof(T), alignof(T), id);
+		}
+		if(ptr == nullptr) {
+#if defined(__cpp_exceptions)
+			detail::throwBadAlloc();
+#endif
+		}
+		return static_cast<T*>(ptr);
+	}
+
+	SHEAPERD_CPP_INLINE void deallocate(T* ptr, std::size_t n) noexcept {
+		uint32_t id = detail::callSite();
+		if(n == 1 && mInstance == nullptr) {
+			detail::fixedDeallocate<sizeof(T), alignof(T)>(ptr, id);
+		} else {
+			detail::heapDeallocate(mInstance, ptr, id);
+		}
+	}
+
+	sheap_t* instance() const noexcept {
+		return mInstance;
+	}
+
+private:
+	sheap_t* mInstance = nullptr;
+};
+
+template<class T, class U>
+inline bool operator==(const allocator<T>& a, const allocator<U>& b) noexcept {
+	return a.instance() == b.instance();
+}
+
+template<class T, class U>
+inline bool operator!=(const allocator<T>& a, const allocator<U>& b) noexcept {
+	return a.instance() != b.instance();
+}
+
+/**
+ * Deleter of 'make_unique', destroys the object and returns its memory to the pool or the heap.
+ */
+template<class T>
+struct deleter {
+	SHEAPERD_CPP_INLINE void operator()(T* ptr) const noexcept {
+		uint32_t id = detail::callSite();
+		ptr->~T();
+		detail::fixedDeallocate<sizeof(T), alignof(T)>(ptr, id);
+	}
+};
+
+template<class T>
+using unique_ptr = std::unique_ptr<T, deleter<T>>;
+
+/**
+ * Creates an object on the pool of its size class or the default instance.
+ */
+template<class T, class... Args>
+SHEAPERD_CPP_INLINE unique_ptr<T> make_unique(Args&&... args) {
+	static_assert(!std::is_array<T>::value, "sheap::make_unique does not support arrays, use a container with sheap::allocator");
+	uint32_t id = detail::callSite();
+	void* ptr = detail::fixedAllocate<sizeof(T), alignof(T)>(id);
+	if(ptr == nullptr) {
+#if defined(__cpp_exceptions)
+		detail::throwBadAlloc();
+#else
+		return unique_ptr<T>(nullptr);
+#endif
+	}
+#if defined(__cpp_exceptions)
+	try {
+		return unique_ptr<T>(new (ptr) T(std::forward<Args>(args)...));
+	} catch(...) {
+		detail::fixedDeallocate<sizeof(T), alignof(T)>(ptr, id);
+		throw;
+	}
+#else
+	return unique_ptr<T>(new (ptr) T(std::forward<Args>(args)...));
+#endif
+}
+
+#if SHEAPERD_CPP_MEMORY_RESOURCE == 1
+/**
+ * std::pmr::memory_resource of a sheap instance (nullptr: the default instance), the id is the return address of do_allocate
+ * (the caller of std::pmr::memory_resource::allocate).
+ */
+class memory_resource : public std::pmr::memory_resource {
+public:
+	explicit memory_resource(sheap_t* instance = nullptr) noexcept : mInstance(instance) {}
+
+	sheap_t* instance() const noexcept {
+		return mInstance;
+	}
+
+private:
+	SHEAPERD_CPP_NOINLINE void* do_allocate(std::size_t bytes, std::size_t alignment) override {
+		uint32_t id = static_cast<uint32_t>(reinterpret_cast<uintptr_t>(__builtin_return_address(0)));
+		void* ptr = detail::heapAllocate(mInstance, bytes, alignment, id);
+		if(ptr == nullptr) {
+			detail::throwBadAlloc();
+		}
+		return ptr;
+	}
+
+	SHEAPERD_CPP_NOINLINE void do_deallocate(void* ptr, std::size_t bytes, std::size_t alignment) override {
+		(void)bytes;
+		(void)alignment;
+		detail::heapDeallocate(mInstance, ptr, static_cast<uint32_t>(reinterpret_cast<uintptr_t>(__builtin_return_address(0))));
+	}
+
+	bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+#if defined(__cpp_rtti) || defined(__GXX_RTTI)
+		const memory_resource* resource = dynamic_cast<const memory_resource*>(&other);
+		return resource != nullptr && resource->mInstance == mInstance;
+#else
+		return this == &other;
+#endif
+	}
+
+	sheap_t* mInstance;
+};
+#endif
+
+} // namespace sheap
+
+#endif /* INC_SHEAP_HPP_ */
@@ -0,0 +1,62 @@
+/** @file sheap_arena.h
+ *  @brief Provides the api for arenas (bump allocators) which are carved out of the secure heap (sheap).
+ *
+ *  @author JK
+ *  @bug No known bugs.
+ */
+
+#ifndef INC_SHEAP_ARENA_H_
+#define INC_SHEAP_ARENA_H_
+
+#include "sheap.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct sheap_arena_t sheap_arena_t;
+
+/**
+ * Creates an arena of @param capacity bytes. The arena (control data and object memory) is stored in a single block allocated
+ * from the sheap with the caller id @param id. The objects of an arena are not freed individually but all at once with
+ * 'sheap_arena_reset' or 'sheap_arena_destroy', e.g. the objects of one request of a protocol handler.
+ * The arena is not locked, it must only be used by one task at a time.
+ *
+ * @param capacity	the object memory of the arena in bytes
+ * @param id		the caller id of the arena block and its growth chunks
+ *
+ * @return			the arena or NULL if the arena could not be allocated
+ */
+sheap_arena_t* sheap_arena_create(size_t capacity, uint32_t id);
+
+/**
+ * Frees the arena block and its growth chunks. All objects of the arena become invalid.
+ */
+void sheap_arena_destroy(sheap_arena_t* arena);
+
+/**
+ * Provides @param size bytes (aligned to 'SHEAP_MINIMUM_MALLOC_SIZE') of the arena by incrementing the arena cursor.
+ * With 'SHEAPERD_SHEAP_ARENA_GROWTH' a growth chunk of at least the arena capacity is allocated from the sheap if the remaining
+ * memory is too small.
+ *
+ * @return			the memory or NULL if the arena is exhausted
+ */
+void* sheap_arena_alloc(sheap_arena_t* arena, size_t size);
+
+/**
+ * Releases all objects of the arena and frees its growth chunks. The canary after the object memory of the arena and of each chunk
+ * is checked for an out of bound write ('SHEAPERD_SHEAP_ARENA_CANARY').
+ */
+void sheap_arena_reset(sheap_arena_t* arena);
+
+/**
+ * @return the bytes which can be allocated without a growth chunk
+ */
+size_t sheap_arena_getAvailableBytes(sheap_arena_t* arena);
+size_t sheap_arena_getCapacity(sheap_arena_t* arena);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INC_SHEAP_ARENA_H_ */
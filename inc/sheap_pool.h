@@ -0,0 +1,63 @@
+/** @file sheap_pool.h
+ *  @brief Provides the api for fixed size block pools which are carved out of the secure heap (sheap).
+ *
+ *  @author JK
+ *  @bug No known bugs.
+ */
+
+#ifndef INC_SHEAP_POOL_H_
+#define INC_SHEAP_POOL_H_
+
+#include "sheap.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct sheap_pool_t sheap_pool_t;
+
+/**
+ * Creates a pool of @param count blocks with @param blockSize bytes each. The pool (control data and all blocks)
+ * is stored in a single block allocated from the sheap.
+ * Each pool block only carries a 4 byte tag which is used to detect double free and out of bound writes.
+ *
+ * @param blockSize	the usable size of each block (aligned to 'SHEAP_MINIMUM_MALLOC_SIZE')
+ * @param count		the number of blocks in the pool
+ *
+ * @return			the pool or NULL if the pool could not be allocated
+ */
+sheap_pool_t* sheap_pool_create(size_t blockSize, uint32_t count);
+
+/**
+ * Frees the sheap block used by the pool. All blocks of the pool become invalid.
+ */
+void sheap_pool_destroy(sheap_pool_t* pool);
+
+/**
+ * Provides a block of the pool in constant time.
+ *
+ * @return			the block or NULL if all blocks of the pool are in use
+ */
+void* sheap_pool_alloc(sheap_pool_t* pool);
+
+/**
+ * Returns a block to the pool in constant time.
+ * The tag of the block is checked for a double free and the tag of the following block is checked for an out of bound write.
+ */
+void sheap_pool_free(sheap_pool_t* pool, void* ptr);
+
+uint32_t sheap_pool_getNumberOfFreeBlocks(sheap_pool_t* pool);
+uint32_t sheap_pool_getNumberOfBlocks(sheap_pool_t* pool);
+size_t sheap_pool_getBlockSize(sheap_pool_t* pool);
+
+/**
+ * Tells if @param ptr is in the block memory of the pool (does not check the block tag), e.g. to route a free of an allocator
+ * which uses the heap if the pool is exhausted.
+ */
+bool sheap_pool_contains(sheap_pool_t* pool, const void* ptr);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* INC_SHEAP_POOL_H_ */
@@ -13,6 +13,10 @@
 #include "internal/util.h"
 #include "internal/versioning.h"
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 typedef enum {
 	SHEAPERD_GENERAL_ASSERT,
 	SHEAPERD_ARRAY_BOUND_CHECK,
@@ -38,18 +42,36 @@ typedef enum {
 	SHEAP_CONFIG_ERROR_INVALID_ALLOCATION_STRATEGY,
 	SHEAP_MALLOC_CALL_OVERLAP,
 	SHEAP_FREE_CALL_OVERLAP,
+	SHEAP_POOL_INVALID_SIZE,
+	SHEAP_POOL_EXHAUSTED,
+	SHEAP_POOL_ERROR_INVALID_POOL,
+	SHEAP_POOL_ERROR_INVALID_POINTER,
+	SHEAP_POOL_ERROR_DOUBLE_FREE,
+	SHEAP_POOL_ERROR_OUT_OF_BOUND_WRITE,
+	SHEAP_POOL_ERROR_CORRUPTED_FREE_LIST,
+	SHEAP_INVALID_ALIGNMENT,
+	SHEAP_ARENA_INVALID_SIZE,
+	SHEAP_ARENA_EXHAUSTED,
+	SHEAP_ARENA_ERROR_INVALID_ARENA,
+	SHEAP_ARENA_ERROR_OUT_OF_BOUND_WRITE,
 	STACKGUARD_MPU_NOT_ENABLED,
 	STACKUARD_INVALID_STACKSIZE
 } sheaperd_assertion_t;
 
 #if SHEAPERD_SHEAP_DISABLE_IRQS == 1
-    #define disableIRQs()  __asm("  CPSID i")
-    #define enableIRQs()   __asm("  CPSIE i")
+    #define disableIRQs()  util_enterCriticalSection()
+    #define enableIRQs()   util_exitCriticalSection()
 #else
     #define disableIRQs()  do {} while(0)
     #define enableIRQs()   do {} while(0)
 #endif
 
+/* Can be defined by the port (e.g. for host builds) to tell if the caller runs in an interrupt handler */
+#ifndef SHEAPERD_IS_ISR_CONTEXT
+    #define SHEAPERD_IS_ISR_CONTEXT()   util_isInterruptContext()
+    #define SHEAPERD_USE_IPSR_ISR_CONTEXT   1
+#endif
+
 #ifndef SHEAPERD_USE_SNPRINTF_ASSERT
 	#define SHEAPERD_USE_SNPRINTF_ASSERT 0
 #endif
@@ -72,4 +94,8 @@ typedef void (*sheaperd_assertion_cb) (sheaperd_assertion_t assert, char msg[]);
 void sheaperd_assert(char msg[], sheaperd_assertion_t assertion);
 void sheaperd_init(sheaperd_assertion_cb assertionCallback);
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif /* SHEAPERD_H_ */
@@ -12,6 +12,10 @@
 #include "memory_protection.h"
 #include "sheaperd.h"
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 typedef enum {
 	STACKGUARD_INVALID_MPU_ADDRESS								= -0x01,
 	STACKGUARD_NO_MPU_REGION_LEFT								= -0x02,
@@ -24,6 +28,9 @@ typedef enum {
 	STACKGUARD_TASK_NOT_FOUND									= -0x09,
 	STACKGUARD_MUTEX_ACQUIRE_FAILED								= -0x10,
 	STACKGUARD_INVALID_REGION_NUMBER							= -0x11,
+	STACKGUARD_TASK_TABLE_FULL									= -0x12,
+	STACKGUARD_TASK_TABLE_IN_USE								= -0x13,
+	STACKGUARD_STACK_NOT_PAINTED								= -0x14,
 
 	STACKGUARD_NO_ERROR											= 0x00
 } stackguard_error_t;
@@ -44,12 +51,67 @@ typedef struct {
 
 typedef void (*stackguarg_memFault_cb)(uint32_t faultAddress, stackguard_stackFrame_t stackFrame);
 
+// maximum number of MPU regions guarding one stack (Armv7: a fitted stack can span the sub-regions of two regions)
+#define STACKGUARD_MAX_REGIONS_PER_TASK		2
+
+/**
+ * Stack descriptor of a guarded task (managed by the stackguard). The descriptors are not bound to MPU regions: on a task switch the
+ * next task is mapped to an unused region or to the region of the least recently switched in task. Thus the stacks of the next task and
+ * of the most recently run tasks are guarded, also if more tasks than MPU regions are added.
+ */
+typedef struct {
+	int32_t taskId;
+	// guarded stack memory
+	uint32_t stackBase;
+	uint32_t stackSize;
+	// number of MPU regions guarding the stack (1 or 2)
+	uint32_t regionCount;
+	// precalculated register values with full access / with the switch out permission, the region number is set when written
+	mpu_regionRegisters_t switchedIn[STACKGUARD_MAX_REGIONS_PER_TASK];
+	mpu_regionRegisters_t switchedOut[STACKGUARD_MAX_REGIONS_PER_TASK];
+	// MPU regions the stack is mapped to, -1 if not mapped
+	int32_t region[STACKGUARD_MAX_REGIONS_PER_TASK];
+	// painted words at the low end of the stack found by the last watermark scan, the next scan only searches below
+	uint32_t freeWords;
+	bool isPainted;
+} stackguard_task_t;
+
+/**
+ * Stack usage of a guarded task since its stack was painted ('stackguard_getHighWatermark').
+ */
+typedef struct {
+	int32_t taskId;
+	// stack size, high watermark (maximum used bytes) and never used bytes
+	uint32_t size;
+	uint32_t used;
+	uint32_t free;
+} stackguard_stackUsage_t;
+
+/**
+ * Placement of a stack calculated by 'stackguard_fitStack'. The stack has to be placed at base, size is the usable stack size
+ * (at least the requested size). The region numbers of the regions are set when the task is mapped.
+ */
+typedef struct {
+	uint32_t base;
+	uint32_t size;
+	uint32_t regionCount;
+	mpu_region_t regions[STACKGUARD_MAX_REGIONS_PER_TASK];
+} stackguard_stackFit_t;
+
 /**
  * Initializes the stackguard functionality.
  * As stackguard is using the MPU a call to this function will disable a currently active MPU.
  */
 stackguard_error_t stackguard_init(stackguarg_memFault_cb memFaultCallback);
 
+/**
+ * Replaces the internal task table (STACKGUARD_NUMBER_OF_MPU_REGIONS descriptors) to guard more tasks. The table has to stay valid
+ * while the stackguard is used. Has to be called after 'stackguard_init' and before tasks are added.
+ *
+ * @return error	STACKGUARD_TASK_TABLE_IN_USE (tasks have been added already) or STACKGUARD_MUTEX_ACQUIRE_FAILED
+ */
+stackguard_error_t stackguard_setTaskTable(stackguard_task_t tasks[], uint32_t size);
+
 /**
  * Creates a MPU region for the provided stack pointer address and stack size.
  *
@@ -61,15 +123,115 @@ stackguard_error_t stackguard_init(stackguarg_memFault_cb memFaultCallback);
  * @return error	Possible error return are:
  * 					STACKGUARD_INVALID_MPU_ADDRESS 		(the address is not aligned to 32 bits)
  * 					STACKGUARD_INVALID_STACK_ALIGNMENT 	(on Armv7 architecture: the stack pointer is not properly aligned for the provided @param stackSize)
- * 					STACKGUARD_NO_MPU_REGION_LEFT		(no free MPU region is left to be configured)
+ * 					STACKGUARD_NO_MPU_REGION_LEFT		(no MPU region is available)
+ * 					STACKGUARD_TASK_TABLE_FULL			(no free descriptor is left in the task table, see 'stackguard_setTaskTable')
  * 					STACKGUARD_MUTEX_ACQUIRE_FAILED		(could not acquire the mutex)
  */
 stackguard_error_t stackguard_addTask(uint32_t taskId, uint32_t* sp, mpu_regionSize_t stackSize, mpu_access_permission_t initialAP, bool xn);
+
+/**
+ * Like 'stackguard_addTask' with the stack size in bytes. Armv7: other sizes than powers of two have to be placed as returned by
+ * 'stackguard_fitStack' (STACKGUARD_INVALID_STACK_ALIGNMENT / STACKGUARD_MPU_INVALID_REGION_SIZE otherwise). Armv8: base/limit regions, the size
+ * can be any multiple of 32 bytes and the stack pointer has to be 32 byte aligned (STACKGUARD_MPU_INVALID_REGION_SIZE otherwise).
+ */
 stackguard_error_t stackguard_addTaskByteSize(uint32_t taskId, uint32_t* sp, uint32_t stackSize, mpu_access_permission_t initialAP, bool xn);
+
+/**
+ * Calculates the placement of a stack of stackSize bytes in the memory starting at address.
+ * Armv7: the smallest region whose eight sub-regions cover the stack is used, the sub-regions outside of the stack are disabled. Thus
+ * a 5 KB stack needs 5 KB (1 KB aligned) instead of an 8 KB aligned region. If the stack would cross the region boundary and
+ * allowTwoRegions is set, the stack spans the upper sub-regions of one and the lower sub-regions of the next region, otherwise the base
+ * is moved to the next region boundary. Stacks smaller than 256 bytes use a power of two region (no sub-regions).
+ * Armv8: base and size are aligned to 32 bytes, one region.
+ *
+ * @param address	Lowest address the stack can be placed at, the memory up to the returned base is not used by the stack
+ * @param fit		Receives the placement, has to be passed to 'stackguard_addTaskFitted'
+ *
+ * @return error	STACKGUARD_MPU_INVALID_REGION_SIZE (size is 0 or larger than 2 GB) or STACKGUARD_INVALID_MPU_ADDRESS (no placement
+ * 					below the end of the address space)
+ */
+stackguard_error_t stackguard_fitStack(uint32_t address, uint32_t stackSize, bool allowTwoRegions, stackguard_stackFit_t* fit);
+
+/**
+ * Adds the stack placed with 'stackguard_fitStack'. A stack guarded by two regions uses two MPU regions while it is mapped.
+ * Errors as 'stackguard_addTask', STACKGUARD_NO_MPU_REGION_LEFT if the MPU has fewer regions than the stack needs.
+ */
+stackguard_error_t stackguard_addTaskFitted(uint32_t taskId, const stackguard_stackFit_t* fit, mpu_access_permission_t initialAP, bool xn);
 stackguard_error_t stackguard_removeTask(uint32_t taskId);
 
+/**
+ * Fills the stack of the task with 'STACKGUARD_STACK_PAINT_PATTERN' and resets its watermark. The stack must not be in use (the task is
+ * not started yet), done by the add functions if 'STACKGUARD_PAINT_STACK_ON_ADD' is set.
+ *
+ * @return error	STACKGUARD_TASK_NOT_FOUND or STACKGUARD_MUTEX_ACQUIRE_FAILED
+ */
+stackguard_error_t stackguard_paintStack(uint32_t taskId);
+
+/**
+ * Returns the high watermark of a painted stack (descending stack, the used part grows from the end of the stack). The first painted
+ * word is searched binary in probes of 'STACKGUARD_WATERMARK_PROBE_WORDS' words below the watermark of the last scan, thus the cost is
+ * logarithmic in the stack size and the function can be called periodically (e.g. by a low priority monitor task). Words of the used stack
+ * which hold the pattern in a run of probe size can make the watermark too low. The caller needs read access to the stack (privileged
+ * with the default switch out permission).
+ *
+ * @return error	STACKGUARD_TASK_NOT_FOUND, STACKGUARD_STACK_NOT_PAINTED or STACKGUARD_MUTEX_ACQUIRE_FAILED
+ */
+stackguard_error_t stackguard_getHighWatermark(uint32_t taskId, stackguard_stackUsage_t* usage);
+
+/**
+ * Scans the watermarks of all painted stacks ('stackguard_getHighWatermark'), count receives the number of filled entries (at most size).
+ */
+stackguard_error_t stackguard_getStackUsage(stackguard_stackUsage_t usage[], uint32_t size, uint32_t* count);
+
 stackguard_error_t stackguard_guard();
 
 void stackguard_taskSwitchIn(uint32_t taskId, bool enableMPU);
 
+/**
+ * Returns the descriptor of the task as handle for 'stackguard_taskSwitchInHandle' (NULL if the task is not found). The handle is
+ * stored once in the task control block or a thread local slot of the rtos, see the rtos ports in the port folder. It stays valid
+ * until the task is removed or the task table is replaced.
+ */
+stackguard_task_t* stackguard_getTaskHandle(uint32_t taskId);
+
+/**
+ * Context switch fast path of 'stackguard_taskSwitchIn' to be called from the switch hook of the rtos: no task lookup and no MPU
+ * check, the enable state of the MPU is kept. Only the precalculated register words of the previous and the next task are written
+ * (all regions after the task table changed). NULL or the handle of a removed task switches in no guarded task.
+ */
+void stackguard_taskSwitchInHandle(stackguard_task_t* task);
+
+/*
+ * Rtos switch hook ports (port folder), the task id of a port is the address of the task control block. The add functions store the
+ * handle of the task ('stackguard_getTaskHandle') in the task control block, the switch hook passes it to 'stackguard_taskSwitchInHandle'.
+ */
+#ifdef SHEAPERD_STACKGUARD_PORT_FREERTOS
+struct tskTaskControlBlock;
+// the stack is the buffer passed to xTaskCreateStatic, stackSize in bytes
+stackguard_error_t stackguard_freertos_addTask(struct tskTaskControlBlock* task, void* stack, uint32_t stackSize, mpu_access_permission_t initialAP, bool xn);
+stackguard_error_t stackguard_freertos_removeTask(struct tskTaskControlBlock* task);
+// to be set as traceTASK_SWITCHED_IN in FreeRTOSConfig.h
+void stackguard_freertos_taskSwitchedIn(void);
+#endif
+
+#ifdef SHEAPERD_STACKGUARD_PORT_ZEPHYR
+struct k_thread;
+// guards the stack of thread->stack_info
+stackguard_error_t stackguard_zephyr_addThread(struct k_thread* thread, mpu_access_permission_t initialAP, bool xn);
+stackguard_error_t stackguard_zephyr_removeThread(struct k_thread* thread);
+#endif
+
+#ifdef SHEAPERD_STACKGUARD_PORT_THREADX
+struct TX_THREAD_STRUCT;
+// guards the stack of tx_thread_stack_start / tx_thread_stack_size
+stackguard_error_t stackguard_threadx_addThread(struct TX_THREAD_STRUCT* thread, mpu_access_permission_t initialAP, bool xn);
+stackguard_error_t stackguard_threadx_removeThread(struct TX_THREAD_STRUCT* thread);
+// switch in of _tx_thread_current_ptr, called by _tx_execution_thread_enter if STACKGUARD_THREADX_EXECUTION_HOOKS is set
+void stackguard_threadx_threadSwitchedIn(void);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
 #endif /* STACKGUARD_H_ */
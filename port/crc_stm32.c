@@ -0,0 +1,49 @@
+/** @file crc_stm32.c
+ *  @brief Provides the CRC16 port hook ('SHEAPERD_CRC16_BACKEND_PORT') using the CRC calculation unit of STM32 devices with a
+ *  programmable polynomial (e.g. F0, F3, F7, L0, L4, G0, G4, H7). The fixed CRC32 unit of F1/F2/F4 devices cannot be used.
+ *
+ *  The clock of the CRC unit has to be enabled before sheap is initialized (e.g. __HAL_RCC_CRC_CLK_ENABLE()).
+ *  The unit is reconfigured on each call. If it is also used by the application, the application has to reconfigure it as well and
+ *  must not use it concurrently to a sheap call.
+ *
+ *  @author JK
+ *  @bug No known bugs.
+ */
+
+#include "sheaperd.h"
+
+#ifdef SHEAPERD_CRC_PORT_STM32
+
+#ifndef SHEAPERD_STM32_CRC_BASE
+	#define SHEAPERD_STM32_CRC_BASE			(0x40023000UL)
+#endif
+
+typedef struct {
+	volatile uint32_t DR;
+	volatile uint32_t IDR;
+	volatile uint32_t CR;
+	uint32_t RESERVED;
+	volatile uint32_t INIT;
+	volatile uint32_t POL;
+} stm32_crc_t;
+
+#define STM32_CRC						((stm32_crc_t*)SHEAPERD_STM32_CRC_BASE)
+#define STM32_CRC_CR_RESET				(1UL << 0)
+#define STM32_CRC_CR_POLYSIZE_16		(1UL << 3)
+
+uint16_t sheaperd_port_crc16_calculate(uint8_t const data[], int n) {
+	// CRC-16/CCITT-FALSE: no input/output reversal, initial value 0xFFFF
+	STM32_CRC->POL = SHEAPERD_CRC16_POLY;
+	STM32_CRC->INIT = 0xFFFF;
+	STM32_CRC->CR = STM32_CRC_CR_POLYSIZE_16 | STM32_CRC_CR_RESET;
+	int i = 0;
+	// without input reversal a word is processed starting with bit 31, thus the first byte is placed in the upper byte
+	for (; i + 4 <= n; i += 4) {
+		STM32_CRC->DR = ((uint32_t)data[i] << 24) | ((uint32_t)data[i + 1] << 16) | ((uint32_t)data[i + 2] << 8) | data[i + 3];
+	}
+	for (; i < n; i++) {
+		*((volatile uint8_t*)&STM32_CRC->DR) = data[i];
+	}
+	return (uint16_t)(STM32_CRC->DR) ^ SHEAPERD_CRC16_XOR_OUT;
+}
+#endif
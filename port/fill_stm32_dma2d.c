@@ -0,0 +1,109 @@
+/** @file fill_stm32_dma2d.c
+ *  @brief Provides the fill port hook ('SHEAPERD_DMA_FILL') using the register to memory mode of the STM32 DMA2D (e.g. F4x9, F7, H7).
+ *
+ *  The words are written as ARGB8888 pixels of an output area with up to 16383 pixels per line, the bytes which do not fill a complete
+ *  line are left to the CPU. The clock of the DMA2D has to be enabled before sheap is initialized (e.g. __HAL_RCC_DMA2D_CLK_ENABLE()).
+ *  A transfer started by the application (e.g. the graphics library) is not interrupted, the CPU fills the memory instead. The DMA2D has to
+ *  be able to access the heap memory (external SDRAM, AXI SRAM; not the DTCM).
+ *  With SHEAPERD_DMA2D_DCACHE_MAINTENANCE the range is cleaned and invalidated in the data cache of the Cortex-M7 before the transfer and
+ *  invalidated after the transfer (not needed for a non cacheable or write through heap).
+ *
+ *  @author JK
+ *  @bug No known bugs.
+ */
+
+#include "sheaperd.h"
+
+#if defined(SHEAPERD_FILL_PORT_STM32_DMA2D) && SHEAPERD_DMA_FILL == 1
+
+#ifndef SHEAPERD_STM32_DMA2D_BASE
+	#define SHEAPERD_STM32_DMA2D_BASE		(0x4002B000UL)
+#endif
+#ifndef SHEAPERD_DMA2D_DCACHE_MAINTENANCE
+	#define SHEAPERD_DMA2D_DCACHE_MAINTENANCE	0
+#endif
+
+typedef struct {
+	volatile uint32_t CR;
+	volatile uint32_t ISR;
+	volatile uint32_t IFCR;
+	volatile uint32_t FGMAR;
+	volatile uint32_t FGOR;
+	volatile uint32_t BGMAR;
+	volatile uint32_t BGOR;
+	volatile uint32_t FGPFCCR;
+	volatile uint32_t FGCOLR;
+	volatile uint32_t BGPFCCR;
+	volatile uint32_t BGCOLR;
+	volatile uint32_t FGCMAR;
+	volatile uint32_t BGCMAR;
+	volatile uint32_t OPFCCR;
+	volatile uint32_t OCOLR;
+	volatile uint32_t OMAR;
+	volatile uint32_t OOR;
+	volatile uint32_t NLR;
+} stm32_dma2d_t;
+
+#define STM32_DMA2D						((stm32_dma2d_t*)SHEAPERD_STM32_DMA2D_BASE)
+#define STM32_DMA2D_CR_START			(1UL << 0)
+#define STM32_DMA2D_CR_MODE_R2M			(3UL << 16)
+#define STM32_DMA2D_ISR_TEIF			(1UL << 0)
+#define STM32_DMA2D_ISR_TCIF			(1UL << 1)
+#define STM32_DMA2D_ISR_CEIF			(1UL << 5)
+#define STM32_DMA2D_OPFCCR_ARGB8888		0UL
+#define STM32_DMA2D_MAX_PIXELS_PER_LINE	16383UL
+#define STM32_DMA2D_MAX_LINES			65535UL
+
+#if SHEAPERD_DMA2D_DCACHE_MAINTENANCE == 1
+#define SCB_DCIMVAC						(*((volatile uint32_t*)0xE000EF5CUL))
+#define SCB_DCCIMVAC					(*((volatile uint32_t*)0xE000EF70UL))
+#define DCACHE_LINE_SIZE				32UL
+
+static void maintainDCache(volatile uint32_t* reg, uint32_t address, size_t size){
+	__asm volatile("\tdsb\n" : : : "memory");
+	for(uint32_t line = address & ~(DCACHE_LINE_SIZE - 1); line < address + size; line += DCACHE_LINE_SIZE){
+		*reg = line;
+	}
+	__asm volatile("\tdsb\n\tisb\n" : : : "memory");
+}
+#endif
+
+size_t sheaperd_port_dmaFill(uint32_t* ptr, uint32_t pattern, size_t size){
+	uint32_t pixels = size / sizeof(uint32_t);
+	if(pixels == 0){
+		return 0;
+	}
+	if((STM32_DMA2D->CR & STM32_DMA2D_CR_START) != 0){
+		// in use by the application
+		return 0;
+	}
+	uint32_t pixelsPerLine = pixels < STM32_DMA2D_MAX_PIXELS_PER_LINE ? pixels : STM32_DMA2D_MAX_PIXELS_PER_LINE;
+	uint32_t lines = pixels / pixelsPerLine;
+	if(lines > STM32_DMA2D_MAX_LINES){
+		lines = STM32_DMA2D_MAX_LINES;
+	}
+	size_t filled = (size_t)pixelsPerLine * lines * sizeof(uint32_t);
+#if SHEAPERD_DMA2D_DCACHE_MAINTENANCE == 1
+	// dirty lines would be written over the pattern when they are evicted
+	maintainDCache(&SCB_DCCIMVAC, (uint32_t)ptr, filled);
+#endif
+	STM32_DMA2D->IFCR = STM32_DMA2D_ISR_TEIF | STM32_DMA2D_ISR_TCIF | STM32_DMA2D_ISR_CEIF;
+	STM32_DMA2D->OPFCCR = STM32_DMA2D_OPFCCR_ARGB8888;
+	STM32_DMA2D->OCOLR = pattern;
+	STM32_DMA2D->OMAR = (uint32_t)ptr;
+	STM32_DMA2D->OOR = 0;
+	STM32_DMA2D->NLR = (pixelsPerLine << 16) | lines;
+	STM32_DMA2D->CR = STM32_DMA2D_CR_MODE_R2M | STM32_DMA2D_CR_START;
+	uint32_t status;
+	do{
+		status = STM32_DMA2D->ISR;
+	}while((status & (STM32_DMA2D_ISR_TCIF | STM32_DMA2D_ISR_TEIF | STM32_DMA2D_ISR_CEIF)) == 0);
+	STM32_DMA2D->IFCR = STM32_DMA2D_ISR_TEIF | STM32_DMA2D_ISR_TCIF | STM32_DMA2D_ISR_CEIF;
+#if SHEAPERD_DMA2D_DCACHE_MAINTENANCE == 1
+	// lines fetched speculatively during the transfer
+	maintainDCache(&SCB_DCIMVAC, (uint32_t)ptr, filled);
+#endif
+	// transfer error: the memory is filled by the CPU
+	return (status & STM32_DMA2D_ISR_TCIF) != 0 ? filled : 0;
+}
+#endif
@@ -0,0 +1,98 @@
+/** @file lock_freertos.c
+ *  @brief Provides the native FreeRTOS lock of the sheap, the pools and the stackguard ('SHEAPERD_LOCK_PORT_FREERTOS')
+ *
+ *  The mutex is a binary semaphore (can be taken from interrupt handlers, no priority inheritance like the CMSIS mutex of sheaperd).
+ *  The scheduler lock suspends all tasks (vTaskSuspendAll), interrupts keep running. Requires INCLUDE_xTaskGetCurrentTaskHandle.
+ *
+ *  @author JK
+ *  @bug No known bugs.
+ */
+
+#include "sheaperd.h"
+
+#if SHEAPERD_USE_LOCK_PORT == 1 && SHEAPERD_LOCK_PORT == SHEAPERD_LOCK_PORT_FREERTOS
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+
+bool sheaperd_port_lockInit(sheaperd_portLock_t* lock, const char* name) {
+    lock->key = 0;
+    lock->isLocked = false;
+#if SHEAPERD_LOCK_PORT_SCHEDULER_LOCK == 1
+    (void)name;
+    lock->handle = NULL;
+    return true;
+#else
+    if(lock->handle != NULL) {
+        vSemaphoreDelete((SemaphoreHandle_t)lock->handle);
+    }
+    SemaphoreHandle_t semaphore = xSemaphoreCreateBinary();
+    lock->handle = semaphore;
+    if(semaphore == NULL) {
+        return false;
+    }
+#if configQUEUE_REGISTRY_SIZE > 0
+    vQueueAddToRegistry(semaphore, name);
+#else
+    (void)name;
+#endif
+    // binary semaphores are created empty
+    xSemaphoreGive(semaphore);
+    return true;
+#endif
+}
+
+void sheaperd_port_lockDelete(sheaperd_portLock_t* lock) {
+    if(lock->handle != NULL) {
+        vSemaphoreDelete((SemaphoreHandle_t)lock->handle);
+        lock->handle = NULL;
+    }
+}
+
+bool sheaperd_port_lockAcquire(sheaperd_portLock_t* lock, uint32_t timeout) {
+#if SHEAPERD_LOCK_PORT_SCHEDULER_LOCK == 1
+    (void)timeout;
+    vTaskSuspendAll();
+    // an interrupt handler reading the flag before it is set finishes before the task continues
+    lock->isLocked = true;
+    return true;
+#else
+    return xSemaphoreTake((SemaphoreHandle_t)lock->handle, (TickType_t)timeout) == pdTRUE;
+#endif
+}
+
+void sheaperd_port_lockRelease(sheaperd_portLock_t* lock) {
+#if SHEAPERD_LOCK_PORT_SCHEDULER_LOCK == 1
+    lock->isLocked = false;
+    (void)xTaskResumeAll();
+#else
+    xSemaphoreGive((SemaphoreHandle_t)lock->handle);
+#endif
+}
+
+bool sheaperd_port_lockTryAcquireFromISR(sheaperd_portLock_t* lock) {
+#if SHEAPERD_LOCK_PORT_SCHEDULER_LOCK == 1
+    UBaseType_t mask = taskENTER_CRITICAL_FROM_ISR();
+    bool acquired = !lock->isLocked;
+    lock->isLocked = true;
+    taskEXIT_CRITICAL_FROM_ISR(mask);
+    return acquired;
+#else
+    return xSemaphoreTakeFromISR((SemaphoreHandle_t)lock->handle, NULL) == pdTRUE;
+#endif
+}
+
+void sheaperd_port_lockReleaseFromISR(sheaperd_portLock_t* lock) {
+#if SHEAPERD_LOCK_PORT_SCHEDULER_LOCK == 1
+    lock->isLocked = false;
+#else
+    BaseType_t isYieldRequired = pdFALSE;
+    xSemaphoreGiveFromISR((SemaphoreHandle_t)lock->handle, &isYieldRequired);
+    portYIELD_FROM_ISR(isYieldRequired);
+#endif
+}
+
+void* sheaperd_port_threadId() {
+    return xTaskGetCurrentTaskHandle();
+}
+#endif
@@ -0,0 +1,115 @@
+/** @file lock_threadx.c
+ *  @brief Provides the native ThreadX lock of the sheap, the pools and the stackguard ('SHEAPERD_LOCK_PORT_THREADX')
+ *
+ *  The mutex is a TX_SEMAPHORE with a count of one (TX_MUTEX is recursive and can't be used from interrupt handlers). The semaphores
+ *  are taken from a static array of 'SHEAPERD_LOCK_PORT_MAX_LOCKS' entries. The scheduler lock disables the preemption of the calling
+ *  thread (preemption threshold 0), interrupts keep running.
+ *
+ *  @author JK
+ *  @bug No known bugs.
+ */
+
+#include "sheaperd.h"
+
+#if SHEAPERD_USE_LOCK_PORT == 1 && SHEAPERD_LOCK_PORT == SHEAPERD_LOCK_PORT_THREADX
+#include "tx_api.h"
+
+#if SHEAPERD_LOCK_PORT_SCHEDULER_LOCK == 0
+static TX_SEMAPHORE gSemaphores[SHEAPERD_LOCK_PORT_MAX_LOCKS];
+static bool gIsSemaphoreUsed[SHEAPERD_LOCK_PORT_MAX_LOCKS];
+#endif
+
+bool sheaperd_port_lockInit(sheaperd_portLock_t* lock, const char* name) {
+    lock->key = 0;
+    lock->isLocked = false;
+#if SHEAPERD_LOCK_PORT_SCHEDULER_LOCK == 1
+    (void)name;
+    lock->handle = NULL;
+    return true;
+#else
+    TX_SEMAPHORE* semaphore = lock->handle;
+    if(semaphore != NULL) {
+        (void)tx_semaphore_delete(semaphore);
+    }
+    TX_INTERRUPT_SAVE_AREA
+    TX_DISABLE
+    for(uint32_t i = 0; semaphore == NULL && i < SHEAPERD_LOCK_PORT_MAX_LOCKS; i++) {
+        if(!gIsSemaphoreUsed[i]) {
+            gIsSemaphoreUsed[i] = true;
+            semaphore = &gSemaphores[i];
+        }
+    }
+    TX_RESTORE
+    lock->handle = semaphore;
+    return semaphore != NULL && tx_semaphore_create(semaphore, (CHAR*)name, 1) == TX_SUCCESS;
+#endif
+}
+
+void sheaperd_port_lockDelete(sheaperd_portLock_t* lock) {
+#if SHEAPERD_LOCK_PORT_SCHEDULER_LOCK == 0
+    if(lock->handle != NULL) {
+        (void)tx_semaphore_delete((TX_SEMAPHORE*)lock->handle);
+        gIsSemaphoreUsed[(TX_SEMAPHORE*)lock->handle - gSemaphores] = false;
+        lock->handle = NULL;
+    }
+#else
+    (void)lock;
+#endif
+}
+
+bool sheaperd_port_lockAcquire(sheaperd_portLock_t* lock, uint32_t timeout) {
+#if SHEAPERD_LOCK_PORT_SCHEDULER_LOCK == 1
+    (void)timeout;
+    // no thread is running before the kernel is started
+    TX_THREAD* thread = tx_thread_identify();
+    UINT previousThreshold = 0;
+    if(thread != TX_NULL) {
+        (void)tx_thread_preemption_change(thread, 0, &previousThreshold);
+    }
+    lock->key = previousThreshold;
+    // an interrupt handler reading the flag before it is set finishes before the thread continues
+    lock->isLocked = true;
+    return true;
+#else
+    return tx_semaphore_get((TX_SEMAPHORE*)lock->handle, (ULONG)timeout) == TX_SUCCESS;
+#endif
+}
+
+void sheaperd_port_lockRelease(sheaperd_portLock_t* lock) {
+#if SHEAPERD_LOCK_PORT_SCHEDULER_LOCK == 1
+    lock->isLocked = false;
+    TX_THREAD* thread = tx_thread_identify();
+    UINT threshold;
+    if(thread != TX_NULL) {
+        (void)tx_thread_preemption_change(thread, (UINT)lock->key, &threshold);
+    }
+#else
+    (void)tx_semaphore_put((TX_SEMAPHORE*)lock->handle);
+#endif
+}
+
+bool sheaperd_port_lockTryAcquireFromISR(sheaperd_portLock_t* lock) {
+#if SHEAPERD_LOCK_PORT_SCHEDULER_LOCK == 1
+    TX_INTERRUPT_SAVE_AREA
+    TX_DISABLE
+    bool acquired = !lock->isLocked;
+    lock->isLocked = true;
+    TX_RESTORE
+    return acquired;
+#else
+    return tx_semaphore_get((TX_SEMAPHORE*)lock->handle, TX_NO_WAIT) == TX_SUCCESS;
+#endif
+}
+
+void sheaperd_port_lockReleaseFromISR(sheaperd_portLock_t* lock) {
+#if SHEAPERD_LOCK_PORT_SCHEDULER_LOCK == 1
+    lock->isLocked = false;
+#else
+    (void)tx_semaphore_put((TX_SEMAPHORE*)lock->handle);
+#endif
+}
+
+void* sheaperd_port_threadId() {
+    return tx_thread_identify();
+}
+#endif
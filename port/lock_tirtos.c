@@ -0,0 +1,90 @@
+/** @file lock_tirtos.c
+ *  @brief Provides the native TI-RTOS lock of the sheap, the pools and the stackguard ('SHEAPERD_LOCK_PORT_TIRTOS')
+ *
+ *  The mutex is a binary Semaphore (pend with BIOS_NO_WAIT from Hwi/Swi). The scheduler lock disables the task scheduler (Task_disable),
+ *  Hwi and Swi keep running.
+ *
+ *  @author JK
+ *  @bug No known bugs.
+ */
+
+#include "sheaperd.h"
+
+#if SHEAPERD_USE_LOCK_PORT == 1 && SHEAPERD_LOCK_PORT == SHEAPERD_LOCK_PORT_TIRTOS
+#include <xdc/std.h>
+#include <ti/sysbios/BIOS.h>
+#include <ti/sysbios/hal/Hwi.h>
+#include <ti/sysbios/knl/Semaphore.h>
+#include <ti/sysbios/knl/Task.h>
+
+bool sheaperd_port_lockInit(sheaperd_portLock_t* lock, const char* name) {
+    lock->key = 0;
+    lock->isLocked = false;
+#if SHEAPERD_LOCK_PORT_SCHEDULER_LOCK == 1
+    (void)name;
+    lock->handle = NULL;
+    return true;
+#else
+    sheaperd_port_lockDelete(lock);
+    Semaphore_Params params;
+    Semaphore_Params_init(&params);
+    params.mode = Semaphore_Mode_BINARY;
+    params.instance->name = (String)name;
+    lock->handle = Semaphore_create(1, &params, NULL);
+    return lock->handle != NULL;
+#endif
+}
+
+void sheaperd_port_lockDelete(sheaperd_portLock_t* lock) {
+    if(lock->handle != NULL) {
+        Semaphore_Handle semaphore = (Semaphore_Handle)lock->handle;
+        Semaphore_delete(&semaphore);
+        lock->handle = NULL;
+    }
+}
+
+bool sheaperd_port_lockAcquire(sheaperd_portLock_t* lock, uint32_t timeout) {
+#if SHEAPERD_LOCK_PORT_SCHEDULER_LOCK == 1
+    (void)timeout;
+    lock->key = (uint32_t)Task_disable();
+    // an interrupt handler reading the flag before it is set finishes before the task continues
+    lock->isLocked = true;
+    return true;
+#else
+    return Semaphore_pend((Semaphore_Handle)lock->handle, timeout);
+#endif
+}
+
+void sheaperd_port_lockRelease(sheaperd_portLock_t* lock) {
+#if SHEAPERD_LOCK_PORT_SCHEDULER_LOCK == 1
+    lock->isLocked = false;
+    Task_restore((UInt)lock->key);
+#else
+    Semaphore_post((Semaphore_Handle)lock->handle);
+#endif
+}
+
+bool sheaperd_port_lockTryAcquireFromISR(sheaperd_portLock_t* lock) {
+#if SHEAPERD_LOCK_PORT_SCHEDULER_LOCK == 1
+    UInt key = Hwi_disable();
+    bool acquired = !lock->isLocked;
+    lock->isLocked = true;
+    Hwi_restore(key);
+    return acquired;
+#else
+    return Semaphore_pend((Semaphore_Handle)lock->handle, BIOS_NO_WAIT);
+#endif
+}
+
+void sheaperd_port_lockReleaseFromISR(sheaperd_portLock_t* lock) {
+#if SHEAPERD_LOCK_PORT_SCHEDULER_LOCK == 1
+    lock->isLocked = false;
+#else
+    Semaphore_post((Semaphore_Handle)lock->handle);
+#endif
+}
+
+void* sheaperd_port_threadId() {
+    return Task_self();
+}
+#endif
@@ -0,0 +1,99 @@
+/** @file lock_zephyr.c
+ *  @brief Provides the native Zephyr lock of the sheap, the pools and the stackguard ('SHEAPERD_LOCK_PORT_ZEPHYR')
+ *
+ *  The mutex is a k_sem with a limit of one (the k_mutex is recursive and can't be used from interrupt handlers). The semaphores are
+ *  taken from a static array of 'SHEAPERD_LOCK_PORT_MAX_LOCKS' entries. The scheduler lock is k_sched_lock, interrupts keep running.
+ *
+ *  @author JK
+ *  @bug No known bugs.
+ */
+
+#include "sheaperd.h"
+
+#if SHEAPERD_USE_LOCK_PORT == 1 && SHEAPERD_LOCK_PORT == SHEAPERD_LOCK_PORT_ZEPHYR
+#include <zephyr/kernel.h>
+
+#if SHEAPERD_LOCK_PORT_SCHEDULER_LOCK == 0
+static struct k_sem gSemaphores[SHEAPERD_LOCK_PORT_MAX_LOCKS];
+static bool gIsSemaphoreUsed[SHEAPERD_LOCK_PORT_MAX_LOCKS];
+#endif
+
+bool sheaperd_port_lockInit(sheaperd_portLock_t* lock, const char* name) {
+    (void)name;
+    lock->key = 0;
+    lock->isLocked = false;
+#if SHEAPERD_LOCK_PORT_SCHEDULER_LOCK == 1
+    lock->handle = NULL;
+    return true;
+#else
+    // a lock created before keeps its semaphore
+    struct k_sem* semaphore = lock->handle;
+    unsigned int key = irq_lock();
+    for(uint32_t i = 0; semaphore == NULL && i < SHEAPERD_LOCK_PORT_MAX_LOCKS; i++) {
+        if(!gIsSemaphoreUsed[i]) {
+            gIsSemaphoreUsed[i] = true;
+            semaphore = &gSemaphores[i];
+        }
+    }
+    irq_unlock(key);
+    lock->handle = semaphore;
+    return semaphore != NULL && k_sem_init(semaphore, 1, 1) == 0;
+#endif
+}
+
+void sheaperd_port_lockDelete(sheaperd_portLock_t* lock) {
+#if SHEAPERD_LOCK_PORT_SCHEDULER_LOCK == 0
+    if(lock->handle != NULL) {
+        gIsSemaphoreUsed[(struct k_sem*)lock->handle - gSemaphores] = false;
+        lock->handle = NULL;
+    }
+#else
+    (void)lock;
+#endif
+}
+
+bool sheaperd_port_lockAcquire(sheaperd_portLock_t* lock, uint32_t timeout) {
+#if SHEAPERD_LOCK_PORT_SCHEDULER_LOCK == 1
+    (void)timeout;
+    k_sched_lock();
+    // an interrupt handler reading the flag before it is set finishes before the thread continues
+    lock->isLocked = true;
+    return true;
+#else
+    return k_sem_take((struct k_sem*)lock->handle, K_TICKS(timeout)) == 0;
+#endif
+}
+
+void sheaperd_port_lockRelease(sheaperd_portLock_t* lock) {
+#if SHEAPERD_LOCK_PORT_SCHEDULER_LOCK == 1
+    lock->isLocked = false;
+    k_sched_unlock();
+#else
+    k_sem_give((struct k_sem*)lock->handle);
+#endif
+}
+
+bool sheaperd_port_lockTryAcquireFromISR(sheaperd_portLock_t* lock) {
+#if SHEAPERD_LOCK_PORT_SCHEDULER_LOCK == 1
+    unsigned int key = irq_lock();
+    bool acquired = !lock->isLocked;
+    lock->isLocked = true;
+    irq_unlock(key);
+    return acquired;
+#else
+    return k_sem_take((struct k_sem*)lock->handle, K_NO_WAIT) == 0;
+#endif
+}
+
+void sheaperd_port_lockReleaseFromISR(sheaperd_portLock_t* lock) {
+#if SHEAPERD_LOCK_PORT_SCHEDULER_LOCK == 1
+    lock->isLocked = false;
+#else
+    k_sem_give((struct k_sem*)lock->handle);
+#endif
+}
+
+void* sheaperd_port_threadId() {
+    return k_current_get();
+}
+#endif
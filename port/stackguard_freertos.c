@@ -0,0 +1,49 @@
+/** @file stackguard_freertos.c
+ *  @brief Provides the stackguard task switch hook for FreeRTOS (traceTASK_SWITCHED_IN)
+ *
+ *  The handle of a guarded task is stored in the thread local storage pointer 'STACKGUARD_FREERTOS_TLS_INDEX' of its TCB.
+ *  FreeRTOSConfig.h:
+ *
+ *  	#define configNUM_THREAD_LOCAL_STORAGE_POINTERS	1
+ *  	#if !defined(__ASSEMBLER__) && !defined(__IAR_SYSTEMS_ASM__)
+ *  	void stackguard_freertos_taskSwitchedIn(void);
+ *  	#endif
+ *  	#define traceTASK_SWITCHED_IN()	stackguard_freertos_taskSwitchedIn()
+ *
+ *  The hook runs in vTaskSwitchContext (called by PendSV on Cortex-M) after pxCurrentTCB was set to the next task.
+ *
+ *  @author JK
+ *  @bug No known bugs.
+ */
+
+#include "stackguard.h"
+
+#ifdef SHEAPERD_STACKGUARD_PORT_FREERTOS
+#include "FreeRTOS.h"
+#include "task.h"
+
+#ifndef STACKGUARD_FREERTOS_TLS_INDEX
+#define STACKGUARD_FREERTOS_TLS_INDEX	0
+#endif
+
+#if STACKGUARD_FREERTOS_TLS_INDEX >= configNUM_THREAD_LOCAL_STORAGE_POINTERS
+#error "STACKGUARD_FREERTOS_TLS_INDEX requires a thread local storage pointer (configNUM_THREAD_LOCAL_STORAGE_POINTERS)"
+#endif
+
+stackguard_error_t stackguard_freertos_addTask(TaskHandle_t task, void* stack, uint32_t stackSize, mpu_access_permission_t initialAP, bool xn) {
+    stackguard_error_t error = stackguard_addTaskByteSize((uint32_t)task, (uint32_t*)stack, stackSize, initialAP, xn);
+    if(error == STACKGUARD_NO_ERROR) {
+        vTaskSetThreadLocalStoragePointer(task, STACKGUARD_FREERTOS_TLS_INDEX, stackguard_getTaskHandle((uint32_t)task));
+    }
+    return error;
+}
+
+stackguard_error_t stackguard_freertos_removeTask(TaskHandle_t task) {
+    vTaskSetThreadLocalStoragePointer(task, STACKGUARD_FREERTOS_TLS_INDEX, NULL);
+    return stackguard_removeTask((uint32_t)task);
+}
+
+void stackguard_freertos_taskSwitchedIn(void) {
+    stackguard_taskSwitchInHandle(pvTaskGetThreadLocalStoragePointer(NULL, STACKGUARD_FREERTOS_TLS_INDEX));
+}
+#endif
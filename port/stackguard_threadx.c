@@ -0,0 +1,53 @@
+/** @file stackguard_threadx.c
+ *  @brief Provides the stackguard thread switch hook for ThreadX (execution profile hooks)
+ *
+ *  The handle of a guarded thread is stored in a field added to TX_THREAD. tx_user.h:
+ *
+ *  	#define TX_THREAD_USER_EXTENSION	VOID* tx_thread_stackguard_task;
+ *  	#define TX_EXECUTION_PROFILE_ENABLE
+ *
+ *  With TX_EXECUTION_PROFILE_ENABLE the Cortex-M scheduler (PendSV) calls _tx_execution_thread_enter after _tx_thread_current_ptr was
+ *  set to the next thread. If the execution profile kit is used, set STACKGUARD_THREADX_EXECUTION_HOOKS to 0 and call
+ *  'stackguard_threadx_threadSwitchedIn' from its _tx_execution_thread_enter.
+ *
+ *  @author JK
+ *  @bug No known bugs.
+ */
+
+#include "stackguard.h"
+
+#ifdef SHEAPERD_STACKGUARD_PORT_THREADX
+#include "tx_api.h"
+#include "tx_thread.h"
+
+#ifndef STACKGUARD_THREADX_EXECUTION_HOOKS
+#define STACKGUARD_THREADX_EXECUTION_HOOKS	1
+#endif
+
+stackguard_error_t stackguard_threadx_addThread(TX_THREAD* thread, mpu_access_permission_t initialAP, bool xn) {
+    stackguard_error_t error = stackguard_addTaskByteSize((uint32_t)thread, (uint32_t*)thread->tx_thread_stack_start, thread->tx_thread_stack_size, initialAP, xn);
+    if(error == STACKGUARD_NO_ERROR) {
+        thread->tx_thread_stackguard_task = stackguard_getTaskHandle((uint32_t)thread);
+    }
+    return error;
+}
+
+stackguard_error_t stackguard_threadx_removeThread(TX_THREAD* thread) {
+    thread->tx_thread_stackguard_task = NULL;
+    return stackguard_removeTask((uint32_t)thread);
+}
+
+void stackguard_threadx_threadSwitchedIn(void) {
+    TX_THREAD* thread = _tx_thread_current_ptr;
+    stackguard_taskSwitchInHandle(thread != TX_NULL ? thread->tx_thread_stackguard_task : NULL);
+}
+
+#if STACKGUARD_THREADX_EXECUTION_HOOKS == 1
+VOID _tx_execution_thread_enter(void) {
+    stackguard_threadx_threadSwitchedIn();
+}
+
+VOID _tx_execution_thread_exit(void) {
+}
+#endif
+#endif
@@ -0,0 +1,39 @@
+/** @file stackguard_zephyr.c
+ *  @brief Provides the stackguard thread switch hook for Zephyr (user tracing hook)
+ *
+ *  The handle of a guarded thread is stored in its custom data. Required Kconfig options: CONFIG_TRACING, CONFIG_TRACING_USER,
+ *  CONFIG_THREAD_CUSTOM_DATA and CONFIG_THREAD_STACK_INFO. The custom data of guarded threads must not be used by the application.
+ *  On Cortex-M the hook runs in PendSV after the current thread was set to the next thread. The stackguard regions must not overlap
+ *  the MPU regions used by Zephyr (CONFIG_ARM_MPU).
+ *
+ *  @author JK
+ *  @bug No known bugs.
+ */
+
+#include "stackguard.h"
+
+#ifdef SHEAPERD_STACKGUARD_PORT_ZEPHYR
+#include <zephyr/kernel.h>
+#include <tracing_user.h>
+
+#if !defined(CONFIG_TRACING_USER) || !defined(CONFIG_THREAD_CUSTOM_DATA) || !defined(CONFIG_THREAD_STACK_INFO)
+#error "The stackguard zephyr port requires CONFIG_TRACING_USER, CONFIG_THREAD_CUSTOM_DATA and CONFIG_THREAD_STACK_INFO"
+#endif
+
+stackguard_error_t stackguard_zephyr_addThread(struct k_thread* thread, mpu_access_permission_t initialAP, bool xn) {
+    stackguard_error_t error = stackguard_addTaskByteSize((uint32_t)thread, (uint32_t*)thread->stack_info.start, thread->stack_info.size, initialAP, xn);
+    if(error == STACKGUARD_NO_ERROR) {
+        thread->custom_data = stackguard_getTaskHandle((uint32_t)thread);
+    }
+    return error;
+}
+
+stackguard_error_t stackguard_zephyr_removeThread(struct k_thread* thread) {
+    thread->custom_data = NULL;
+    return stackguard_removeTask((uint32_t)thread);
+}
+
+void sys_trace_thread_switched_in_user(void) {
+    stackguard_taskSwitchInHandle(k_current_get()->custom_data);
+}
+#endif
@@ -12,7 +12,7 @@
 
 #include "internal/opt.h"
 
-#if MEMORY_PROTECTION && SHEAPERD_ARMV7
+#if MEMORY_PROTECTION && (SHEAPERD_ARMV7 || SHEAPERD_ARMV8)
 #include "memory_protection.h"
 
 #define ASSERT_RETURN_ERROR_ON_FAILURE(assert, error)	\
@@ -24,13 +24,25 @@ do{                                                     \
 
 #define MPU_REGION_ADDRESS_32BIT_ALIGNMENT_MASK	0x1F
 
-#define MPU_RASR_SIZE_Pos						1
-#define MPU_RASR_SRD_Pos						8
-#define MPU_RASR_TEX_SCB_Pos					16
-#define MPU_RASR_AP_Pos							24
-#define MPU_RASR_XN_Pos							28
+#if SHEAPERD_ARMV7
+	#define MPU_RASR_SIZE_Pos					1
+	#define MPU_RASR_SRD_Pos					8
+	#define MPU_RASR_TEX_SCB_Pos				16
+	#define MPU_RASR_AP_Pos						24
+	#define MPU_RASR_XN_Pos						28
 
-#define MPU_RBAR_VALID_Pos						4
+	#define MPU_RBAR_VALID_Pos					4
+#elif SHEAPERD_ARMV8
+	#define MPU_RBAR_XN_Pos						0
+	#define MPU_RBAR_AP_Pos						1
+	#define MPU_RBAR_SH_Pos						3
+	#define MPU_RBAR_SH_OUTER_SHAREABLE			0x2
+	#define MPU_RLAR_ATTRINDX_Pos				1
+	#define MPU_RLAR_LIMIT_Msk					0xFFFFFFE0
+	#define MPU_RNR_ALIAS_Msk					0x3
+#endif
+// regions written by one burst (RBAR/RASR resp. RBAR/RLAR and the three alias pairs)
+#define MPU_ALIAS_REGION_COUNT					4
 #define MPU_CTRL_PRIVDEFENA_Pos					2
 
 #ifndef MPU_TYPE_DREGION_Pos
@@ -91,6 +103,7 @@ typedef struct {
 } MPU_Type;
 #endif
 
+#if SHEAPERD_ARMV7
 #define MEMORY_PROTECTION_ALIGNMENT_TABLE_OFFSET	4
 static uint32_t gAlignmentTable[28] = {
 	0x1F,			0x3F,			0x7F,			0xFF,
@@ -101,13 +114,34 @@ static uint32_t gAlignmentTable[28] = {
 	0x1FFFFFF,		0x3FFFFFF,		0x7FFFFFF,		0xFFFFFFF,
 	0x1FFFFFFF,		0x3FFFFFFF,		0x7FFFFFFF,		0xFFFFFFFF,
 };
+#endif
 
+#if SHEAPERD_ARMV7 || SHEAPERD_MPU_M33_M35P
+static void writeRegionBurst(const uint32_t words[2 * MPU_ALIAS_REGION_COUNT]);
+#endif
 static bool isAddressValid(uint32_t address);
-static bool isAlignmentValid(mpu_region_t* region);
+#if SHEAPERD_ARMV7
+static bool isAlignmentValid(const mpu_region_t* region);
+#elif SHEAPERD_ARMV8
+static uint32_t getAccessPermission(mpu_access_permission_t ap, bool* xn);
+#endif
 
 mpu_error_t memory_protection_configureRegion(mpu_region_t* region, bool activateMPU){
 	ASSERT_RETURN_ERROR_ON_FAILURE(memory_protection_getNumberOfMPURegions() == 0, NO_MPU_AVAILABLE);
 	memory_protection_disableMPU();
+	mpu_regionRegisters_t registers;
+	mpu_error_t error = memory_protection_encodeRegion(region, &registers);
+	if(error != NO_ERROR){
+		return error;
+	}
+	memory_protection_writeRegion(&registers);
+	if(activateMPU) {
+        memory_protection_enableMPU();
+	}
+	return NO_ERROR;
+}
+
+mpu_error_t memory_protection_encodeRegion(const mpu_region_t* region, mpu_regionRegisters_t* registers){
 	if(!isAddressValid(region->address)){
 		return INVALID_REGION_ADDRESS;
 	}
@@ -115,20 +149,113 @@ mpu_error_t memory_protection_configureRegion(mpu_region_t* region, bool activat
 	if(!isAlignmentValid(region)){
 		return INVALID_REGION_ADDRESS_ALIGNMENT;
 	}
+#elif SHEAPERD_ARMV8
+	// the limit is the last byte of a 32 byte block
+	if(region->limit <= region->address || !isAddressValid(region->limit + 1)){
+		return INVALID_REGION_LIMIT;
+	}
 #endif
 	if(region->number >= memory_protection_getNumberOfMPURegions()){
 		return INVALID_REGION_NUMBER;
 	}
-	MPU->RBAR = region->address | (1 << MPU_RBAR_VALID_Pos) | region->number;
+#if SHEAPERD_ARMV7
+	registers->rbar = region->address | (1 << MPU_RBAR_VALID_Pos) | region->number;
 	uint8_t tex_scb = region->tex << 3 | region->shareable << 2 | region->cachable << 1 | region->bufferable;
-	MPU->RASR = (region->ap << MPU_RASR_AP_Pos) | (region->xn << MPU_RASR_XN_Pos) | (tex_scb << MPU_RASR_TEX_SCB_Pos)
+	registers->rasr = (region->ap << MPU_RASR_AP_Pos) | (region->xn << MPU_RASR_XN_Pos) | (tex_scb << MPU_RASR_TEX_SCB_Pos)
 			| region->srd << MPU_RASR_SRD_Pos | (region->size << MPU_RASR_SIZE_Pos) | region->enabled;
+#elif SHEAPERD_ARMV8
+	bool xn = region->xn;
+	uint32_t ap = getAccessPermission(region->ap, &xn);
+	uint32_t sh = region->shareable ? MPU_RBAR_SH_OUTER_SHAREABLE : 0;
+	registers->number = region->number;
+	registers->rbar = region->address | (sh << MPU_RBAR_SH_Pos) | (ap << MPU_RBAR_AP_Pos) | (xn << MPU_RBAR_XN_Pos);
+	registers->rlar = (region->limit & MPU_RLAR_LIMIT_Msk) | ((region->attributeIndex & 0x7) << MPU_RLAR_ATTRINDX_Pos) | region->enabled;
+#endif
+	return NO_ERROR;
+}
+
+void memory_protection_writeRegion(const mpu_regionRegisters_t* registers){
+#if SHEAPERD_ARMV7
+	// the valid bit of the RBAR value selects the region, RNR is not written
+	MPU->RBAR = registers->rbar;
+	MPU->RASR = registers->rasr;
+#elif SHEAPERD_ARMV8
+	MPU->RNR = registers->number;
+	MPU->RBAR = registers->rbar;
+	MPU->RLAR = registers->rlar;
+#endif
+}
+
+void memory_protection_disableRegion(uint8_t number){
+	MPU->RNR = number;
+#if SHEAPERD_ARMV6 || SHEAPERD_ARMV7
+	MPU->RASR = 0;
+#elif SHEAPERD_ARMV8
+	MPU->RLAR = 0;
+#endif
+}
+
+mpu_error_t memory_protection_configureRegions(const mpu_region_t regions[], uint32_t n, bool activateMPU){
+	ASSERT_RETURN_ERROR_ON_FAILURE(memory_protection_getNumberOfMPURegions() == 0, NO_MPU_AVAILABLE);
+	ASSERT_RETURN_ERROR_ON_FAILURE(n > MPU_MAX_NUMBER_OF_REGIONS, INVALID_REGION_NUMBER);
+	// all regions are encoded before the MPU is disabled
+	mpu_regionRegisters_t registers[MPU_MAX_NUMBER_OF_REGIONS];
+	for(uint32_t i = 0; i < n; i++){
+		mpu_error_t error = memory_protection_encodeRegion(&regions[i], &registers[i]);
+		if(error != NO_ERROR){
+			return error;
+		}
+	}
+	memory_protection_disableMPU();
+	memory_protection_writeRegions(registers, n);
 	if(activateMPU) {
-        memory_protection_enableMPU();
+		memory_protection_enableMPU();
 	}
 	return NO_ERROR;
 }
 
+#if SHEAPERD_ARMV7
+void memory_protection_writeRegions(const mpu_regionRegisters_t registers[], uint32_t n){
+	uint32_t i = 0;
+	for(; i + MPU_ALIAS_REGION_COUNT <= n; i += MPU_ALIAS_REGION_COUNT){
+		writeRegionBurst((const uint32_t*)&registers[i]);
+	}
+	for(; i < n; i++){
+		memory_protection_writeRegion(&registers[i]);
+	}
+}
+#elif SHEAPERD_ARMV8
+void memory_protection_writeRegions(const mpu_regionRegisters_t registers[], uint32_t n){
+	uint32_t i = 0;
+	while(i < n){
+#if SHEAPERD_MPU_M33_M35P
+		// the aliases write the regions RNR[7:2]:1 .. RNR[7:2]:3
+		uint32_t number = registers[i].number;
+		if(i + MPU_ALIAS_REGION_COUNT <= n && (number & MPU_RNR_ALIAS_Msk) == 0 && registers[i + 1].number == number + 1
+				&& registers[i + 2].number == number + 2 && registers[i + 3].number == number + 3){
+			uint32_t words[2 * MPU_ALIAS_REGION_COUNT];
+			for(uint32_t j = 0; j < MPU_ALIAS_REGION_COUNT; j++){
+				words[2 * j] = registers[i + j].rbar;
+				words[2 * j + 1] = registers[i + j].rlar;
+			}
+			MPU->RNR = number;
+			writeRegionBurst(words);
+			i += MPU_ALIAS_REGION_COUNT;
+			continue;
+		}
+#endif
+		memory_protection_writeRegion(&registers[i]);
+		i++;
+	}
+}
+
+void memory_protection_setMemoryAttributes(uint8_t index, uint8_t attributes){
+	uint32_t shift = (index & 0x3) * 8;
+	uint32_t mair = MPU->MAIR[(index >> 2) & 0x1];
+	MPU->MAIR[(index >> 2) & 0x1] = (mair & ~(0xFFul << shift)) | ((uint32_t)attributes << shift);
+}
+#endif
+
 uint8_t memory_protection_getNumberOfMPURegions(){
 	return (uint8_t)(MPU->TYPE >> MPU_TYPE_DREGION_Pos);
 }
@@ -153,14 +280,50 @@ mpu_error_t memory_protection_disableMPU(){
 	return NO_ERROR;
 }
 
+#if SHEAPERD_ARMV7 || SHEAPERD_MPU_M33_M35P
+static void writeRegionBurst(const uint32_t words[2 * MPU_ALIAS_REGION_COUNT]){
+	// RBAR, RASR and the aliases RBAR_A1 .. RASR_A3 are consecutive (ARMv7-M: each RBAR value selects its region with the valid bit,
+	// ARMv8-M: RBAR, RLAR and the aliases, the regions are selected by RNR). Two 4 word STMs write four regions
+	const uint32_t* source = words;
+	volatile uint32_t* destination = &MPU->RBAR;
+	__asm volatile(
+		"\tldmia %0!, {r2-r5}\n"
+		"\tstmia %1!, {r2-r5}\n"
+		"\tldmia %0!, {r2-r5}\n"
+		"\tstmia %1!, {r2-r5}\n"
+		: "+r" (source), "+r" (destination) : : "r2", "r3", "r4", "r5", "memory");
+}
+#endif
+
 static bool isAddressValid(uint32_t address){
 	return (address & MPU_REGION_ADDRESS_32BIT_ALIGNMENT_MASK) == 0;
 }
 
-static bool isAlignmentValid(mpu_region_t* region){
+#if SHEAPERD_ARMV7
+static bool isAlignmentValid(const mpu_region_t* region){
 	uint32_t mask = gAlignmentTable[region->size - MEMORY_PROTECTION_ALIGNMENT_TABLE_OFFSET];
 	uint32_t result = (region->address & mask);
 	return result == 0;
 }
+#elif SHEAPERD_ARMV8
+static uint32_t getAccessPermission(mpu_access_permission_t ap, bool* xn){
+	// RBAR.AP: 0 privileged rw, 1 rw, 2 privileged ro, 3 ro
+	switch(ap){
+		case MPU_REGION_ALL_ACCESS_DENIED:
+			*xn = true;
+			return 2;
+		case MPU_REGION_PRIVELEGED_RW:
+		case MPU_REGION_PRIVELEGED_RW_UNPRIVILEGED_RO:
+			return 0;
+		case MPU_REGION_ALL_ACCESS_ALLOWED:
+			return 1;
+		case MPU_REGION_PRIVELEGED_RO:
+			return 2;
+		case MPU_REGION_PRIVELEGED_RO_UNPRIVILEGED_RO:
+		default:
+			return 3;
+	}
+}
+#endif
 
 #endif
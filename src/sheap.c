@@ -15,6 +15,8 @@
  *	the lowest bit can be used as a flag to mark if a block currently is allocated or not.
  *	The CRC is calculated over the size/alloc-flag and the alignment offset. It is intended to detect bound overflow or altered blocks in general.
  *	The boundary (end tag) with size, alignment and CRC information is used for coalescing of blocks and can also be checked to recognize if a block was altered
+ *	The check word algorithm is selected with SHEAPERD_SHEAP_INTEGRITY_LEVEL (none, 16 bit xor canary, CRC16, CRC32). With CRC32 the alignment offset
+ *	and the CRC fields are 4 bytes each. A stronger check word detects more alterations, but costs more time per allocation and free.
  *
  *	Why is the aligned and the alignment offset stored?
  *	This library should help to detect as many memory related errors as possible. If only the aligned size is stored a user would allocate 5 bytes and a aligned size of 8 bytes is reserved and a block is created accordingly.
@@ -36,23 +38,134 @@
  *	can prove useful during debugging. This feature increases the memory overhead from 16 byte to 24 byte.
  *	The pc is inserted after the aligned size/alloc flag and before the alignment offset and it is part of the CRC calculation.
  *
+ *	Allocation strategies (SHEAPERD_SHEAP_MEMORY_ALLOCATION_STRATEGY):
+ *		+ SHEAPERD_SHEAP_MEMORY_ALLOCATION_FIRST_FIT: walks all blocks from the start of the heap and takes the first free block which is big enough.
+ *		  The search time grows with the number of blocks in the heap.
+ *		+ SHEAPERD_SHEAP_MEMORY_ALLOCATION_NEXT_FIT: like first fit, but the search continues at the block where the last search stopped (roving
+ *		  pointer) and wraps around at the end of the heap. Small fragments are not piled up at the start of the heap. The roving pointer always
+ *		  points to a valid block header, when coalesce merges the block it points to, it is moved to the merged block.
+ *		+ SHEAPERD_SHEAP_MEMORY_ALLOCATION_BEST_FIT: walks all blocks and takes the smallest free block which is big enough (stops early on an exact fit).
+ *		  Visits every block, but keeps large free blocks intact as long as a tighter fit exists.
+ *		+ SHEAPERD_SHEAP_MEMORY_ALLOCATION_TLSF: two level segregated fit. Free blocks are kept in size class bins which are indexed by two bitmaps
+ *		  (first level: power of two, second level: linear subdivision of each power of two). The bin links are stored as heap offsets in the first
+ *		  8 bytes of the (otherwise unused) free payload:
+ *
+ *		  +------------------------+------------+------------+------------+------------+---------------------------+------------------------+
+ *		  |      header (free)     |    next    |    prev    |     ...    |  boundary (free)                                   |
+ *		  +------------------------+------------+------------+------------+----------------------------------------------------+
+ *		                           ^-- 4 bytes  ^-- 4 bytes
+ *
+ *		  Allocation and free are done in constant time: a bitmap lookup finds a bin whose blocks are all big enough, coalescing only unlinks the
+ *		  direct neighbours (found via the boundary tags) from their bins. The links are not part of the CRC, they are range checked when used and
+ *		  overwritten with SHEAPERD_SHEAP_OVERWRITE_VALUE as soon as a block leaves its bin. As a free block must be able to hold the links,
+ *		  the minimum payload size is 8 bytes with this strategy.
+ *
+ *	Next fit has the shortest linear search, but spreads the allocations over the whole heap and leaves the free memory in many small pieces.
+ *	Best fit has the longest search. TLSF has a constant search length and the fragmentation stays in the range of first/best fit
+ *	(measurements in bench/README.md).
+ *
+ *	Incremental integrity check: 'sheap_scrub_step' checks a bounded number of blocks per call and continues at the saved cursor with the next call.
+ *	The cursor always points to a valid block header, when coalesce merges the block it points to, it is moved to the merged block. Thus allocations
+ *	and frees between two steps do not restart the pass.
+ *	With SHEAPERD_SHEAP_DEFER_OVERWRITE_ON_FREE the payload of a freed block is not overwritten by the free call. The alignment offset of a free block
+ *	(unused otherwise) marks it as not yet overwritten and the scrub step overwrites it. Allocations only overwrite the unused bytes after the
+ *	requested size (needed for the out of bound write check).
+ *	A large free block is overwritten in chunks (SHEAPERD_SHEAP_SCRUB_OVERWRITE_CHUNK) from its end, the cursor stays at the block until it is
+ *	overwritten completely. Allocations split a free block at its start, so the overwritten end stays with the remaining free block. With
+ *	SHEAPERD_SHEAP_LAZY_INIT the initial free block is marked as not overwritten as well and sheap_init only writes its header and boundary.
+ *
+ *	Heap walk: 'sheap_walk_next' reads a bounded number of block records per call and saves the next block in a cursor owned by the caller.
+ *	Each unlock of an allocating or freeing call increments the generation of the heap. A walk which finds a different generation than the one
+ *	saved with the cursor restarts at the first block (the saved block may have been merged). 'sheap_snapshot_step' writes the records of a walk
+ *	as words to a sink (format in tools/README.md), a restart of the walk writes a new begin record.
+ *
+ *	Instances: the state of a heap (blocks, free lists, statistics, caller id log, lock) is kept in a 'sheap_t'. The sheap_* functions use a
+ *	default instance, 'sheap_init_instance' places an additional instance at the start of the provided memory. The instances are locked
+ *	independently, only the irq lock (SHEAPERD_SHEAP_DISABLE_IRQS) is global.
+ *
+ *	Optional: per task allocation caches (SHEAPERD_SHEAP_TASK_CACHE). Each task (identified by its thread id) owns a small magazine of blocks per
+ *	size class. Allocations which fit into a size class and frees of blocks of a class size are served from the magazine of the calling task without
+ *	acquiring the mutex or disabling irqs. Only an empty magazine is refilled (SHEAPERD_SHEAP_TASK_CACHE_BATCH blocks) and a full magazine is drained
+ *	under the sheap lock. Calls from interrupt handlers always use the sheap directly.
+ *	The blocks in a magazine stay allocated sheap blocks (also in the heap statistics). Their header is only written with the lock (by the refill or
+ *	the regular allocation of a block of a class size), the lock free calls only write the payload. A cached allocation is therefore accounted
+ *	with the class size and the id of the refill, and a block with unused bytes after the requested size is freed regularly. The header and
+ *	boundary are still checked on each free, the first payload word holds a tag to detect a double free of a cached block. Cached allocations
+ *	are not recorded in the caller id log. A refill or drain which finds the sheap locked is reported like an overlapping regular call.
+ *	A task has to call 'sheap_cache_flush' before it is deleted to return its blocks to the sheap.
+ *
+ *	Optional: MPU guarded allocations (SHEAPERD_SHEAP_GUARDED_ALLOCATIONS). A guarded allocation is a regular block with a 32 byte aligned payload:
+ *	the requested size rounded up to 32 bytes and a 32 byte no access MPU region (guard). The returned pointer is placed so that the requested size
+ *	ends at the guard, the bytes between (below the minimum malloc size) are filled and checked by the free. The header and the boundary tag stay
+ *	accessible, so neighbouring blocks are coalesced as usual. A slot table maps the returned pointers to the blocks and the MPU regions, sheap_free
+ *	and sheap_realloc look up the table before the pointer is handled as block payload.
+ *
+ *	Optional: compact block layout (SHEAPERD_SHEAP_COMPACT_HEADER). Only free blocks carry a boundary tag, it is stored in the last bytes of the
+ *	free payload. Coalescing only needs the tag of a free previous block, which is marked by a previous block free bit in the header of each block.
+ *	The bit is taken from the size and is covered by the CRC (the header CRC of the next block is updated when the bit changes), the tag it points
+ *	to is only used if it is valid and the previous block starts within the heap. Without the tag of an allocated block, a bound overflow is detected by the header CRC of the next block and the unused bytes
+ *	after the requested size. Saves one header size per allocated block, the minimum payload size grows to hold the tag once the block is freed.
+ *
  *  @author JK
  *  @bug No known bugs.
  */
 
 #include "internal/opt.h"
 #include "sheap.h"
+#if SHEAPERD_SHEAP_GUARDED_ALLOCATIONS == 1
+#include "memory_protection.h"
+#endif
 
 // don't build sheap if not enabled via options
 #if SHEAPERD_SHEAP
 
+#if SHEAPERD_SHEAP_COMPACT_HEADER == 1
+	// header only, the boundary tag of a free block is part of its payload
+	#define BLOCK_META_SIZE						sizeof(memory_blockInfo_t)
+	#define GET_BOUNDARY_TAG(block)				(memory_blockInfo_t*)(((uint8_t*)block) + block->size)
+#else
+	#define BLOCK_META_SIZE						(2 * sizeof(memory_blockInfo_t))
+	#define GET_BOUNDARY_TAG(block)				(memory_blockInfo_t*)(((uint8_t*)block) + sizeof(memory_blockInfo_t) + block->size)
+#endif
 #define PAYLOAD_BLOCK_TO_MEMORY_BLOCK(payload) 	((memory_blockInfo_t*)payload) - 1
-#define GET_NEXT_MEMORY_BLOCK(block) 			(memory_blockInfo_t*)(((uint8_t*)block) + 2 * sizeof(memory_blockInfo_t) + block->size)
-#define GET_PREV_MEMORY_BLOCK(block)			(memory_blockInfo_t*)(((uint8_t*)block) - 2 * sizeof(memory_blockInfo_t) - GET_SIZE_OF_PREV_BLOCK(block))
-#define GET_BOUNDARY_TAG(block)					(memory_blockInfo_t*)(((uint8_t*)block) + sizeof(memory_blockInfo_t) + block->size)
-#define GET_BLOCK_OVERHEAD_SIZE(size)			(size_t) (size +  (2 * sizeof(memory_blockInfo_t)))
+#define GET_NEXT_MEMORY_BLOCK(block) 			(memory_blockInfo_t*)(((uint8_t*)block) + BLOCK_META_SIZE + block->size)
+#define GET_PREV_MEMORY_BLOCK(block)			(memory_blockInfo_t*)(((uint8_t*)block) - BLOCK_META_SIZE - GET_SIZE_OF_PREV_BLOCK(block))
+#define GET_BLOCK_OVERHEAD_SIZE(size)			(size_t) (size + BLOCK_META_SIZE)
 #define GET_SIZE_OF_PREV_BLOCK(block)			(block - 1)->size
 
+#if SHEAPERD_SHEAP_MEMORY_ALLOCATION_STRATEGY == SHEAPERD_SHEAP_MEMORY_ALLOCATION_TLSF
+	#define TLSF_ALIGN_SIZE_LOG2				2
+	#define TLSF_SL_INDEX_COUNT					(1 << SHEAPERD_SHEAP_TLSF_SL_INDEX_COUNT_LOG2)
+	#define TLSF_FL_INDEX_SHIFT					(SHEAPERD_SHEAP_TLSF_SL_INDEX_COUNT_LOG2 + TLSF_ALIGN_SIZE_LOG2)
+	#define TLSF_FL_INDEX_COUNT					(SHEAPERD_SHEAP_TLSF_FL_INDEX_MAX - TLSF_FL_INDEX_SHIFT + 1)
+	#define TLSF_SMALL_BLOCK_SIZE				(1 << TLSF_FL_INDEX_SHIFT)
+	#define TLSF_MAX_BLOCK_SIZE					((1ul << SHEAPERD_SHEAP_TLSF_FL_INDEX_MAX) - 1)
+	#define FREE_LIST_NULL						0xFFFFFFFF
+	#define GET_FREE_LINK(block)				((memory_freeLink_t*)((block) + 1))
+	#if SHEAPERD_SHEAP_COMPACT_HEADER == 1
+		// the links and the boundary tag of a free block must not overlap
+		#define MINIMUM_BLOCK_PAYLOAD_SIZE		ALIGN_TO_MINIMUM_MALLOC_SIZE(8 + sizeof(memory_blockInfo_t))
+	#elif SHEAPERD_SHEAP_MINIMUM_MALLOC_SIZE < 8
+		#define MINIMUM_BLOCK_PAYLOAD_SIZE		8
+	#else
+		#define MINIMUM_BLOCK_PAYLOAD_SIZE		SHEAPERD_SHEAP_MINIMUM_MALLOC_SIZE
+	#endif
+	#if TLSF_FL_INDEX_COUNT <= 0
+		#error "SHEAPERD_SHEAP_TLSF_FL_INDEX_MAX is too small for the configured second level index count"
+	#endif
+#elif SHEAPERD_SHEAP_COMPACT_HEADER == 1
+	// every block must be able to hold a boundary tag once it is freed
+	#define MINIMUM_BLOCK_PAYLOAD_SIZE			ALIGN_TO_MINIMUM_MALLOC_SIZE(sizeof(memory_blockInfo_t))
+#else
+	#define MINIMUM_BLOCK_PAYLOAD_SIZE			SHEAPERD_SHEAP_MINIMUM_MALLOC_SIZE
+#endif
+#define ALIGN_TO_MINIMUM_MALLOC_SIZE(n)			(((n) + SHEAPERD_SHEAP_MINIMUM_MALLOC_SIZE - 1) & ~(SHEAPERD_SHEAP_MINIMUM_MALLOC_SIZE - 1))
+
+#if SHEAPERD_SHEAP_DEFER_OVERWRITE_ON_FREE == 1
+	#define FREE_BLOCK_NOT_OVERWRITTEN			1
+	#define IS_FREE_BLOCK_OVERWRITTEN(block)	((block)->alignmentOffset != FREE_BLOCK_NOT_OVERWRITTEN)
+#endif
+
 #define REPORT_ERROR_AND_RETURN(assertMsg, assertionType)  	\
 do{                                                        	\
 	SHEAPERD_ASSERT(assertMsg, false, assertionType);	    \
@@ -63,61 +176,79 @@ do{                                                             	\
 	SHEAPERD_ASSERT(assertMsg, false, assertionType);	       		\
 	return NULL;                                            		\
 }while(0)
-#define REPORT_ERROR_AND_RELEASE_MUTEX(assertMsg, assertionType)  	\
-do{                                                             	\
-	SHEAPERD_ASSERT(assertMsg, false, assertionType);	       		\
-	sheap_releaseMutex();                                           \
-}while(0)
-#define REPORT_ERROR_RELEASE_MUTEX_CLEAR_FREE_FLAG_ENABLE_IRQS_AND_RETURN(assertMsg, assertionType)	\
-do{                                                               						            \
-	REPORT_ERROR_AND_RELEASE_MUTEX(assertMsg, assertionType);     	         			            \
-	freeBusy = false;																	            \
-	enableIRQs();                                                                                 	\
-	return;                                                        						            \
-}while(0)
-#define REPORT_ERROR_RELEASE_MUTEX_AND_RETURN_NULL(assertMsg, assertionType)    	\
-do{                                                                         		\
-	REPORT_ERROR_AND_RELEASE_MUTEX(assertMsg, assertionType);						\
-	return NULL;                                                          			\
-}while(0)
 
-#define CLEAR_MALLOC_FLAG_AND_RETURN_NULL()	\
-do{											\
-	allocBusy = false;						\
-	return NULL;							\
-}while(0)
+#if SHEAPERD_SHEAP_TASK_CACHE == 1
+	#define CACHE_CLASS_SIZE(sizeClass)		((size_t)SHEAPERD_SHEAP_TASK_CACHE_MIN_CLASS_SIZE << (sizeClass))
+	#define CACHED_BLOCK_TAG(block)			(0xCAC4EDB1ul ^ (uint32_t)(uintptr_t)(block))
+	#if SHEAPERD_NO_OS == 1
+		#define GET_THREAD_ID()				((memory_threadId_t)1)
+	#elif SHEAPERD_USE_LOCK_PORT == 1
+		#define GET_THREAD_ID()				sheaperd_port_threadId()
+	#else
+		#define GET_THREAD_ID()				osThreadGetId()
+	#endif
+#endif
 
-#define CLEAR_MALLOC_FLAG_ENABLE_IRQS_AND_RETURN_NULL() \
-do{                                                     \
-    allocBusy = false;                                  \
-    enableIRQs();                                     	\
-    return NULL;                                        \
-}while(0)
+// ALLOC and FREE identify the kind of the overlapping call for the diagnostics
+#define MEMORY_BUSY_ALLOC		0x1u
+#define MEMORY_BUSY_FREE		0x2u
+// the call does not change the block layout, the generation is not incremented on unlock
+#define MEMORY_BUSY_READ_ONLY	0x4u
+// claimed by every sheap_lock, the heap (blocks, free lists, statistic) is used by one call at a time even without mutex
+// (interrupt handlers in the ISR safe mode)
+#define MEMORY_BUSY_HEAP		0x8u
 
-#define CLEAR_FREE_FLAG_ENABLE_IRQS_AND_RETURN()    \
-do{                                                 \
-    freeBusy = false;                               \
-    enableIRQs();                                 	\
-    return;                                         \
-}while(0)
+// block records of a snapshot step read with one lock
+#define SNAPSHOT_STEP_BLOCKS	8
+#define SNAPSHOT_MAGIC			0x504D4853u	// "SHMP"
+#define SNAPSHOT_VERSION		1u
+#define SNAPSHOT_INVALID_FLAG	0x40000000u
+#define SNAPSHOT_ALLOCATED_FLAG	0x80000000u
+
+#if SHEAPERD_SHEAP_ISR_SAFE == 1
+	// an interrupt handler finding the heap busy is expected in the ISR safe mode
+	#define IS_OVERLAP_EXPECTED()	SHEAPERD_IS_ISR_CONTEXT()
+#else
+	#define IS_OVERLAP_EXPECTED()	false
+#endif
+
+#if SHEAPERD_SHEAP_INTEGRITY_LEVEL == SHEAPERD_SHEAP_INTEGRITY_CRC32
+	// the alignment offset is widened with the check word to keep the header size a multiple of 4
+	typedef uint32_t memory_offset_t;
+	typedef uint32_t memory_checkWord_t;
+#else
+	typedef uint16_t memory_offset_t;
+	typedef uint16_t memory_checkWord_t;
+#endif
 
 #if SHEAPERD_SHEAP_USE_EXTENDED_HEADER == 1
 	#pragma pack(1)
 	typedef struct memory_blockInfo_t{
 		uint32_t 			isAllocated : 1;
+#if SHEAPERD_SHEAP_COMPACT_HEADER == 1
+		// the previous block is free, its boundary tag directly precedes this header
+		uint32_t			isPrevFree	: 1;
+		uint32_t 			size 		: 30;
+#else
 		uint32_t 			size 		: 31;
+#endif
 		uint32_t			id;
-		uint16_t			alignmentOffset;
-		uint16_t			crc;
+		memory_offset_t		alignmentOffset;
+		memory_checkWord_t	crc;
 	} memory_blockInfo_t;
 	#pragma pack()
 #elif SHEAPERD_SHEAP_USE_EXTENDED_HEADER == 0
 #pragma pack(1)
 	typedef struct memory_blockInfo_t{
 		uint32_t 			isAllocated : 1;
+#if SHEAPERD_SHEAP_COMPACT_HEADER == 1
+		uint32_t			isPrevFree	: 1;
+		uint32_t 			size 		: 30;
+#else
 		uint32_t 			size 		: 31;
-		uint16_t			alignmentOffset;
-		uint16_t			crc;
+#endif
+		memory_offset_t		alignmentOffset;
+		memory_checkWord_t	crc;
 	} memory_blockInfo_t;
 	#pragma pack()
 #endif
@@ -127,8 +258,32 @@ typedef enum{
 	MEMORY_OP_FREE
 } memory_operation_t;
 
-#if SHEAPERD_CMSIS_2 == 1
-static osMutexId_t gMemMutex_id;
+#if SHEAPERD_SHEAP_MEMORY_ALLOCATION_STRATEGY == SHEAPERD_SHEAP_MEMORY_ALLOCATION_TLSF
+typedef struct memory_freeLink_t{
+	uint32_t			next;
+	uint32_t			prev;
+} memory_freeLink_t;
+#endif
+
+#if SHEAPERD_SHEAP_TASK_CACHE == 1
+#if SHEAPERD_NO_OS == 1
+typedef uint32_t memory_threadId_t;
+#elif SHEAPERD_USE_LOCK_PORT == 1
+typedef void* memory_threadId_t;
+#elif SHEAPERD_CMSIS_1 == 1
+typedef osThreadId memory_threadId_t;
+#elif SHEAPERD_CMSIS_2 == 1
+typedef osThreadId_t memory_threadId_t;
+#endif
+
+typedef struct memory_taskCache_t{
+	volatile memory_threadId_t	owner;
+	uint8_t						count[SHEAPERD_SHEAP_TASK_CACHE_CLASSES];
+	memory_blockInfo_t*			blocks[SHEAPERD_SHEAP_TASK_CACHE_CLASSES][SHEAPERD_SHEAP_TASK_CACHE_DEPTH];
+} memory_taskCache_t;
+#endif
+
+#if SHEAPERD_USE_LOCK_PORT == 0 && SHEAPERD_CMSIS_2 == 1
 static const osMutexAttr_t memMutex_attr = {
 	  "sheap_mutex",
 	  osMutexRecursive,
@@ -137,123 +292,422 @@ static const osMutexAttr_t memMutex_attr = {
 };
 #endif
 
-#if SHEAPERD_CMSIS_1 == 1
-osMutexDef(sheap_mutex);
-osMutexId gMemMutex_id;
+#if SHEAPERD_SHEAP_LATENCY_STATISTIC == 1
+typedef enum{
+	MEMORY_LATENCY_MALLOC,
+	MEMORY_LATENCY_CALLOC,
+	MEMORY_LATENCY_FREE,
+	MEMORY_LATENCY_COUNT
+} memory_latencyOp_t;
+
+typedef struct memory_latency_t{
+	sheap_latencyStat_t	stat;
+	// the means are calculated when the statistic is read
+	uint64_t			totalCycles;
+	uint64_t			totalBlocksVisited;
+} memory_latency_t;
+
+	#define COUNT_VISITED_BLOCK(sheap)		((sheap)->blocksVisited++)
+#else
+	#define COUNT_VISITED_BLOCK(sheap)		do {} while(0)
+#endif
+
+#if SHEAPERD_SHEAP_TRACE == 1
+typedef struct memory_trace_t{
+	sheap_traceEvent_t	events[SHEAPERD_SHEAP_TRACE_EVENTS];
+	// head is only written while the heap is locked, tail only by the drain
+	volatile uint32_t	head;
+	volatile uint32_t	tail;
+	uint32_t			dropped;
+	uint16_t			sequence;
+} memory_trace_t;
+
+	#define TRACE_EVENT(sheap, op, id, size, address)		traceEvent(sheap, op, id, size, address)
+#else
+	#define TRACE_EVENT(sheap, op, id, size, address)		do {} while(0)
+#endif
+
+typedef enum {
+	MEMORY_LOCK_ACQUIRED,
+	MEMORY_LOCK_BUSY,
+	MEMORY_LOCK_FAILED
+} memory_lock_t;
+
+struct sheap_t {
+	memory_blockInfo_t*		startBlock;
+	sheap_heapStat_t		heap;
+	uint32_t				headerIds[SHEAP_HEADER_ID_LOG_SIZE];
+	int16_t					currentIDIndex;
+#if SHEAPERD_SHEAP_MEMORY_ALLOCATION_STRATEGY == SHEAPERD_SHEAP_MEMORY_ALLOCATION_TLSF
+	uint32_t				flBitmap;
+	uint32_t				slBitmap[TLSF_FL_INDEX_COUNT];
+	uint32_t				freeBins[TLSF_FL_INDEX_COUNT][TLSF_SL_INDEX_COUNT];
+#elif SHEAPERD_SHEAP_MEMORY_ALLOCATION_STRATEGY == SHEAPERD_SHEAP_MEMORY_ALLOCATION_NEXT_FIT
+	memory_blockInfo_t*		roverBlock;
+#endif
+#if SHEAPERD_SHEAP_TASK_CACHE == 1
+	memory_taskCache_t		taskCaches[SHEAPERD_SHEAP_TASK_CACHE_TASKS];
+#endif
+#if SHEAPERD_SHEAP_MEMORY_ALLOCATION_STRATEGY != SHEAPERD_SHEAP_MEMORY_ALLOCATION_TLSF
+	// heap.largestFreeBlock is kept exact with the number of free blocks of that size and an upper bound of all other free
+	// blocks, it has to be searched again only if the last block of that size was removed and no larger block was inserted since
+	bool					largestFreeBlockStale;
+	uint32_t				largestFreeBlockCount;
+	uint32_t				otherFreeBlocksBound;
+#endif
+	memory_blockInfo_t*		scrubCursor;
+	uint32_t				scrubPasses;
+#if SHEAPERD_SHEAP_DEFER_OVERWRITE_ON_FREE == 1 && SHEAPERD_SHEAP_SCRUB_OVERWRITE_CHUNK > 0
+	// the bytes from overwriteFrom up to overwriteBlockEnd (boundary of a not yet overwritten free block) are overwritten
+	uint8_t*				overwriteBlockEnd;
+	uint8_t*				overwriteFrom;
 #endif
+	// incremented by each unlock of an allocating or freeing call, a walk restarts if it changed
+	uint32_t				generation;
+#if SHEAPERD_SHEAP_LATENCY_STATISTIC == 1
+	memory_latency_t		latency[MEMORY_LATENCY_COUNT];
+	uint32_t				blocksVisited;
+#endif
+#if SHEAPERD_SHEAP_TRACE == 1
+	memory_trace_t			trace;
+#endif
+#if SHEAPERD_USE_LOCK_PORT == 1
+	sheaperd_portLock_t		lock;
+#elif SHEAPERD_CMSIS_1 == 1
+	osMutexId				mutexId;
+	util_mutexDef_t			mutexDef;
+#elif SHEAPERD_CMSIS_2 == 1
+	osMutexId_t				mutexId;
+#endif
+	volatile uint32_t		busy;
+};
+
+// instance of the sheap_* functions without instance parameter
+static sheap_t gDefaultSheap;
+
+#if SHEAPERD_SHEAP_GUARDED_ALLOCATIONS == 1
+// size and alignment of a guard region (minimum region size of ARMv7-M, granularity of ARMv8-M)
+#define GUARD_SIZE							32u
 
-static memory_blockInfo_t* gStartBlock;
-static sheap_heapStat_t gHeap;
-static uint32_t gHeaderIds[SHEAP_HEADER_ID_LOG_SIZE];
-static int16_t gCurrentIDIndex;
+typedef struct memory_guardSlot_t{
+	// payload of the block holding the allocation and the guard, NULL if the slot is unused
+	uint8_t*		block;
+	// returned pointer, its requested size ends at the guard
+	uint8_t*		payload;
+	size_t			size;
+	uint32_t		id;
+} memory_guardSlot_t;
 
-static void sheap_logAccess();
-static memory_blockInfo_t* getNextFreeBlockOfSize(size_t size);
+// guarded allocations of the default instance, only modified while the default instance is locked
+static memory_guardSlot_t gGuardSlots[SHEAPERD_SHEAP_GUARD_SLOTS];
+static volatile uint32_t gGuardedCount = 0;
+static volatile uint32_t gGuardSuspectId = 0;
+#if SHEAPERD_SHEAP_GUARD_SAMPLE_INTERVAL > 0
+static uint32_t gGuardSampleCount = 0;
+#endif
+#endif
+#if SHEAPERD_SHEAP_TRACE == 1
+static sheap_traceSink_cb gTraceSink = NULL;
+#endif
+
+static void sheap_logAccess(sheap_t* sheap, uint32_t id);
+static memory_blockInfo_t* getNextFreeBlockOfSize(sheap_t* sheap, size_t size, bool reportOutOfMemory);
 static bool isBlockValid(memory_blockInfo_t* block);
 static bool isBlockCRCValid(memory_blockInfo_t* block);
 static void clearMemory(uint8_t* ptr, size_t size);
 static void updateBlockBoundary(memory_blockInfo_t* block);
+#if SHEAPERD_SHEAP_COMPACT_HEADER == 1
+static void updatePrevFreeOfNextBlock(sheap_t* sheap, memory_blockInfo_t* block);
+#endif
 #if SHEAPERD_SHEAP_USE_EXTENDED_HEADER == 1
 	static void updateBlockHeader(memory_blockInfo_t* block, size_t sizeAligned, size_t sizeRequested, bool isAllocated, uint32_t id);
 #elif SHEAPERD_SHEAP_USE_EXTENDED_HEADER == 0
 	static void updateBlockHeader(memory_blockInfo_t* block, size_t sizeAligned, size_t sizeRequested, bool isAllocated);
 #endif
+static memory_checkWord_t calculateCRC(const memory_blockInfo_t* block);
 static void updateCRC(memory_blockInfo_t* block);
-static bool isPreviousBlockFree(memory_blockInfo_t* block);
-static bool isNextBlockFree(memory_blockInfo_t* block);
-static memory_blockInfo_t* coalesce(memory_blockInfo_t** block);
+static bool isPreviousBlockFree(sheap_t* sheap, memory_blockInfo_t* block);
+static memory_blockInfo_t* getPreviousFreeBlock(sheap_t* sheap, memory_blockInfo_t* block);
+static bool isNextBlockFree(sheap_t* sheap, memory_blockInfo_t* block);
+static memory_blockInfo_t* coalesce(sheap_t* sheap, memory_blockInfo_t** block);
 static void clearBlockMeta(memory_blockInfo_t* block);
 static void clearBlockHeader(memory_blockInfo_t* block);
 static void clearBlockBoundary(memory_blockInfo_t* block);
 static bool isBlockHeaderCRCValid(memory_blockInfo_t* block);
 static bool isBlockBoundaryCRCValid(memory_blockInfo_t* block);
 static bool	checkForIllegalWrite(memory_blockInfo_t* block);
-static void updateHeapStatistics(memory_operation_t op, uint32_t allocations, uint32_t sizeAligned, uint32_t size, uint32_t blockSize);
-static uint8_t* allocateBlock(size_t size, uint32_t id, bool initializePayload);
-static void* sheap_alloc_impl(size_t size, uint32_t id, bool initializeData);
+static void updateHeapStatistics(sheap_t* sheap, memory_operation_t op, uint32_t allocations, uint32_t sizeAligned, uint32_t size, uint32_t blockSize);
+static uint8_t* allocateBlock(sheap_t* sheap, size_t size, uint32_t id, bool initializePayload, bool reportOutOfMemory);
+static uint8_t* allocateAlignedBlock(sheap_t* sheap, size_t size, size_t alignment, uint32_t id, bool reportOutOfMemory);
+static uint8_t* allocateFreeBlock(sheap_t* sheap, memory_blockInfo_t* allocate, size_t size, size_t sizeAligned, uint32_t id, bool initializePayload);
+static void freeBlock(sheap_t* sheap, void* ptr, uint32_t id);
+static memory_blockInfo_t* getCheckedBlock(sheap_t* sheap, void* ptr);
+static void sortByAddress(void* ptrs[], size_t n);
+static void freeBlockRun(sheap_t* sheap, memory_blockInfo_t* first, memory_blockInfo_t* last, uint32_t id);
+static void* reallocateBlock(sheap_t* sheap, void* ptr, size_t size, uint32_t id);
+static uint32_t absorbNextFreeBlock(sheap_t* sheap, memory_blockInfo_t* block);
+static void releaseBlockTail(sheap_t* sheap, memory_blockInfo_t* block, size_t sizeAligned);
+static bool isBlockInHeapAndValid(sheap_t* sheap, memory_blockInfo_t* block);
+#if SHEAPERD_SHEAP_CHECK_ALL_BLOCKS_ON_MALLOC == 1 || SHEAPERD_SHEAP_CHECK_ALL_BLOCKS_ON_FREE == 1
+static bool checkAllBlocks(sheap_t* sheap);
+#endif
+#if SHEAPERD_SHEAP_DEFER_OVERWRITE_ON_FREE == 1
+// false if only a chunk of the block was overwritten (SHEAPERD_SHEAP_SCRUB_OVERWRITE_CHUNK)
+static bool overwriteFreeBlock(sheap_t* sheap, memory_blockInfo_t* block);
+static void resetOverwriteProgress(sheap_t* sheap, memory_blockInfo_t* block);
+#endif
+static void* sheap_alloc_impl(sheap_t* sheap, size_t size, size_t alignment, uint32_t id, bool initializeData);
+static void initFreeLists(sheap_t* sheap);
+static void insertFreeBlock(sheap_t* sheap, memory_blockInfo_t* block);
+static bool removeFreeBlock(sheap_t* sheap, memory_blockInfo_t* block);
+static uint32_t getLargestFreeBlock(sheap_t* sheap);
+#if SHEAPERD_SHEAP_MEMORY_ALLOCATION_STRATEGY == SHEAPERD_SHEAP_MEMORY_ALLOCATION_TLSF
+static void mappingInsert(size_t size, int32_t* fl, int32_t* sl);
+static void mappingSearch(size_t size, int32_t* fl, int32_t* sl);
+static memory_blockInfo_t* searchSuitableBlock(sheap_t* sheap, int32_t* fl, int32_t* sl);
+static bool isFreeLinkValid(sheap_t* sheap, uint32_t link);
+#endif
+#if SHEAPERD_SHEAP_TASK_CACHE == 1
+static int32_t getCacheClass(size_t sizeAligned);
+static memory_taskCache_t* findTaskCache(sheap_t* sheap, memory_threadId_t thread);
+static bool cacheAllocate(sheap_t* sheap, size_t size, uint32_t id, bool initializeData, void** allocated);
+static bool cacheFree(sheap_t* sheap, void* ptr, uint32_t id);
+static memory_lock_t refillTaskCache(sheap_t* sheap, memory_taskCache_t** cache, memory_threadId_t thread, int32_t sizeClass, uint32_t id);
+static memory_lock_t drainTaskCache(sheap_t* sheap, memory_taskCache_t* cache, int32_t sizeClass, uint32_t count, uint32_t id);
+#endif
 
-static void sheap_initMutex();
-static bool sheap_acquireMutex();
-static bool sheap_releaseMutex();
+static void sheap_initMutex(sheap_t* sheap);
+static bool sheap_acquireMutex(sheap_t* sheap);
+static bool sheap_releaseMutex(sheap_t* sheap);
+static memory_lock_t sheap_lock(sheap_t* sheap, uint32_t busyFlags);
+static void sheap_unlock(sheap_t* sheap, uint32_t busyFlags);
+static bool initInstance(sheap_t* sheap, uint32_t* heapStart, size_t size);
+#if SHEAPERD_SHEAP_LATENCY_STATISTIC == 1
+static void recordLatency(sheap_t* sheap, memory_latencyOp_t op, uint32_t cycles, size_t size, uint32_t id);
+static void getLatencyStat(memory_latency_t* latency, sheap_latencyStat_t* stat);
+static void resetLatencyStatistic(sheap_t* sheap);
+#endif
+#if SHEAPERD_SHEAP_TRACE == 1
+static void traceEvent(sheap_t* sheap, sheap_traceOp_t op, uint32_t id, size_t size, void* address);
+#endif
+#if SHEAPERD_SHEAP_GUARDED_ALLOCATIONS == 1
+static bool isGuardRequested(uint32_t id);
+static void* allocateGuarded(sheap_t* sheap, size_t size, uint32_t id, bool reportErrors);
+static bool freeGuarded(sheap_t* sheap, void* ptr, uint32_t id);
+static bool getGuardedSize(sheap_t* sheap, void* ptr, size_t* size);
+static int32_t findGuardSlot(const void* payload);
+static void writeGuardRegion(uint32_t slot, const uint8_t* guard, bool enabled);
+#endif
 
-static bool allocBusy;
-static bool freeBusy;
 
 void sheap_init(uint32_t* heapStart, size_t size){
+#if SHEAPERD_SHEAP_GUARDED_ALLOCATIONS == 1
+	for(uint32_t i = 0; i < SHEAPERD_SHEAP_GUARD_SLOTS; i++){
+		gGuardSlots[i].block = NULL;
+	}
+	gGuardedCount = 0;
+#if SHEAPERD_ARMV8 && SHEAPERD_STACK_GUARD != 1
+	memory_protection_setMemoryAttributes(SHEAPERD_SHEAP_GUARD_MPU_ATTRIBUTE_INDEX, MPU_MAIR_NORMAL_WRITE_BACK);
+#endif
+#endif
+	initInstance(&gDefaultSheap, heapStart, size);
+}
+
+sheap_t* sheap_init_instance(uint32_t* memoryStart, size_t size){
+	size_t instanceSize = sheap_align(sizeof(sheap_t));
+	if(memoryStart == NULL || size <= instanceSize + GET_BLOCK_OVERHEAD_SIZE(MINIMUM_BLOCK_PAYLOAD_SIZE)){
+		SHEAPERD_ASSERT("Sheap instance init failed due to invalid size.", false, SHEAP_INIT_INVALID_SIZE);
+		return NULL;
+	}
+	// the instance data is placed at the start of the provided memory, the heap follows
+	sheap_t* sheap = (sheap_t*)memoryStart;
+	uint8_t* instanceData = (uint8_t*)sheap;
+	for(size_t i = 0; i < sizeof(sheap_t); i++){
+		instanceData[i] = 0;
+	}
+	if(!initInstance(sheap, (uint32_t*)(instanceData + instanceSize), size - instanceSize)){
+		return NULL;
+	}
+	return sheap;
+}
+
+bool initInstance(sheap_t* sheap, uint32_t* heapStart, size_t size){
 	if(size == 0){
 		SHEAPERD_ASSERT("Sheap init failed due to invalid size.", size > 0, SHEAP_INIT_INVALID_SIZE);
-		return;
+		return false;
+	}
+#if SHEAPERD_SHEAP_MEMORY_ALLOCATION_STRATEGY == SHEAPERD_SHEAP_MEMORY_ALLOCATION_TLSF
+	if(size - BLOCK_META_SIZE > TLSF_MAX_BLOCK_SIZE){
+		SHEAPERD_ASSERT("Sheap init failed as the size exceeds 'SHEAPERD_SHEAP_TLSF_FL_INDEX_MAX'.", false, SHEAP_INIT_INVALID_SIZE);
+		return false;
 	}
+#endif
 	for(int i = 0; i < SHEAP_HEADER_ID_LOG_SIZE; i++){
-		gHeaderIds[i] = 0;
+		sheap->headerIds[i] = 0;
+	}
+#if SHEAPERD_SHEAP_TASK_CACHE == 1
+	for(int i = 0; i < SHEAPERD_SHEAP_TASK_CACHE_TASKS; i++){
+		sheap->taskCaches[i].owner = 0;
 	}
-	gCurrentIDIndex = -1;
+#endif
+	sheap->currentIDIndex = -1;
 
-	gHeap.heapMin = (uint8_t*) heapStart;
-	gHeap.size = size;
-	gHeap.heapMax = gHeap.heapMin + gHeap.size;
-	gHeap.userDataAllocatedAlligned = 0;
-	gHeap.userDataAllocated = 0;
-	gHeap.totalBytesAllocated = 0;
-	gHeap.currentAllocations = 0;
-	clearMemory(gHeap.heapMin, size);
+	sheap->heap.heapMin = (uint8_t*) heapStart;
+	sheap->heap.size = size;
+	sheap->heap.heapMax = sheap->heap.heapMin + sheap->heap.size;
+	sheap->heap.userDataAllocatedAlligned = 0;
+	sheap->heap.userDataAllocated = 0;
+	sheap->heap.totalBytesAllocated = 0;
+	sheap->heap.currentAllocations = 0;
+	sheap->heap.peakTotalBytesAllocated = 0;
+	sheap->heap.peakAllocations = 0;
+	sheap->heap.freeBlocks = 0;
+	sheap->heap.largestFreeBlock = 0;
+	for(int i = 0; i < SHEAPERD_SHEAP_STAT_SIZE_CLASSES; i++){
+		sheap->heap.allocationsPerSizeClass[i] = 0;
+	}
+#if SHEAPERD_SHEAP_MEMORY_ALLOCATION_STRATEGY != SHEAPERD_SHEAP_MEMORY_ALLOCATION_TLSF
+	sheap->largestFreeBlockStale = false;
+	sheap->largestFreeBlockCount = 0;
+	sheap->otherFreeBlocksBound = 0;
+#endif
+#if SHEAPERD_SHEAP_LAZY_INIT == 0
+	clearMemory(sheap->heap.heapMin, size);
+#endif
 
-	gStartBlock = (memory_blockInfo_t*) gHeap.heapMin;
+	sheap->startBlock = (memory_blockInfo_t*) sheap->heap.heapMin;
 #if SHEAPERD_SHEAP_USE_EXTENDED_HEADER == 1
-	updateBlockHeader(gStartBlock, gHeap.size - 2 * sizeof(memory_blockInfo_t), 0, false, SHEAPERD_SHEAP_AUTO_CREATED_BLOCK_ID);
+	updateBlockHeader(sheap->startBlock, sheap->heap.size - BLOCK_META_SIZE, 0, false, SHEAPERD_SHEAP_AUTO_CREATED_BLOCK_ID);
 #elif SHEAPERD_SHEAP_USE_EXTENDED_HEADER == 0
-	updateBlockHeader(gStartBlock, gHeap.size - 2 * sizeof(memory_blockInfo_t), 0, false);
+	updateBlockHeader(sheap->startBlock, sheap->heap.size - BLOCK_META_SIZE, 0, false);
 #endif
-	updateBlockBoundary(gStartBlock);
-	sheap_initMutex();
+#if SHEAPERD_SHEAP_LAZY_INIT == 1
+	// the payload is overwritten by the scrub step, an allocation only overwrites its unused bytes
+	sheap->startBlock->alignmentOffset = FREE_BLOCK_NOT_OVERWRITTEN;
+	updateCRC(sheap->startBlock);
+#endif
+	updateBlockBoundary(sheap->startBlock);
+	initFreeLists(sheap);
+	insertFreeBlock(sheap, sheap->startBlock);
+#if SHEAPERD_SHEAP_MEMORY_ALLOCATION_STRATEGY == SHEAPERD_SHEAP_MEMORY_ALLOCATION_NEXT_FIT
+	sheap->roverBlock = sheap->startBlock;
+#endif
+	sheap->scrubCursor = sheap->startBlock;
+	sheap->scrubPasses = 0;
+#if SHEAPERD_SHEAP_DEFER_OVERWRITE_ON_FREE == 1 && SHEAPERD_SHEAP_SCRUB_OVERWRITE_CHUNK > 0
+	sheap->overwriteBlockEnd = NULL;
+	sheap->overwriteFrom = NULL;
+#endif
+	sheap->generation = 0;
+	sheap->busy = 0;
+#if SHEAPERD_SHEAP_LATENCY_STATISTIC == 1
+	resetLatencyStatistic(sheap);
+#endif
+#if SHEAPERD_SHEAP_TRACE == 1
+	sheap->trace.head = 0;
+	sheap->trace.tail = 0;
+	sheap->trace.dropped = 0;
+	sheap->trace.sequence = 0;
+#endif
+#if SHEAPERD_USE_DWT_CYCLE_COUNTER == 1
+	util_enableCycleCounter();
+#endif
+	sheap_initMutex(sheap);
+	return true;
 }
 
 #if SHEAPERD_SHEAP_USE_EXTENDED_HEADER == 1
-sheap_status_t sheap_getAllocationID(void* ptr, uint32_t* id) {
-	if(!sheap_acquireMutex()){
+sheap_status_t sheap_getAllocationID_instance(sheap_t* sheap, void* ptr, uint32_t* id) {
+	if(sheap_lock(sheap, 0) != MEMORY_LOCK_ACQUIRED){
 		return SHEAP_ERROR;
 	}
-	if(ptr == NULL){
-		return SHEAP_INVALID_POINTER;
-	}
-	if(ptr < (void*)gHeap.heapMin || ptr > (void*)gHeap.heapMax){
-		return SHEAP_INVALID_POINTER;
-	}
-	memory_blockInfo_t* current = PAYLOAD_BLOCK_TO_MEMORY_BLOCK(ptr);
-	if(current == NULL){
-		return SHEAP_INVALID_POINTER;
-	}
-	if(!isBlockHeaderCRCValid(current)){
-		return SHEAP_INVALID_POINTER;
-	}else if(!isBlockBoundaryCRCValid(current)){
-		return SHEAP_INVALID_POINTER;
+	sheap_status_t status = SHEAP_INVALID_POINTER;
+	if(ptr != NULL && ptr >= (void*)sheap->heap.heapMin && ptr <= (void*)sheap->heap.heapMax){
+		memory_blockInfo_t* current = PAYLOAD_BLOCK_TO_MEMORY_BLOCK(ptr);
+		if(isBlockHeaderCRCValid(current) && isBlockBoundaryCRCValid(current)){
+			*id = current->id;
+			status = SHEAP_OK;
+		}
 	}
-	*id = current->id;
-	sheap_releaseMutex();
-	return SHEAP_OK;
+	sheap_unlock(sheap, 0);
+	return status;
+}
+
+sheap_status_t sheap_getAllocationID(void* ptr, uint32_t* id) {
+	return sheap_getAllocationID_instance(&gDefaultSheap, ptr, id);
 }
 #endif
 
-void sheap_logAccess(uint32_t id){
-	gHeaderIds[(++gCurrentIDIndex) % SHEAP_HEADER_ID_LOG_SIZE] = (uint32_t) id;
+void sheap_logAccess(sheap_t* sheap, uint32_t id){
+	sheap->currentIDIndex = (sheap->currentIDIndex + 1) % SHEAP_HEADER_ID_LOG_SIZE;
+	sheap->headerIds[sheap->currentIDIndex] = (uint32_t) id;
 }
 
-size_t sheap_getHeapSize(){
-	return gHeap.size;
+size_t sheap_getHeapSize_instance(sheap_t* sheap){
+	return sheap->heap.size;
 }
 
 size_t sheap_align(size_t n) {
 	return (n + SHEAPERD_SHEAP_MINIMUM_MALLOC_SIZE - 1) & ~(SHEAPERD_SHEAP_MINIMUM_MALLOC_SIZE - 1);
 }
 
-memory_blockInfo_t* getNextFreeBlockOfSize(size_t size){
+memory_blockInfo_t* getNextFreeBlockOfSize(sheap_t* sheap, size_t size, bool reportOutOfMemory){
 #if SHEAPERD_SHEAP_MEMORY_ALLOCATION_STRATEGY == SHEAPERD_SHEAP_MEMORY_ALLOCATION_FIRST_FIT
-	memory_blockInfo_t* current = gStartBlock;
-	while((current->isAllocated == true || current->size < size) && (((uint8_t*)current) < gHeap.heapMax)){
+	memory_blockInfo_t* current = sheap->startBlock;
+	while((((uint8_t*)current) < sheap->heap.heapMax) && (current->isAllocated == true || current->size < size)){
+		COUNT_VISITED_BLOCK(sheap);
 		current = GET_NEXT_MEMORY_BLOCK(current);
 	}
-	if(current == NULL || (((uint8_t*)current) >= gHeap.heapMax)){
-		SHEAPERD_ASSERT("MEMORY Information: No memory available.", false, SHEAP_OUT_OF_MEMORY);
+	COUNT_VISITED_BLOCK(sheap);
+	if(current == NULL || (((uint8_t*)current) >= sheap->heap.heapMax)){
+		SHEAPERD_ASSERT("MEMORY Information: No memory available.", !reportOutOfMemory, SHEAP_OUT_OF_MEMORY);
+		return NULL;
+	}
+
+	if(!isBlockValid(current)){
+		SHEAPERD_ASSERT("MEMORY ERROR: Found invalid block. It may have been altered.", false, SHEAP_ERROR_INVALID_BLOCK);
+		return NULL;
+	}
+	return current;
+#elif SHEAPERD_SHEAP_MEMORY_ALLOCATION_STRATEGY == SHEAPERD_SHEAP_MEMORY_ALLOCATION_TLSF
+	int32_t fl, sl;
+	mappingSearch(size, &fl, &sl);
+	memory_blockInfo_t* current = searchSuitableBlock(sheap, &fl, &sl);
+	COUNT_VISITED_BLOCK(sheap);
+	if(current == NULL){
+		// The rounded up search skips the size class of the requested size. Its first block may still be big enough (one additional check).
+		mappingInsert(size, &fl, &sl);
+		if(fl < TLSF_FL_INDEX_COUNT && sheap->freeBins[fl][sl] != FREE_LIST_NULL
+				&& ((memory_blockInfo_t*)(sheap->heap.heapMin + sheap->freeBins[fl][sl]))->size >= size){
+			current = (memory_blockInfo_t*)(sheap->heap.heapMin + sheap->freeBins[fl][sl]);
+		}
+	}
+	if(current == NULL){
+		SHEAPERD_ASSERT("MEMORY Information: No memory available.", !reportOutOfMemory, SHEAP_OUT_OF_MEMORY);
+		return NULL;
+	}
+
+	if(!isBlockValid(current) || current->isAllocated || current->size < size){
+		SHEAPERD_ASSERT("MEMORY ERROR: Found invalid block. It may have been altered.", false, SHEAP_ERROR_INVALID_BLOCK);
+		return NULL;
+	}
+	return current;
+#elif SHEAPERD_SHEAP_MEMORY_ALLOCATION_STRATEGY == SHEAPERD_SHEAP_MEMORY_ALLOCATION_NEXT_FIT
+	memory_blockInfo_t* current = sheap->roverBlock;
+	bool found = false;
+	do{
+		COUNT_VISITED_BLOCK(sheap);
+		if(current->isAllocated == false && current->size >= size){
+			found = true;
+			break;
+		}
+		current = GET_NEXT_MEMORY_BLOCK(current);
+		if(((uint8_t*)current) >= sheap->heap.heapMax){
+			current = sheap->startBlock;
+		}
+	}while(current != sheap->roverBlock);
+	if(!found){
+		SHEAPERD_ASSERT("MEMORY Information: No memory available.", !reportOutOfMemory, SHEAP_OUT_OF_MEMORY);
 		return NULL;
 	}
 
@@ -261,61 +715,170 @@ memory_blockInfo_t* getNextFreeBlockOfSize(size_t size){
 		SHEAPERD_ASSERT("MEMORY ERROR: Found invalid block. It may have been altered.", false, SHEAP_ERROR_INVALID_BLOCK);
 		return NULL;
 	}
+	// the found block stays a valid header after the allocation (a possible remainder is split off behind it)
+	sheap->roverBlock = current;
 	return current;
+#elif SHEAPERD_SHEAP_MEMORY_ALLOCATION_STRATEGY == SHEAPERD_SHEAP_MEMORY_ALLOCATION_BEST_FIT
+	memory_blockInfo_t* current = sheap->startBlock;
+	memory_blockInfo_t* best = NULL;
+	while(((uint8_t*)current) < sheap->heap.heapMax){
+		COUNT_VISITED_BLOCK(sheap);
+		if(current->isAllocated == false && current->size >= size && (best == NULL || current->size < best->size)){
+			best = current;
+			if(best->size == size){
+				break;
+			}
+		}
+		current = GET_NEXT_MEMORY_BLOCK(current);
+	}
+	if(best == NULL){
+		SHEAPERD_ASSERT("MEMORY Information: No memory available.", !reportOutOfMemory, SHEAP_OUT_OF_MEMORY);
+		return NULL;
+	}
+
+	if(!isBlockValid(best)){
+		SHEAPERD_ASSERT("MEMORY ERROR: Found invalid block. It may have been altered.", false, SHEAP_ERROR_INVALID_BLOCK);
+		return NULL;
+	}
+	return best;
 #else
 	SHEAPERD_ASSERT("MEMORY ERROR: No memory allocation strategy found", false, SHEAP_CONFIG_ERROR_INVALID_ALLOCATION_STRATEGY);
 	return NULL;
 #endif
 }
 
-void* sheap_malloc(size_t size, uint32_t id) {
-    return sheap_alloc_impl(size, id, false);
+void* sheap_malloc_instance(sheap_t* sheap, size_t size, uint32_t id) {
+    return sheap_alloc_impl(sheap, size, 0, id, false);
 }
 
-void* sheap_calloc(size_t num, size_t size, uint32_t id) {
-    return sheap_alloc_impl(num * size, id, true);
+void* sheap_calloc_instance(sheap_t* sheap, size_t num, size_t size, uint32_t id) {
+    return sheap_alloc_impl(sheap, num * size, 0, id, true);
 }
 
-void* sheap_alloc_impl(size_t size, uint32_t id, bool initializeData) {
-    disableIRQs();
-    if(allocBusy) {
-        SHEAPERD_ASSERT("Overlapping call to allocation functions 'sheap_malloc/sheap_alloc' detected. Returning without allocation.", allocBusy == false, SHEAP_MALLOC_CALL_OVERLAP);
-        enableIRQs();
+void* sheap_memalign_instance(sheap_t* sheap, size_t alignment, size_t size, uint32_t id) {
+    if(alignment == 0 || (alignment & (alignment - 1)) != 0) {
+        SHEAPERD_ASSERT("The alignment must be a power of two.", false, SHEAP_INVALID_ALIGNMENT);
         return NULL;
-    } else {
-        allocBusy = true;
     }
-    if(gHeap.heapMin == NULL){
-        SHEAPERD_ASSERT("\"SHEAP_MALLOC\" must not be used before the initialization (\"sheap_init\").", gHeap.heapMin != NULL, SHEAP_NOT_INITIALIZED);
-        CLEAR_MALLOC_FLAG_ENABLE_IRQS_AND_RETURN_NULL();
+    // every payload is aligned to the minimum malloc size
+    return sheap_alloc_impl(sheap, size, alignment > SHEAPERD_SHEAP_MINIMUM_MALLOC_SIZE ? alignment : 0, id, false);
+}
+
+void* sheap_alloc_impl(sheap_t* sheap, size_t size, size_t alignment, uint32_t id, bool initializeData) {
+#if SHEAPERD_SHEAP_TASK_CACHE == 1
+    void* cached;
+    if(alignment == 0 && cacheAllocate(sheap, size, id, initializeData, &cached)) {
+        return cached;
+    }
+#endif
+    if(sheap->heap.heapMin == NULL){
+        SHEAPERD_ASSERT("\"SHEAP_MALLOC\" must not be used before the initialization (\"sheap_init\").", sheap->heap.heapMin != NULL, SHEAP_NOT_INITIALIZED);
+        return NULL;
     }
-    if(!sheap_acquireMutex()){
-        CLEAR_MALLOC_FLAG_ENABLE_IRQS_AND_RETURN_NULL();
+    memory_lock_t lock = sheap_lock(sheap, MEMORY_BUSY_ALLOC);
+    if(lock != MEMORY_LOCK_ACQUIRED) {
+        SHEAPERD_ASSERT("Overlapping call to allocation functions 'sheap_malloc/sheap_alloc' detected. Returning without allocation.",
+                lock != MEMORY_LOCK_BUSY || IS_OVERLAP_EXPECTED(), SHEAP_MALLOC_CALL_OVERLAP);
+        return NULL;
     }
+#if SHEAPERD_SHEAP_LATENCY_STATISTIC == 1
+    uint32_t startCycles = SHEAPERD_GET_CYCLE_COUNT();
+    sheap->blocksVisited = 0;
+#endif
     if(id != 0){
-        sheap_logAccess(id);
+        sheap_logAccess(sheap, id);
     }
+    uint8_t* allocated = NULL;
     if(size == 0){
         SHEAPERD_ASSERT("Cannot allocate size of 0. Is this call intentional?", size > 0, SHEAP_SIZE_ZERO_ALLOC);
-        CLEAR_MALLOC_FLAG_ENABLE_IRQS_AND_RETURN_NULL();
     }
-    uint8_t* allocated = allocateBlock(size, id, initializeData);
+#if SHEAPERD_SHEAP_CHECK_ALL_BLOCKS_ON_MALLOC == 1
+    else if(checkAllBlocks(sheap))
+#else
+    else
+#endif
+    {
+        allocated = alignment == 0 ? allocateBlock(sheap, size, id, initializeData, true)
+                                   : allocateAlignedBlock(sheap, size, alignment, id, true);
+    }
     // allocated may be NULL here
-    sheap_releaseMutex();
-    allocBusy = false;
-    enableIRQs();
+#if SHEAPERD_SHEAP_LATENCY_STATISTIC == 1
+    recordLatency(sheap, initializeData ? MEMORY_LATENCY_CALLOC : MEMORY_LATENCY_MALLOC, SHEAPERD_GET_CYCLE_COUNT() - startCycles, size, id);
+#endif
+    TRACE_EVENT(sheap, alignment != 0 ? SHEAP_TRACE_MEMALIGN : (initializeData ? SHEAP_TRACE_CALLOC : SHEAP_TRACE_MALLOC), id, size, allocated);
+    sheap_unlock(sheap, MEMORY_BUSY_ALLOC);
     return allocated;
 }
 
-uint8_t* allocateBlock(size_t size, uint32_t id, bool initializePayload) {
+uint8_t* allocateBlock(sheap_t* sheap, size_t size, uint32_t id, bool initializePayload, bool reportOutOfMemory) {
     size_t sizeAligned = sheap_align(size);
-    memory_blockInfo_t* allocate = getNextFreeBlockOfSize(sizeAligned);
+    if(sizeAligned < MINIMUM_BLOCK_PAYLOAD_SIZE) {
+        sizeAligned = MINIMUM_BLOCK_PAYLOAD_SIZE;
+    }
+    memory_blockInfo_t* allocate = getNextFreeBlockOfSize(sheap, sizeAligned, reportOutOfMemory);
     if(allocate == NULL) {
         return NULL;
     }
+    if(!removeFreeBlock(sheap, allocate)) {
+        return NULL;
+    }
+    return allocateFreeBlock(sheap, allocate, size, sizeAligned, id, initializePayload);
+}
+
+uint8_t* allocateAlignedBlock(sheap_t* sheap, size_t size, size_t alignment, uint32_t id, bool reportOutOfMemory) {
+    size_t sizeAligned = sheap_align(size);
+    if(sizeAligned < MINIMUM_BLOCK_PAYLOAD_SIZE) {
+        sizeAligned = MINIMUM_BLOCK_PAYLOAD_SIZE;
+    }
+    // the leading slack before the aligned payload must be big enough for a free block
+    size_t minimumLeadSize = GET_BLOCK_OVERHEAD_SIZE(MINIMUM_BLOCK_PAYLOAD_SIZE);
+    memory_blockInfo_t* block = getNextFreeBlockOfSize(sheap, sizeAligned + alignment + minimumLeadSize, reportOutOfMemory);
+    if(block == NULL) {
+        return NULL;
+    }
+    if(!removeFreeBlock(sheap, block)) {
+        return NULL;
+    }
+    uintptr_t payload = (uintptr_t)(block + 1);
+    uintptr_t alignedPayload = (payload + alignment - 1) & ~((uintptr_t)alignment - 1);
+    while(alignedPayload != payload && alignedPayload - payload < minimumLeadSize) {
+        alignedPayload += alignment;
+    }
+    if(alignedPayload != payload) {
+        size_t leadSize = alignedPayload - payload;
+        memory_blockInfo_t* alignedBlock = ((memory_blockInfo_t*)alignedPayload) - 1;
+        alignedBlock->isAllocated = false;
+        alignedBlock->size = block->size - leadSize;
+        // keeps the overwrite state of the free block (SHEAPERD_SHEAP_DEFER_OVERWRITE_ON_FREE)
+        alignedBlock->alignmentOffset = block->alignmentOffset;
+#if SHEAPERD_SHEAP_COMPACT_HEADER == 1
+        alignedBlock->isPrevFree = true;
+#endif
+#if SHEAPERD_SHEAP_USE_EXTENDED_HEADER == 1
+        updateBlockHeader(block, leadSize - BLOCK_META_SIZE, 0, false, SHEAPERD_SHEAP_AUTO_CREATED_BLOCK_ID);
+#elif SHEAPERD_SHEAP_USE_EXTENDED_HEADER == 0
+        updateBlockHeader(block, leadSize - BLOCK_META_SIZE, 0, false);
+#endif
+        block->alignmentOffset = alignedBlock->alignmentOffset;
+        updateCRC(block);
+        updateBlockBoundary(block);
+        insertFreeBlock(sheap, block);
+        block = alignedBlock;
+    }
+    return allocateFreeBlock(sheap, block, size, sizeAligned, id, false);
+}
+
+uint8_t* allocateFreeBlock(sheap_t* sheap, memory_blockInfo_t* allocate, size_t size, size_t sizeAligned, uint32_t id, bool initializePayload) {
     uint32_t preAllocSize = allocate->size;
+#if SHEAPERD_SHEAP_DEFER_OVERWRITE_ON_FREE == 1
+    bool wasOverwritten = IS_FREE_BLOCK_OVERWRITTEN(allocate);
+#endif
+#if SHEAPERD_SHEAP_COMPACT_HEADER == 1
+    // the boundary tag becomes payload (or is rewritten as tag of the remaining block)
+    clearBlockBoundary(allocate);
+#endif
     if (preAllocSize < GET_BLOCK_OVERHEAD_SIZE(sizeAligned)
-            + (SHEAPERD_SHEAP_MINIMUM_MALLOC_SIZE + (2 * sizeof(memory_blockInfo_t)))) {
+            + (MINIMUM_BLOCK_PAYLOAD_SIZE + BLOCK_META_SIZE)) {
         // No additional block of minimum size can be created after this block, therefore take all available memory to obtain heap structure
         sizeAligned = preAllocSize;
     }
@@ -324,16 +887,28 @@ uint8_t* allocateBlock(size_t size, uint32_t id, bool initializePayload) {
     allocate->size = sizeAligned;
 #if SHEAPERD_SHEAP_USE_EXTENDED_HEADER == 1
     allocate->id = id;
+#else
+    (void)id;
 #endif
     allocate->alignmentOffset = sizeAligned - size;
-    updateHeapStatistics(MEMORY_OP_ALLOC, 1, sizeAligned, size,
+    updateHeapStatistics(sheap, MEMORY_OP_ALLOC, 1, sizeAligned, size,
                          GET_BLOCK_OVERHEAD_SIZE(sizeAligned));
 
     updateCRC(allocate);
     updateBlockBoundary(allocate);
 
     uint8_t* payload = (uint8_t*) (allocate + 1);
+#if SHEAPERD_SHEAP_DEFER_OVERWRITE_ON_FREE == 1
+    if(!wasOverwritten) {
+        clearMemory(payload + size, sizeAligned - size);
+    }
+#endif
 
+#if SHEAPERD_SHEAP_DEFER_OVERWRITE_ON_FREE == 1
+    if(allocate->size == preAllocSize) {
+        resetOverwriteProgress(sheap, allocate);
+    }
+#endif
     if (allocate->size < preAllocSize) {
         memory_blockInfo_t *remainingBlock = GET_NEXT_MEMORY_BLOCK(allocate);
 #if SHEAPERD_SHEAP_USE_EXTENDED_HEADER == 1
@@ -341,118 +916,918 @@ uint8_t* allocateBlock(size_t size, uint32_t id, bool initializePayload) {
                           0, false, SHEAPERD_SHEAP_AUTO_CREATED_BLOCK_ID);
 #elif SHEAPERD_SHEAP_USE_EXTENDED_HEADER == 0
         updateBlockHeader(remainingBlock, preAllocSize - GET_BLOCK_OVERHEAD_SIZE(sizeAligned), 0, false);
+#endif
+#if SHEAPERD_SHEAP_DEFER_OVERWRITE_ON_FREE == 1
+        if(!wasOverwritten) {
+            remainingBlock->alignmentOffset = FREE_BLOCK_NOT_OVERWRITTEN;
+            updateCRC(remainingBlock);
+        }
 #endif
         updateBlockBoundary(remainingBlock);
+        insertFreeBlock(sheap, remainingBlock);
+    }
+#if SHEAPERD_SHEAP_COMPACT_HEADER == 1
+    else {
+        updatePrevFreeOfNextBlock(sheap, allocate);
     }
+#endif
 
     if(initializePayload) {
-        uint8_t* p = payload;
-        while(p < (uint8_t*)GET_BOUNDARY_TAG(allocate)) {
-            *p++ = SHEAPERD_SHEAP_CALLOC_VALUE;
-        }
+        // the unused bytes after the requested size keep the overwrite value (out of bound write check)
+        util_fillMemory(payload, SHEAPERD_SHEAP_CALLOC_VALUE, size);
     }
     return payload;
 }
 
-void sheap_free(void* ptr, uint32_t id){
-    disableIRQs();
-	if(freeBusy) {
-		SHEAPERD_ASSERT("Overlapping call to 'sheap_free' detected. Returning without freeing memory.", freeBusy == false, SHEAP_FREE_CALL_OVERLAP);
-		enableIRQs();
+void sheap_free_instance(sheap_t* sheap, void* ptr, uint32_t id){
+#if SHEAPERD_SHEAP_TASK_CACHE == 1
+	if(cacheFree(sheap, ptr, id)){
+		return;
+	}
+#endif
+	memory_lock_t lock = sheap_lock(sheap, MEMORY_BUSY_FREE);
+	if(lock != MEMORY_LOCK_ACQUIRED) {
+		SHEAPERD_ASSERT("Overlapping call to 'sheap_free' detected. Returning without freeing memory.",
+				lock != MEMORY_LOCK_BUSY || IS_OVERLAP_EXPECTED(), SHEAP_FREE_CALL_OVERLAP);
 		return;
-	} else {
-		freeBusy = true;
 	}
-	if(!sheap_acquireMutex()){
-	    CLEAR_FREE_FLAG_ENABLE_IRQS_AND_RETURN();
+#if SHEAPERD_SHEAP_LATENCY_STATISTIC == 1
+	uint32_t startCycles = SHEAPERD_GET_CYCLE_COUNT();
+	sheap->blocksVisited = 0;
+	// the header is cleared if the block is merged with the previous block
+	size_t size = 0;
+	if((uint8_t*)ptr >= sheap->heap.heapMin + sizeof(memory_blockInfo_t) && (uint8_t*)ptr < sheap->heap.heapMax){
+		memory_blockInfo_t* block = PAYLOAD_BLOCK_TO_MEMORY_BLOCK(ptr);
+		size = block->size;
 	}
+#endif
 	if(id != 0){
-		sheap_logAccess(id);
+		sheap_logAccess(sheap, id);
 	}
-	if(ptr == NULL){
-		REPORT_ERROR_RELEASE_MUTEX_CLEAR_FREE_FLAG_ENABLE_IRQS_AND_RETURN(
-				"MEMORY ERROR: Free operation not valid for null pointer", SHEAP_ERROR_NULL_FREE);
+#if SHEAPERD_SHEAP_CHECK_ALL_BLOCKS_ON_FREE == 1
+	// the block is not freed into an altered heap, it stays allocated
+	if(checkAllBlocks(sheap)){
+		freeBlock(sheap, ptr, id);
 	}
-	if(ptr < (void*)gHeap.heapMin || ptr > (void*)gHeap.heapMax){
-		REPORT_ERROR_RELEASE_MUTEX_CLEAR_FREE_FLAG_ENABLE_IRQS_AND_RETURN(
-				"Cannot free pointer outside of heap.", SHEAP_ERROR_FREE_PTR_NOT_IN_HEAP);
+#else
+	freeBlock(sheap, ptr, id);
+#endif
+#if SHEAPERD_SHEAP_LATENCY_STATISTIC == 1
+	recordLatency(sheap, MEMORY_LATENCY_FREE, SHEAPERD_GET_CYCLE_COUNT() - startCycles, size, id);
+#endif
+	TRACE_EVENT(sheap, SHEAP_TRACE_FREE, id, 0, ptr);
+	sheap_unlock(sheap, MEMORY_BUSY_FREE);
+}
+
+sheap_status_t sheap_malloc_batch_instance(sheap_t* sheap, const size_t sizes[], void* allocated[], size_t n, uint32_t id){
+	if(sizes == NULL || allocated == NULL){
+		return SHEAP_ERROR;
 	}
-	memory_blockInfo_t* current = PAYLOAD_BLOCK_TO_MEMORY_BLOCK(ptr);
-	if(current == NULL){
-		REPORT_ERROR_RELEASE_MUTEX_CLEAR_FREE_FLAG_ENABLE_IRQS_AND_RETURN(
-				"Cannot free the provided pointer", SHEAP_ERROR_FREE_INVALID_HEADER);
+	if(sheap->heap.heapMin == NULL){
+		SHEAPERD_ASSERT("\"SHEAP_MALLOC\" must not be used before the initialization (\"sheap_init\").", sheap->heap.heapMin != NULL, SHEAP_NOT_INITIALIZED);
+		return SHEAP_ERROR;
 	}
-	if(!isBlockHeaderCRCValid(current)){
-		REPORT_ERROR_RELEASE_MUTEX_CLEAR_FREE_FLAG_ENABLE_IRQS_AND_RETURN(
-				"MEMORY ERROR: Free operation can not be performed as block header is not valid",
-				SHEAP_ERROR_FREE_INVALID_HEADER);
-	}else if(!isBlockBoundaryCRCValid(current)){
-		REPORT_ERROR_RELEASE_MUTEX_CLEAR_FREE_FLAG_ENABLE_IRQS_AND_RETURN(
-				"MEMORY ERROR: Free operation can not be performed as block boundary is not valid. It may have been altered. Calling the error callback",
-				SHEAP_ERROR_FREE_INVALID_BOUNDARY);
+	memory_lock_t lock = sheap_lock(sheap, MEMORY_BUSY_ALLOC);
+	if(lock != MEMORY_LOCK_ACQUIRED) {
+		SHEAPERD_ASSERT("Overlapping call to allocation functions 'sheap_malloc/sheap_alloc' detected. Returning without allocation.",
+				lock != MEMORY_LOCK_BUSY || IS_OVERLAP_EXPECTED(), SHEAP_MALLOC_CALL_OVERLAP);
+		return lock == MEMORY_LOCK_BUSY ? SHEAP_BUSY : SHEAP_ERROR;
+	}
+	if(id != 0){
+		sheap_logAccess(sheap, id);
+	}
+	size_t count = 0;
+#if SHEAPERD_SHEAP_CHECK_ALL_BLOCKS_ON_MALLOC == 1
+	if(checkAllBlocks(sheap))
+#endif
+	{
+		for(; count < n; count++){
+			if(sizes[count] == 0){
+				SHEAPERD_ASSERT("Cannot allocate size of 0. Is this call intentional?", false, SHEAP_SIZE_ZERO_ALLOC);
+				break;
+			}
+			allocated[count] = allocateBlock(sheap, sizes[count], id, false, false);
+			TRACE_EVENT(sheap, SHEAP_TRACE_MALLOC, id, sizes[count], allocated[count]);
+			if(allocated[count] == NULL){
+				SHEAPERD_ASSERT("MEMORY ERROR: Not enough memory for the batch allocation.", false, SHEAP_OUT_OF_MEMORY);
+				break;
+			}
+		}
+	}
+	sheap_status_t status = SHEAP_OK;
+	if(count < n){
+		// all or nothing, release the blocks of this batch in reverse order
+		while(count > 0){
+			count--;
+			freeBlock(sheap, allocated[count], id);
+			TRACE_EVENT(sheap, SHEAP_TRACE_FREE, id, 0, allocated[count]);
+		}
+		for(size_t i = 0; i < n; i++){
+			allocated[i] = NULL;
+		}
+		status = SHEAP_ERROR;
 	}
+	sheap_unlock(sheap, MEMORY_BUSY_ALLOC);
+	return status;
+}
 
-#ifdef SHEAPERD_SHEAP_FREE_CHECK_UNALIGNED_SIZE
-	bool illegalWrite = checkForIllegalWrite(current);
-	if(illegalWrite){
-		REPORT_ERROR_RELEASE_MUTEX_CLEAR_FREE_FLAG_ENABLE_IRQS_AND_RETURN(
-				"MEMORY ERROR: Out of bound write detected. Free operation aborted", SHEAP_ERROR_OUT_OF_BOUND_WRITE);
+void sheap_free_batch_instance(sheap_t* sheap, void* ptrs[], size_t n, uint32_t id){
+	if(ptrs == NULL){
+		return;
+	}
+	memory_lock_t lock = sheap_lock(sheap, MEMORY_BUSY_FREE);
+	if(lock != MEMORY_LOCK_ACQUIRED) {
+		SHEAPERD_ASSERT("Overlapping call to 'sheap_free' detected. Returning without freeing memory.",
+				lock != MEMORY_LOCK_BUSY || IS_OVERLAP_EXPECTED(), SHEAP_FREE_CALL_OVERLAP);
+		return;
+	}
+	if(id != 0){
+		sheap_logAccess(sheap, id);
 	}
+#if SHEAPERD_SHEAP_CHECK_ALL_BLOCKS_ON_FREE == 1
+	if(checkAllBlocks(sheap))
 #endif
+	{
+		sortByAddress(ptrs, n);
+		// adjacent blocks of the batch are collected into runs, each run is released as one free block
+		memory_blockInfo_t* first = NULL;
+		memory_blockInfo_t* last = NULL;
+		for(size_t i = 0; i < n; i++){
+			if(ptrs[i] == NULL){
+				// already freed by the caller (guarded allocations of sheap_free_batch)
+				continue;
+			}
+			TRACE_EVENT(sheap, SHEAP_TRACE_FREE, id, 0, ptrs[i]);
+			memory_blockInfo_t* block = getCheckedBlock(sheap, ptrs[i]);
+			if(block == NULL){
+				continue;
+			}
+			if(!block->isAllocated || block == last){
+				SHEAPERD_ASSERT("MEMORY ERROR: Double free detected.", false, SHEAP_ERROR_DOUBLE_FREE);
+				continue;
+			}
+			updateHeapStatistics(sheap, MEMORY_OP_FREE, 1, block->size, block->size - block->alignmentOffset, GET_BLOCK_OVERHEAD_SIZE(block->size));
+			if(last != NULL && block == GET_NEXT_MEMORY_BLOCK(last)){
+				last = block;
+				continue;
+			}
+			if(first != NULL){
+				freeBlockRun(sheap, first, last, id);
+			}
+			first = block;
+			last = block;
+		}
+		if(first != NULL){
+			freeBlockRun(sheap, first, last, id);
+		}
+	}
+	sheap_unlock(sheap, MEMORY_BUSY_FREE);
+}
 
-	if(current->isAllocated) {
-		current->isAllocated = false;
-		updateHeapStatistics(MEMORY_OP_FREE, 1, current->size, current->size - current->alignmentOffset, GET_BLOCK_OVERHEAD_SIZE(current->size));
+void sortByAddress(void* ptrs[], size_t n){
+	// insertion sort, batches are small
+	for(size_t i = 1; i < n; i++){
+		void* ptr = ptrs[i];
+		size_t j = i;
+		while(j > 0 && (uintptr_t)ptrs[j - 1] > (uintptr_t)ptr){
+			ptrs[j] = ptrs[j - 1];
+			j--;
+		}
+		ptrs[j] = ptr;
+	}
+}
 
-#ifdef SHEAPERD_SHEAP_OVERWRITE_ON_FREE
-		clearMemory((uint8_t*)ptr, current->size);
+void freeBlockRun(sheap_t* sheap, memory_blockInfo_t* first, memory_blockInfo_t* last, uint32_t id){
+	uint8_t* payload = (uint8_t*)(first + 1);
+	size_t size = (uint8_t*)GET_NEXT_MEMORY_BLOCK(last) - payload - (BLOCK_META_SIZE - sizeof(memory_blockInfo_t));
+	memory_blockInfo_t* block = first;
+	while(block != last){
+		memory_blockInfo_t* next = GET_NEXT_MEMORY_BLOCK(block);
+		// boundary of block and header of next become payload
+		clearMemory((uint8_t*)(next - 1), sizeof(memory_blockInfo_t));
+		if(block != first){
+			clearBlockHeader(block);
+		}
+#if SHEAPERD_SHEAP_MEMORY_ALLOCATION_STRATEGY == SHEAPERD_SHEAP_MEMORY_ALLOCATION_NEXT_FIT
+		if(sheap->roverBlock == next){
+			sheap->roverBlock = first;
+		}
 #endif
-		current = coalesce(&current);
+		if(sheap->scrubCursor == next){
+			sheap->scrubCursor = first;
+		}
+		block = next;
+	}
+	if(last != first){
+		clearBlockHeader(last);
+	}
+	first->isAllocated = false;
+	first->size = size;
+#if defined(SHEAPERD_SHEAP_OVERWRITE_ON_FREE) && SHEAPERD_SHEAP_DEFER_OVERWRITE_ON_FREE == 0
+	clearMemory(payload, size);
+#endif
+	first = coalesce(sheap, &first);
+#if SHEAPERD_SHEAP_USE_EXTENDED_HEADER == 1
+	first->id = id;
+#else
+	(void)id;
+#endif
+	updateCRC(first);
+	updateBlockBoundary(first);
+	insertFreeBlock(sheap, first);
+#if SHEAPERD_SHEAP_COMPACT_HEADER == 1
+	updatePrevFreeOfNextBlock(sheap, first);
+#endif
+}
+
+void* sheap_realloc_instance(sheap_t* sheap, void* ptr, size_t size, uint32_t id){
+	if(ptr == NULL){
+		return sheap_malloc_instance(sheap, size, id);
+	}
+	if(size == 0){
+		sheap_free_instance(sheap, ptr, id);
+		return NULL;
+	}
+	if(sheap->heap.heapMin == NULL){
+		SHEAPERD_ASSERT("\"SHEAP_REALLOC\" must not be used before the initialization (\"sheap_init\").", sheap->heap.heapMin != NULL, SHEAP_NOT_INITIALIZED);
+		return NULL;
+	}
+	memory_lock_t lock = sheap_lock(sheap, MEMORY_BUSY_ALLOC | MEMORY_BUSY_FREE);
+	if(lock != MEMORY_LOCK_ACQUIRED) {
+		SHEAPERD_ASSERT("Overlapping call to 'sheap_realloc' detected. Returning without reallocation.", lock != MEMORY_LOCK_BUSY || IS_OVERLAP_EXPECTED(),
+				(sheap->busy & MEMORY_BUSY_ALLOC) ? SHEAP_MALLOC_CALL_OVERLAP : SHEAP_FREE_CALL_OVERLAP);
+		return NULL;
+	}
+	if(id != 0){
+		sheap_logAccess(sheap, id);
+	}
+	void* reallocated = reallocateBlock(sheap, ptr, size, id);
+	// reallocated may be NULL here, ptr is still valid in this case
+#if SHEAPERD_SHEAP_TRACE == 1
+	if(reallocated != NULL){
+		traceEvent(sheap, SHEAP_TRACE_FREE, id, 0, ptr);
+	}
+	traceEvent(sheap, SHEAP_TRACE_REALLOC, id, size, reallocated);
+#endif
+	sheap_unlock(sheap, MEMORY_BUSY_ALLOC | MEMORY_BUSY_FREE);
+	return reallocated;
+}
+
+void* reallocateBlock(sheap_t* sheap, void* ptr, size_t size, uint32_t id){
+	memory_blockInfo_t* block = getCheckedBlock(sheap, ptr);
+	if(block == NULL){
+		return NULL;
+	}
+	if(!block->isAllocated){
+		REPORT_ERROR_AND_RETURN_NULL("MEMORY ERROR: Reallocation of a freed block detected.", SHEAP_ERROR_DOUBLE_FREE);
+	}
+	size_t sizeAligned = sheap_align(size);
+	if(sizeAligned < MINIMUM_BLOCK_PAYLOAD_SIZE) {
+		sizeAligned = MINIMUM_BLOCK_PAYLOAD_SIZE;
+	}
+	uint8_t* payload = (uint8_t*)ptr;
+	size_t previousSize = block->size;
+	size_t previousRequested = block->size - block->alignmentOffset;
+
+	if(sizeAligned > block->size){
+		memory_blockInfo_t* next = GET_NEXT_MEMORY_BLOCK(block);
+		if(!isNextBlockFree(sheap, block) || block->size + GET_BLOCK_OVERHEAD_SIZE(next->size) < sizeAligned){
+			// no growth in place possible
+			uint8_t* allocated = allocateBlock(sheap, size, id, false, true);
+			if(allocated != NULL){
+				for(size_t i = 0; i < previousRequested; i++){
+					allocated[i] = payload[i];
+				}
+				freeBlock(sheap, ptr, id);
+			}
+			return allocated;
+		}
+#if SHEAPERD_SHEAP_DEFER_OVERWRITE_ON_FREE == 1
+		bool isNextOverwritten = IS_FREE_BLOCK_OVERWRITTEN(next);
+#endif
+		uint32_t absorbed = absorbNextFreeBlock(sheap, block);
+		if(absorbed == 0){
+			return NULL;
+		}
+		// the absorbed header, boundary and payload are overwritten already
+		block->size += absorbed;
+#if SHEAPERD_SHEAP_DEFER_OVERWRITE_ON_FREE == 1
+		if(!isNextOverwritten){
+			clearMemory(payload + block->size - absorbed, absorbed);
+		}
+#endif
+	}else if(size < previousRequested){
+		// the unused bytes after the requested size are checked for out of bound writes on free
+		clearMemory(payload + size, previousRequested - size);
+	}
+
+	if (block->size >= GET_BLOCK_OVERHEAD_SIZE(sizeAligned) + (MINIMUM_BLOCK_PAYLOAD_SIZE + BLOCK_META_SIZE)) {
+		releaseBlockTail(sheap, block, sizeAligned);
+	}
+#if SHEAPERD_SHEAP_COMPACT_HEADER == 1
+	else if(block->size > previousSize) {
+		// the absorbed free block was the previous block of the next block
+		updatePrevFreeOfNextBlock(sheap, block);
+	}
+#endif
+	block->alignmentOffset = block->size - size;
+#if SHEAPERD_SHEAP_USE_EXTENDED_HEADER == 1
+	block->id = id;
+#endif
+	updateHeapStatistics(sheap, MEMORY_OP_FREE, 1, previousSize, previousRequested, GET_BLOCK_OVERHEAD_SIZE(previousSize));
+	updateHeapStatistics(sheap, MEMORY_OP_ALLOC, 1, block->size, size, GET_BLOCK_OVERHEAD_SIZE(block->size));
+	updateCRC(block);
+	updateBlockBoundary(block);
+	return payload;
+}
+
+memory_blockInfo_t* getCheckedBlock(sheap_t* sheap, void* ptr){
+	if(ptr == NULL){
+		REPORT_ERROR_AND_RETURN_NULL(
+				"MEMORY ERROR: Free operation not valid for null pointer", SHEAP_ERROR_NULL_FREE);
+	}
+	if(ptr < (void*)sheap->heap.heapMin || ptr > (void*)sheap->heap.heapMax){
+		REPORT_ERROR_AND_RETURN_NULL(
+				"Cannot free pointer outside of heap.", SHEAP_ERROR_FREE_PTR_NOT_IN_HEAP);
+	}
+	memory_blockInfo_t* current = PAYLOAD_BLOCK_TO_MEMORY_BLOCK(ptr);
+	if(current == NULL){
+		REPORT_ERROR_AND_RETURN_NULL(
+				"Cannot free the provided pointer", SHEAP_ERROR_FREE_INVALID_HEADER);
+	}
+	if(!isBlockHeaderCRCValid(current)){
+		REPORT_ERROR_AND_RETURN_NULL(
+				"MEMORY ERROR: Free operation can not be performed as block header is not valid",
+				SHEAP_ERROR_FREE_INVALID_HEADER);
+	}else if(!isBlockBoundaryCRCValid(current)){
+		REPORT_ERROR_AND_RETURN_NULL(
+				"MEMORY ERROR: Free operation can not be performed as block boundary is not valid. It may have been altered. Calling the error callback",
+				SHEAP_ERROR_FREE_INVALID_BOUNDARY);
+	}
+#if SHEAPERD_SHEAP_COMPACT_HEADER == 1
+	// without boundary tag a write past the payload of an allocated block is detected in the header of the next block
+	memory_blockInfo_t* next = GET_NEXT_MEMORY_BLOCK(current);
+	if(current->isAllocated && ((uint8_t*)next) < sheap->heap.heapMax && !isBlockHeaderCRCValid(next)){
+		REPORT_ERROR_AND_RETURN_NULL(
+				"MEMORY ERROR: Free operation can not be performed as the header of the next block is not valid. A bound overflow may have occurred",
+				SHEAP_ERROR_FREE_INVALID_BOUNDARY);
+	}
+#endif
+
+#ifdef SHEAPERD_SHEAP_FREE_CHECK_UNALIGNED_SIZE
+	bool illegalWrite = checkForIllegalWrite(current);
+	if(illegalWrite){
+		REPORT_ERROR_AND_RETURN_NULL(
+				"MEMORY ERROR: Out of bound write detected. Free operation aborted", SHEAP_ERROR_OUT_OF_BOUND_WRITE);
+	}
+#endif
+
+#if SHEAPERD_SHEAP_TASK_CACHE == 1
+	if(current->isAllocated && *((uint32_t*)ptr) == CACHED_BLOCK_TAG(current)){
+		REPORT_ERROR_AND_RETURN_NULL("MEMORY ERROR: Double free detected. The block is held by a task cache.", SHEAP_ERROR_DOUBLE_FREE);
+	}
+#endif
+	return current;
+}
+
+void freeBlock(sheap_t* sheap, void* ptr, uint32_t id){
+	memory_blockInfo_t* current = getCheckedBlock(sheap, ptr);
+	if(current == NULL){
+		return;
+	}
+	if(current->isAllocated) {
+		current->isAllocated = false;
+		updateHeapStatistics(sheap, MEMORY_OP_FREE, 1, current->size, current->size - current->alignmentOffset, GET_BLOCK_OVERHEAD_SIZE(current->size));
+
+#if defined(SHEAPERD_SHEAP_OVERWRITE_ON_FREE) && SHEAPERD_SHEAP_DEFER_OVERWRITE_ON_FREE == 0
+		clearMemory((uint8_t*)ptr, current->size);
+#endif
+		current = coalesce(sheap, &current);
 #if SHEAPERD_SHEAP_USE_EXTENDED_HEADER == 1
 		current->id = id;
+#else
+		(void)id;
 #endif
 		updateCRC(current);
 		updateBlockBoundary(current);
+		insertFreeBlock(sheap, current);
+#if SHEAPERD_SHEAP_COMPACT_HEADER == 1
+		updatePrevFreeOfNextBlock(sheap, current);
+#endif
 	}else{
 		SHEAPERD_ASSERT("MEMORY ERROR: Double free detected.", false, SHEAP_ERROR_DOUBLE_FREE);
 	}
-	sheap_releaseMutex();
-	freeBusy = false;
-	enableIRQs();
 }
 
-memory_blockInfo_t* coalesce(memory_blockInfo_t** block){
+#if SHEAPERD_SHEAP_TASK_CACHE == 1
+void sheap_cache_flush_instance(sheap_t* sheap){
+	if(sheap->heap.heapMin == NULL || SHEAPERD_IS_ISR_CONTEXT()){
+		return;
+	}
+	memory_taskCache_t* cache = findTaskCache(sheap, GET_THREAD_ID());
+	if(cache == NULL){
+		return;
+	}
+	bool drained = true;
+	for(int32_t sizeClass = 0; sizeClass < SHEAPERD_SHEAP_TASK_CACHE_CLASSES; sizeClass++){
+		if(cache->count[sizeClass] > 0){
+			drained &= drainTaskCache(sheap, cache, sizeClass, cache->count[sizeClass], 0) == MEMORY_LOCK_ACQUIRED;
+		}
+	}
+	if(drained){
+		cache->owner = 0;
+	}
+}
+
+int32_t getCacheClass(size_t sizeAligned){
+	for(int32_t sizeClass = 0; sizeClass < SHEAPERD_SHEAP_TASK_CACHE_CLASSES; sizeClass++){
+		if(sizeAligned <= CACHE_CLASS_SIZE(sizeClass)){
+			return sizeClass;
+		}
+	}
+	return -1;
+}
+
+memory_taskCache_t* findTaskCache(sheap_t* sheap, memory_threadId_t thread){
+	for(int32_t i = 0; i < SHEAPERD_SHEAP_TASK_CACHE_TASKS; i++){
+		if(sheap->taskCaches[i].owner == thread){
+			return &sheap->taskCaches[i];
+		}
+	}
+	return NULL;
+}
+
+bool cacheAllocate(sheap_t* sheap, size_t size, uint32_t id, bool initializeData, void** allocated){
+	if(size == 0 || sheap->heap.heapMin == NULL || SHEAPERD_IS_ISR_CONTEXT()){
+		return false;
+	}
+	int32_t sizeClass = getCacheClass(sheap_align(size));
+	if(sizeClass < 0){
+		return false;
+	}
+	memory_threadId_t thread = GET_THREAD_ID();
+	memory_taskCache_t* cache = findTaskCache(sheap, thread);
+	if(cache == NULL || cache->count[sizeClass] == 0){
+		memory_lock_t lock = refillTaskCache(sheap, &cache, thread, sizeClass, id);
+		if(lock != MEMORY_LOCK_ACQUIRED){
+			// the regular allocation would find the sheap locked as well
+			SHEAPERD_ASSERT("Overlapping call to allocation functions 'sheap_malloc/sheap_alloc' detected. Returning without allocation.",
+					lock != MEMORY_LOCK_BUSY || IS_OVERLAP_EXPECTED(), SHEAP_MALLOC_CALL_OVERLAP);
+			*allocated = NULL;
+			return true;
+		}
+		if(cache == NULL || cache->count[sizeClass] == 0){
+			// no cache available or not enough memory for a block of the class, reported by the regular allocation
+			return false;
+		}
+	}
+	// only the payload is written, the header (class size, no unused bytes) is written with the lock by the refill or the regular allocation
+	memory_blockInfo_t* block = cache->blocks[sizeClass][--cache->count[sizeClass]];
+	uint8_t* payload = (uint8_t*)(block + 1);
+	clearMemory(payload, sizeof(uint32_t));
+	if(initializeData){
+		util_fillMemory(payload, SHEAPERD_SHEAP_CALLOC_VALUE, size);
+	}
+	*allocated = payload;
+	return true;
+}
+
+bool cacheFree(sheap_t* sheap, void* ptr, uint32_t id){
+	if(ptr == NULL || sheap->heap.heapMin == NULL || SHEAPERD_IS_ISR_CONTEXT()){
+		return false;
+	}
+	if((uint8_t*)ptr < sheap->heap.heapMin + sizeof(memory_blockInfo_t) || (uint8_t*)ptr >= sheap->heap.heapMax){
+		return false;
+	}
+	memory_blockInfo_t* block = PAYLOAD_BLOCK_TO_MEMORY_BLOCK(ptr);
+	// every error is reported by the regular free
+	if(!isBlockHeaderCRCValid(block) || !block->isAllocated || !isBlockBoundaryCRCValid(block)){
+		return false;
+	}
+#ifdef SHEAPERD_SHEAP_FREE_CHECK_UNALIGNED_SIZE
+	if(checkForIllegalWrite(block)){
+		return false;
+	}
+#endif
+	int32_t sizeClass = getCacheClass(block->size);
+	// the header is not written without the lock, a block with unused bytes after the requested size is freed regularly
+	if(sizeClass < 0 || block->size != CACHE_CLASS_SIZE(sizeClass) || block->alignmentOffset != 0){
+		return false;
+	}
+	memory_taskCache_t* cache = findTaskCache(sheap, GET_THREAD_ID());
+	if(cache == NULL){
+		return false;
+	}
+	if(*((uint32_t*)ptr) == CACHED_BLOCK_TAG(block)){
+		SHEAPERD_ASSERT("MEMORY ERROR: Double free detected. The block is held by a task cache.", false, SHEAP_ERROR_DOUBLE_FREE);
+		return true;
+	}
+	if(cache->count[sizeClass] == SHEAPERD_SHEAP_TASK_CACHE_DEPTH){
+		memory_lock_t lock = drainTaskCache(sheap, cache, sizeClass, SHEAPERD_SHEAP_TASK_CACHE_BATCH, id);
+		if(lock != MEMORY_LOCK_ACQUIRED){
+			// the regular free would find the sheap locked as well
+			SHEAPERD_ASSERT("Overlapping call to 'sheap_free' detected. Returning without freeing memory.",
+					lock != MEMORY_LOCK_BUSY || IS_OVERLAP_EXPECTED(), SHEAP_FREE_CALL_OVERLAP);
+			return true;
+		}
+	}
+#ifdef SHEAPERD_SHEAP_OVERWRITE_ON_FREE
+	clearMemory((uint8_t*)ptr, block->size);
+#endif
+	*((uint32_t*)ptr) = CACHED_BLOCK_TAG(block);
+	cache->blocks[sizeClass][cache->count[sizeClass]++] = block;
+	return true;
+}
+
+memory_lock_t refillTaskCache(sheap_t* sheap, memory_taskCache_t** cache, memory_threadId_t thread, int32_t sizeClass, uint32_t id){
+	memory_lock_t lock = sheap_lock(sheap, MEMORY_BUSY_ALLOC);
+	if(lock != MEMORY_LOCK_ACQUIRED){
+		return lock;
+	}
+	if(*cache == NULL){
+		for(int32_t i = 0; i < SHEAPERD_SHEAP_TASK_CACHE_TASKS; i++){
+			if(sheap->taskCaches[i].owner == 0){
+				for(int32_t c = 0; c < SHEAPERD_SHEAP_TASK_CACHE_CLASSES; c++){
+					sheap->taskCaches[i].count[c] = 0;
+				}
+				sheap->taskCaches[i].owner = thread;
+				*cache = &sheap->taskCaches[i];
+				break;
+			}
+		}
+	}
+	if(*cache != NULL){
+		memory_taskCache_t* c = *cache;
+		for(uint32_t i = 0; i < SHEAPERD_SHEAP_TASK_CACHE_BATCH && c->count[sizeClass] < SHEAPERD_SHEAP_TASK_CACHE_DEPTH; i++){
+			uint8_t* payload = allocateBlock(sheap, CACHE_CLASS_SIZE(sizeClass), id, false, false);
+			if(payload == NULL){
+				break;
+			}
+			memory_blockInfo_t* block = PAYLOAD_BLOCK_TO_MEMORY_BLOCK(payload);
+			if(block->size != CACHE_CLASS_SIZE(sizeClass)){
+				// the whole remaining free block was taken, such a block cannot be cached
+				freeBlock(sheap, payload, id);
+				break;
+			}
+#if SHEAPERD_SHEAP_DEFER_OVERWRITE_ON_FREE == 1
+			// the allocation only overwrites the bytes after the requested size, a cached block is handed out with any size of its class
+			clearMemory(payload, block->size);
+#endif
+			*((uint32_t*)payload) = CACHED_BLOCK_TAG(block);
+			c->blocks[sizeClass][c->count[sizeClass]++] = block;
+		}
+	}
+	sheap_unlock(sheap, MEMORY_BUSY_ALLOC);
+	return MEMORY_LOCK_ACQUIRED;
+}
+
+memory_lock_t drainTaskCache(sheap_t* sheap, memory_taskCache_t* cache, int32_t sizeClass, uint32_t count, uint32_t id){
+	memory_lock_t lock = sheap_lock(sheap, MEMORY_BUSY_FREE);
+	if(lock != MEMORY_LOCK_ACQUIRED){
+		return lock;
+	}
+	// the oldest blocks are at the bottom of the magazine
+	for(uint32_t i = 0; i < count; i++){
+		uint8_t* payload = (uint8_t*)(cache->blocks[sizeClass][i] + 1);
+		clearMemory(payload, sizeof(uint32_t));
+		freeBlock(sheap, payload, id);
+	}
+	for(uint32_t i = count; i < cache->count[sizeClass]; i++){
+		cache->blocks[sizeClass][i - count] = cache->blocks[sizeClass][i];
+	}
+	cache->count[sizeClass] -= count;
+	sheap_unlock(sheap, MEMORY_BUSY_FREE);
+	return MEMORY_LOCK_ACQUIRED;
+}
+#endif
+
+memory_blockInfo_t* coalesce(sheap_t* sheap, memory_blockInfo_t** block){
 	size_t size = (*block)->size;
-	if (isNextBlockFree((*block))) {
-		memory_blockInfo_t* next = GET_NEXT_MEMORY_BLOCK((*block));
-		bool isValid = isBlockValid(next);
-		SHEAPERD_ASSERT("MEMORY ERROR: Free cannot coalesce with next block as it is not valid.", isValid, SHEAP_ERROR_COALESCING_NEXT_BLOCK_ALTERED_INVALID_CRC);
-		if (isValid) {
-			size += next->size + (2 * sizeof(memory_blockInfo_t));
-			clearBlockHeader(next);
-			clearBlockBoundary(*block);
-		}
-	}
-	if (isPreviousBlockFree((*block))) {
-		memory_blockInfo_t* prev = GET_PREV_MEMORY_BLOCK((*block));
-		bool isValid = isBlockValid(prev);
+	if (isNextBlockFree(sheap, (*block))) {
+		size += absorbNextFreeBlock(sheap, *block);
+	}
+	if (isPreviousBlockFree(sheap, (*block))) {
+		memory_blockInfo_t* prev = getPreviousFreeBlock(sheap, *block);
+		bool isValid = prev != NULL;
 		SHEAPERD_ASSERT("MEMORY ERROR: Free cannot coalesce with previous block as it is not valid.", isValid, SHEAP_ERROR_COALESCING_PREV_BLOCK_ALTERED_INVALID_CRC);
-		if (isValid) {
-			size += prev->size + (2 * sizeof(memory_blockInfo_t));
+		if (isValid && removeFreeBlock(sheap, prev)) {
+			size += prev->size + BLOCK_META_SIZE;
 			clearBlockHeader(*block);
+#if SHEAPERD_SHEAP_MEMORY_ALLOCATION_STRATEGY == SHEAPERD_SHEAP_MEMORY_ALLOCATION_NEXT_FIT
+			if(sheap->roverBlock == *block){
+				sheap->roverBlock = prev;
+			}
+#endif
+			if(sheap->scrubCursor == *block){
+				sheap->scrubCursor = prev;
+			}
 			(*block) = prev;
 			clearBlockBoundary(prev);
 		}
 	}
 	(*block)->size = size;
+#if SHEAPERD_SHEAP_DEFER_OVERWRITE_ON_FREE == 1
+	(*block)->alignmentOffset = FREE_BLOCK_NOT_OVERWRITTEN;
+#else
 	(*block)->alignmentOffset = 0;
+#endif
 	return *block;
 }
 
+uint32_t absorbNextFreeBlock(sheap_t* sheap, memory_blockInfo_t* block){
+	memory_blockInfo_t* next = GET_NEXT_MEMORY_BLOCK(block);
+	bool isValid = isBlockValid(next);
+	SHEAPERD_ASSERT("MEMORY ERROR: Free cannot coalesce with next block as it is not valid.", isValid, SHEAP_ERROR_COALESCING_NEXT_BLOCK_ALTERED_INVALID_CRC);
+	if (!isValid) {
+		return 0;
+	}
+	if (!removeFreeBlock(sheap, next)) {
+		return 0;
+	}
+#if SHEAPERD_SHEAP_DEFER_OVERWRITE_ON_FREE == 1
+	resetOverwriteProgress(sheap, next);
+#endif
+	uint32_t absorbed = next->size + BLOCK_META_SIZE;
+#if SHEAPERD_SHEAP_COMPACT_HEADER == 1
+	// the boundary of the merged block is written by the caller if it is free
+	clearBlockBoundary(next);
+#endif
+	clearBlockHeader(next);
+	clearBlockBoundary(block);
+#if SHEAPERD_SHEAP_MEMORY_ALLOCATION_STRATEGY == SHEAPERD_SHEAP_MEMORY_ALLOCATION_NEXT_FIT
+	if(sheap->roverBlock == next){
+		sheap->roverBlock = block;
+	}
+#endif
+	if(sheap->scrubCursor == next){
+		sheap->scrubCursor = block;
+	}
+	// the caller updates the size, the header and the boundary of block
+	return absorbed;
+}
+
+void releaseBlockTail(sheap_t* sheap, memory_blockInfo_t* block, size_t sizeAligned){
+	// the payload of block after sizeAligned is overwritten already
+	size_t tailSize = block->size - GET_BLOCK_OVERHEAD_SIZE(sizeAligned);
+	block->size = sizeAligned;
+	updateCRC(block);
+	updateBlockBoundary(block);
+	memory_blockInfo_t* tail = GET_NEXT_MEMORY_BLOCK(block);
+#if SHEAPERD_SHEAP_USE_EXTENDED_HEADER == 1
+	updateBlockHeader(tail, tailSize, 0, false, SHEAPERD_SHEAP_AUTO_CREATED_BLOCK_ID);
+#elif SHEAPERD_SHEAP_USE_EXTENDED_HEADER == 0
+	updateBlockHeader(tail, tailSize, 0, false);
+#endif
+	updateBlockBoundary(tail);
+	tail = coalesce(sheap, &tail);
+	updateCRC(tail);
+	updateBlockBoundary(tail);
+	insertFreeBlock(sheap, tail);
+#if SHEAPERD_SHEAP_COMPACT_HEADER == 1
+	updatePrevFreeOfNextBlock(sheap, tail);
+#endif
+}
+
+sheap_status_t sheap_scrub_step_instance(sheap_t* sheap, uint32_t maxBlocks){
+	if(sheap->heap.heapMin == NULL){
+		return SHEAP_ERROR;
+	}
+	// the deferred overwrite only changes free payloads, a running walk stays valid
+	memory_lock_t lock = sheap_lock(sheap, MEMORY_BUSY_ALLOC | MEMORY_BUSY_FREE | MEMORY_BUSY_READ_ONLY);
+	if(lock != MEMORY_LOCK_ACQUIRED){
+		return lock == MEMORY_LOCK_BUSY ? SHEAP_BUSY : SHEAP_ERROR;
+	}
+	sheap_status_t status = SHEAP_OK;
+	for(uint32_t i = 0; i < maxBlocks; i++){
+		memory_blockInfo_t* block = sheap->scrubCursor;
+		if(!isBlockInHeapAndValid(sheap, block)){
+			SHEAPERD_ASSERT("MEMORY ERROR: Scrub found invalid block. It may have been altered.", false, SHEAP_ERROR_INVALID_BLOCK);
+			// the following blocks cannot be found from an invalid block
+			sheap->scrubCursor = sheap->startBlock;
+			status = SHEAP_ERROR;
+			break;
+		}
+#if SHEAPERD_SHEAP_DEFER_OVERWRITE_ON_FREE == 1
+		if(!block->isAllocated && !IS_FREE_BLOCK_OVERWRITTEN(block) && !overwriteFreeBlock(sheap, block)){
+			// the cursor stays at a large block until it is overwritten completely, each chunk counts as one block
+			continue;
+		}
+#endif
+		block = GET_NEXT_MEMORY_BLOCK(block);
+		if(((uint8_t*)block) >= sheap->heap.heapMax){
+			block = sheap->startBlock;
+			sheap->scrubPasses++;
+		}
+		sheap->scrubCursor = block;
+	}
+	sheap_unlock(sheap, MEMORY_BUSY_ALLOC | MEMORY_BUSY_FREE | MEMORY_BUSY_READ_ONLY);
+	return status;
+}
+
+uint32_t sheap_scrub_getCompletedPasses_instance(sheap_t* sheap){
+	return sheap->scrubPasses;
+}
+
+void sheap_walk_begin_instance(sheap_t* sheap, sheap_walk_t* walk){
+	walk->sheap = sheap;
+	walk->next = sheap->startBlock;
+	walk->generation = sheap->generation;
+	walk->restarts = 0;
+}
+
+sheap_status_t sheap_walk_next(sheap_walk_t* walk, sheap_blockInfo_t info[], uint32_t maxBlocks, uint32_t* count){
+	sheap_t* sheap = walk->sheap;
+	*count = 0;
+	if(sheap == NULL || sheap->heap.heapMin == NULL){
+		return SHEAP_ERROR;
+	}
+	if(walk->next == NULL){
+		return SHEAP_OK;
+	}
+	memory_lock_t lock = sheap_lock(sheap, MEMORY_BUSY_ALLOC | MEMORY_BUSY_FREE | MEMORY_BUSY_READ_ONLY);
+	if(lock != MEMORY_LOCK_ACQUIRED){
+		return lock == MEMORY_LOCK_BUSY ? SHEAP_BUSY : SHEAP_ERROR;
+	}
+	sheap_status_t status = SHEAP_OK;
+	if(walk->generation != sheap->generation){
+		// the saved block may have been merged, the blocks before it may have changed
+		walk->generation = sheap->generation;
+		walk->next = sheap->startBlock;
+		walk->restarts++;
+		status = SHEAP_WALK_RESTARTED;
+	}
+	memory_blockInfo_t* block = walk->next;
+	while(block != NULL && *count < maxBlocks){
+		sheap_blockInfo_t* record = &info[(*count)++];
+		bool isBlockValid = isBlockInHeapAndValid(sheap, block);
+		if(!isBlockValid && (!isBlockHeaderCRCValid(block) || ((uint8_t*)block) + GET_BLOCK_OVERHEAD_SIZE(block->size) > sheap->heap.heapMax)){
+			// the following blocks cannot be found from an invalid header
+			record->address = block + 1;
+			record->size = 0;
+			record->requestedSize = 0;
+			record->id = 0;
+			record->isAllocated = false;
+			record->isValid = false;
+			block = NULL;
+			status = SHEAP_ERROR;
+			break;
+		}
+		record->address = block + 1;
+		record->size = block->size;
+		record->requestedSize = block->isAllocated ? block->size - block->alignmentOffset : 0;
+#if SHEAPERD_SHEAP_USE_EXTENDED_HEADER == 1
+		record->id = block->isAllocated ? block->id : 0;
+#else
+		record->id = 0;
+#endif
+		record->isAllocated = block->isAllocated;
+		record->isValid = isBlockValid;
+		if(!isBlockValid){
+			status = SHEAP_ERROR;
+		}
+		block = GET_NEXT_MEMORY_BLOCK(block);
+		if(((uint8_t*)block) >= sheap->heap.heapMax){
+			block = NULL;
+		}
+	}
+	walk->next = block;
+	sheap_unlock(sheap, MEMORY_BUSY_ALLOC | MEMORY_BUSY_FREE | MEMORY_BUSY_READ_ONLY);
+	return status;
+}
+
+bool sheap_walk_isComplete(const sheap_walk_t* walk){
+	return walk->next == NULL;
+}
+
+void sheap_snapshot_begin_instance(sheap_t* sheap, sheap_snapshot_t* snapshot, sheap_snapshotSink_cb sink){
+	sheap_walk_begin_instance(sheap, &snapshot->walk);
+	snapshot->sink = sink;
+	snapshot->blocks = 0;
+	snapshot->isHeaderWritten = false;
+	snapshot->isComplete = false;
+}
+
+sheap_status_t sheap_snapshot_step(sheap_snapshot_t* snapshot, uint32_t maxBlocks){
+	sheap_walk_t* walk = &snapshot->walk;
+	sheap_blockInfo_t info[SNAPSHOT_STEP_BLOCKS];
+	sheap_status_t status = SHEAP_OK;
+	while(!snapshot->isComplete && maxBlocks > 0){
+		uint32_t count;
+		sheap_status_t walkStatus = sheap_walk_next(walk, info, maxBlocks < SNAPSHOT_STEP_BLOCKS ? maxBlocks : SNAPSHOT_STEP_BLOCKS, &count);
+		if(walkStatus == SHEAP_BUSY || (walkStatus == SHEAP_ERROR && count == 0)){
+			return walkStatus;
+		}
+		// the sink is called without the lock
+		if(!snapshot->isHeaderWritten || walk->restarts != snapshot->restarts){
+			// a new begin record discards the block records written before
+			uint32_t header[6] = {
+				SNAPSHOT_MAGIC,
+				(SNAPSHOT_VERSION << 16) | BLOCK_META_SIZE,
+				sizeof(memory_blockInfo_t),
+				(uint32_t)(uintptr_t) walk->sheap->startBlock,
+				(uint32_t)(walk->sheap->heap.heapMax - (uint8_t*)walk->sheap->startBlock),
+				walk->generation
+			};
+			snapshot->sink(header, 6);
+			snapshot->isHeaderWritten = true;
+			snapshot->restarts = walk->restarts;
+			snapshot->blocks = 0;
+		}
+		for(uint32_t i = 0; i < count; i++){
+			uint32_t record[2] = {
+				info[i].size | (info[i].isAllocated ? SNAPSHOT_ALLOCATED_FLAG : 0) | (info[i].isValid ? 0 : SNAPSHOT_INVALID_FLAG),
+				info[i].id
+			};
+			snapshot->sink(record, 2);
+		}
+		snapshot->blocks += count;
+		maxBlocks -= count;
+		if(walkStatus == SHEAP_ERROR){
+			status = SHEAP_ERROR;
+		}
+		if(sheap_walk_isComplete(walk)){
+			uint32_t end[2] = {0, snapshot->blocks};
+			snapshot->sink(end, 2);
+			snapshot->isComplete = true;
+		}
+	}
+	return status;
+}
+
+bool sheap_snapshot_isComplete(const sheap_snapshot_t* snapshot){
+	return snapshot->isComplete;
+}
+
+bool isBlockInHeapAndValid(sheap_t* sheap, memory_blockInfo_t* block){
+	// the size is only used to find the boundary if the header is valid and the block does not exceed the heap
+	if(!isBlockHeaderCRCValid(block) || ((uint8_t*)block) + GET_BLOCK_OVERHEAD_SIZE(block->size) > sheap->heap.heapMax){
+		return false;
+	}
+	return isBlockValid(block);
+}
+
+#if SHEAPERD_SHEAP_CHECK_ALL_BLOCKS_ON_MALLOC == 1 || SHEAPERD_SHEAP_CHECK_ALL_BLOCKS_ON_FREE == 1
+bool checkAllBlocks(sheap_t* sheap){
+	memory_blockInfo_t* block = sheap->startBlock;
+	while(((uint8_t*)block) < sheap->heap.heapMax){
+		if(!isBlockInHeapAndValid(sheap, block)){
+			SHEAPERD_ASSERT("MEMORY ERROR: Found invalid block. It may have been altered.", false, SHEAP_ERROR_INVALID_BLOCK);
+			return false;
+		}
+		block = GET_NEXT_MEMORY_BLOCK(block);
+	}
+	return true;
+}
+#endif
+
+#if SHEAPERD_SHEAP_DEFER_OVERWRITE_ON_FREE == 1
+bool overwriteFreeBlock(sheap_t* sheap, memory_blockInfo_t* block){
+#if SHEAPERD_SHEAP_MEMORY_ALLOCATION_STRATEGY == SHEAPERD_SHEAP_MEMORY_ALLOCATION_TLSF
+	// the free list links must be kept
+	uint8_t* start = ((uint8_t*)(block + 1)) + sizeof(memory_freeLink_t);
+#else
+	uint8_t* start = (uint8_t*)(block + 1);
+#endif
+	// the boundary tag is written again below (within the payload with SHEAPERD_SHEAP_COMPACT_HEADER)
+	uint8_t* end = (uint8_t*)GET_BOUNDARY_TAG(block);
+#if SHEAPERD_SHEAP_SCRUB_OVERWRITE_CHUNK > 0
+	// the block is overwritten from its end, an allocation from the block keeps the end of the remaining block
+	if(sheap->overwriteBlockEnd != end){
+		sheap->overwriteBlockEnd = end;
+		sheap->overwriteFrom = end;
+	}
+	if(sheap->overwriteFrom > start + SHEAPERD_SHEAP_SCRUB_OVERWRITE_CHUNK){
+		sheap->overwriteFrom -= SHEAPERD_SHEAP_SCRUB_OVERWRITE_CHUNK;
+		clearMemory(sheap->overwriteFrom, SHEAPERD_SHEAP_SCRUB_OVERWRITE_CHUNK);
+		return false;
+	}
+	if(sheap->overwriteFrom > start){
+		clearMemory(start, sheap->overwriteFrom - start);
+	}
+	sheap->overwriteBlockEnd = NULL;
+#else
+	clearMemory(start, end - start);
+#endif
+	block->alignmentOffset = 0;
+	updateCRC(block);
+	updateBlockBoundary(block);
+	return true;
+}
+
+void resetOverwriteProgress(sheap_t* sheap, memory_blockInfo_t* block){
+#if SHEAPERD_SHEAP_SCRUB_OVERWRITE_CHUNK > 0
+	// the payload of the block is used, a later free block with the same end has to be overwritten completely
+	if(sheap->overwriteBlockEnd == (uint8_t*)GET_BOUNDARY_TAG(block)){
+		sheap->overwriteBlockEnd = NULL;
+	}
+#endif
+}
+#endif
+
 bool checkForIllegalWrite(memory_blockInfo_t* block){
 	size_t requestedSize = block->size - block->alignmentOffset;
 	uint8_t* pAfterPayload = ((uint8_t*)(block + 1)) + requestedSize;
-	for(int i = 0; i < block->alignmentOffset; i++){
+	for(memory_offset_t i = 0; i < block->alignmentOffset; i++){
 		if(pAfterPayload[i] != SHEAPERD_SHEAP_OVERWRITE_VALUE){
 			return true;
 		}
@@ -472,28 +1847,74 @@ void clearBlockHeader(memory_blockInfo_t* block){
 }
 
 void clearBlockBoundary(memory_blockInfo_t* block){
+#if SHEAPERD_SHEAP_COMPACT_HEADER == 1
+	// the boundary position of an allocated block is user data
+	if(block->isAllocated){
+		return;
+	}
+#endif
 	memory_blockInfo_t* boundary = GET_BOUNDARY_TAG(block);
 	clearMemory((uint8_t*) boundary, sizeof(memory_blockInfo_t));
 }
 
-bool isPreviousBlockFree(memory_blockInfo_t* block){
+bool isPreviousBlockFree(sheap_t* sheap, memory_blockInfo_t* block){
+#if SHEAPERD_SHEAP_COMPACT_HEADER == 1
+	return block != sheap->startBlock && block->isPrevFree;
+#else
 	memory_blockInfo_t* prevBoundary = block - 1;
-	return ((uint8_t*) prevBoundary) >= gHeap.heapMin && !prevBoundary->isAllocated;
+	return ((uint8_t*) prevBoundary) >= sheap->heap.heapMin && !prevBoundary->isAllocated;
+#endif
 }
 
-bool isNextBlockFree(memory_blockInfo_t* block){
+memory_blockInfo_t* getPreviousFreeBlock(sheap_t* sheap, memory_blockInfo_t* block){
+	// the size of the previous block is read from its boundary tag (user data if the block is allocated with
+	// SHEAPERD_SHEAP_COMPACT_HEADER), it is only used if the tag is valid and the previous block starts within the heap
+	memory_blockInfo_t* prevBoundary = block - 1;
+	if(((uint8_t*)prevBoundary) < ((uint8_t*)sheap->startBlock) + sizeof(memory_blockInfo_t) || !isBlockHeaderCRCValid(prevBoundary)
+			|| prevBoundary->isAllocated || GET_BLOCK_OVERHEAD_SIZE(prevBoundary->size) > (size_t)((uint8_t*)block - (uint8_t*)sheap->startBlock)){
+		return NULL;
+	}
+	memory_blockInfo_t* prev = GET_PREV_MEMORY_BLOCK(block);
+	return !prev->isAllocated && isBlockValid(prev) ? prev : NULL;
+}
+
+bool isNextBlockFree(sheap_t* sheap, memory_blockInfo_t* block){
 	memory_blockInfo_t* next = GET_NEXT_MEMORY_BLOCK(block);
-	return ((uint8_t*) next) < (gHeap.heapMax - GET_BLOCK_OVERHEAD_SIZE(SHEAPERD_SHEAP_MINIMUM_MALLOC_SIZE)) && !next->isAllocated;
+	return ((uint8_t*) next) < (sheap->heap.heapMax - GET_BLOCK_OVERHEAD_SIZE(SHEAPERD_SHEAP_MINIMUM_MALLOC_SIZE)) && !next->isAllocated;
+}
+
+memory_checkWord_t calculateCRC(const memory_blockInfo_t* block){
+#if SHEAPERD_SHEAP_INTEGRITY_LEVEL == SHEAPERD_SHEAP_INTEGRITY_NONE
+	(void)block;
+	return 0;
+#else
+#if SHEAPERD_SHEAP_INTEGRITY_LEVEL == SHEAPERD_SHEAP_INTEGRITY_CANARY
+	// xor of the half words before the check word (the header size is a multiple of 4)
+	const uint8_t* data = (const uint8_t*)block;
+	uint16_t canary = SHEAPERD_SHEAP_CANARY_VALUE;
+	for(uint32_t i = 0; i < sizeof(memory_blockInfo_t) - sizeof(memory_checkWord_t); i += 2){
+		canary ^= (uint16_t)(data[i] | (data[i + 1] << 8));
+	}
+	return canary;
+#elif SHEAPERD_SHEAP_INTEGRITY_LEVEL == SHEAPERD_SHEAP_INTEGRITY_CRC16
+	return util_crc16_calculate((const uint8_t*)block, sizeof(memory_blockInfo_t) - sizeof(memory_checkWord_t));
+#elif SHEAPERD_SHEAP_INTEGRITY_LEVEL == SHEAPERD_SHEAP_INTEGRITY_CRC32
+	return util_crc32_sw_calculate((const uint8_t*)block, sizeof(memory_blockInfo_t) - sizeof(memory_checkWord_t));
+#endif
+#endif
 }
 
 void updateCRC(memory_blockInfo_t* block){
-	const uint8_t* crcData = (const uint8_t*)block;
-	block->crc = util_crc16_sw_calculate(crcData, sizeof(memory_blockInfo_t) - sizeof(uint16_t));
+	block->crc = calculateCRC(block);
 }
 
 #if SHEAPERD_SHEAP_USE_EXTENDED_HEADER == 1
 void updateBlockHeader(memory_blockInfo_t* block, size_t sizeAligned, size_t sizeRequested, bool isAllocated, uint32_t id){
 	block->isAllocated = isAllocated;
+#if SHEAPERD_SHEAP_COMPACT_HEADER == 1
+	// only used for new free blocks, the previous block of a free block is always allocated
+	block->isPrevFree = false;
+#endif
 	block->size = sizeAligned;
 	block->id = id;
 	block->alignmentOffset = sizeRequested == 0 ? 0 : sizeAligned - sizeRequested;
@@ -502,6 +1923,9 @@ void updateBlockHeader(memory_blockInfo_t* block, size_t sizeAligned, size_t siz
 #elif SHEAPERD_SHEAP_USE_EXTENDED_HEADER == 0
 void updateBlockHeader(memory_blockInfo_t* block, size_t sizeAligned, size_t sizeRequested, bool isAllocated){
 	block->isAllocated = isAllocated;
+#if SHEAPERD_SHEAP_COMPACT_HEADER == 1
+	block->isPrevFree = false;
+#endif
 	block->size = sizeAligned;
 	block->alignmentOffset = sizeRequested == 0 ? 0 : sizeAligned - sizeRequested;
 	updateCRC(block);
@@ -510,8 +1934,16 @@ void updateBlockHeader(memory_blockInfo_t* block, size_t sizeAligned, size_t siz
 
 
 void updateBlockBoundary(memory_blockInfo_t* block){
+#if SHEAPERD_SHEAP_COMPACT_HEADER == 1
+	if(block->isAllocated){
+		return;
+	}
+#endif
 	memory_blockInfo_t* boundary = GET_BOUNDARY_TAG(block);
 	boundary->isAllocated = block->isAllocated;
+#if SHEAPERD_SHEAP_COMPACT_HEADER == 1
+	boundary->isPrevFree = block->isPrevFree;
+#endif
 	boundary->size = block->size;
 #if SHEAPERD_SHEAP_USE_EXTENDED_HEADER == 1
 	boundary->id = block->id;
@@ -520,62 +1952,291 @@ void updateBlockBoundary(memory_blockInfo_t* block){
 	boundary->crc = block->crc;
 }
 
+#if SHEAPERD_SHEAP_COMPACT_HEADER == 1
+void updatePrevFreeOfNextBlock(sheap_t* sheap, memory_blockInfo_t* block){
+	memory_blockInfo_t* next = GET_NEXT_MEMORY_BLOCK(block);
+	// the CRC of an altered header is not recalculated, the next block is reported when it is checked
+	if(((uint8_t*)next) < sheap->heap.heapMax && next->isPrevFree != !block->isAllocated && isBlockHeaderCRCValid(next)){
+		next->isPrevFree = !block->isAllocated;
+		updateCRC(next);
+		updateBlockBoundary(next);
+	}
+}
+#endif
+
 bool isBlockValid(memory_blockInfo_t* block){
 	return isBlockCRCValid(block);
 }
 
+#if SHEAPERD_SHEAP_INTEGRITY_LEVEL == SHEAPERD_SHEAP_INTEGRITY_NONE
+bool isBlockCRCValid(memory_blockInfo_t* block){
+	(void)block;
+	return true;
+}
+
+bool isBlockHeaderCRCValid(memory_blockInfo_t* block){
+	(void)block;
+	return true;
+}
+
+bool isBlockBoundaryCRCValid(memory_blockInfo_t* block){
+	(void)block;
+	return true;
+}
+#else
 bool isBlockCRCValid(memory_blockInfo_t* block){
+#if SHEAPERD_SHEAP_COMPACT_HEADER == 1
+	if(block->isAllocated){
+		return isBlockHeaderCRCValid(block);
+	}
+#endif
 	memory_blockInfo_t* boundary = GET_BOUNDARY_TAG(block);
-	const uint8_t* crcData = (const uint8_t*)block;
-	uint16_t headerCrc = util_crc16_sw_calculate(crcData, sizeof(memory_blockInfo_t) - sizeof(uint16_t));
-	crcData = (const uint8_t*)boundary;
-	uint16_t boundaryCrc = util_crc16_sw_calculate(crcData, sizeof(memory_blockInfo_t) - sizeof(uint16_t));
+	memory_checkWord_t headerCrc = calculateCRC(block);
+	memory_checkWord_t boundaryCrc = calculateCRC(boundary);
 	return (block->crc == headerCrc) && (boundary->crc == boundaryCrc) && (headerCrc == boundaryCrc);
 }
 
 bool isBlockHeaderCRCValid(memory_blockInfo_t* block){
-	const uint8_t* crcData = (const uint8_t*)block;
-	uint16_t crc = util_crc16_sw_calculate(crcData, sizeof(memory_blockInfo_t) - sizeof(uint16_t));
-	return block->crc == crc;
+	return block->crc == calculateCRC(block);
 }
 
 bool isBlockBoundaryCRCValid(memory_blockInfo_t* block){
+#if SHEAPERD_SHEAP_COMPACT_HEADER == 1
+	// allocated blocks have no boundary tag
+	if(block->isAllocated){
+		return true;
+	}
+#endif
 	memory_blockInfo_t* boundary = GET_BOUNDARY_TAG(block);
-	const uint8_t* crcData = (const uint8_t*)boundary;
-	uint16_t crc = util_crc16_sw_calculate(crcData, sizeof(memory_blockInfo_t) - sizeof(uint16_t));
-	return block->crc == crc;
+	return block->crc == calculateCRC(boundary);
 }
+#endif
 
-void clearMemory(uint8_t* ptr, size_t size){
-	for(int i = 0; i < size; i++){
-		ptr[i] = SHEAPERD_SHEAP_OVERWRITE_VALUE;
+void initFreeLists(sheap_t* sheap){
+#if SHEAPERD_SHEAP_MEMORY_ALLOCATION_STRATEGY == SHEAPERD_SHEAP_MEMORY_ALLOCATION_TLSF
+	sheap->flBitmap = 0;
+	for(int32_t fl = 0; fl < TLSF_FL_INDEX_COUNT; fl++){
+		sheap->slBitmap[fl] = 0;
+		for(int32_t sl = 0; sl < TLSF_SL_INDEX_COUNT; sl++){
+			sheap->freeBins[fl][sl] = FREE_LIST_NULL;
+		}
 	}
+#else
+	(void)sheap;
+#endif
+}
+
+void insertFreeBlock(sheap_t* sheap, memory_blockInfo_t* block){
+	sheap->heap.freeBlocks++;
+#if SHEAPERD_SHEAP_MEMORY_ALLOCATION_STRATEGY != SHEAPERD_SHEAP_MEMORY_ALLOCATION_TLSF
+	if(sheap->largestFreeBlockStale){
+		// all free blocks are not larger than the bound, a larger block is the only largest one
+		if(block->size > sheap->otherFreeBlocksBound){
+			sheap->heap.largestFreeBlock = block->size;
+			sheap->largestFreeBlockCount = 1;
+			sheap->largestFreeBlockStale = false;
+		}
+	}else if(block->size > sheap->heap.largestFreeBlock){
+		sheap->otherFreeBlocksBound = sheap->heap.largestFreeBlock;
+		sheap->heap.largestFreeBlock = block->size;
+		sheap->largestFreeBlockCount = 1;
+	}else if(block->size == sheap->heap.largestFreeBlock){
+		sheap->largestFreeBlockCount++;
+	}else if(block->size > sheap->otherFreeBlocksBound){
+		sheap->otherFreeBlocksBound = block->size;
+	}
+#endif
+#if SHEAPERD_SHEAP_MEMORY_ALLOCATION_STRATEGY == SHEAPERD_SHEAP_MEMORY_ALLOCATION_TLSF
+	int32_t fl, sl;
+	mappingInsert(block->size, &fl, &sl);
+	uint32_t offset = (uint32_t)(((uint8_t*)block) - sheap->heap.heapMin);
+	uint32_t head = sheap->freeBins[fl][sl];
+	memory_freeLink_t* link = GET_FREE_LINK(block);
+	link->next = head;
+	link->prev = FREE_LIST_NULL;
+	if(head != FREE_LIST_NULL){
+		GET_FREE_LINK((memory_blockInfo_t*)(sheap->heap.heapMin + head))->prev = offset;
+	}
+	sheap->freeBins[fl][sl] = offset;
+	sheap->flBitmap |= (1ul << fl);
+	sheap->slBitmap[fl] |= (1ul << sl);
+#endif
 }
 
-void updateHeapStatistics(memory_operation_t op, uint32_t allocations, uint32_t sizeAligned, uint32_t size, uint32_t blockSize){
+bool removeFreeBlock(sheap_t* sheap, memory_blockInfo_t* block){
+#if SHEAPERD_SHEAP_MEMORY_ALLOCATION_STRATEGY == SHEAPERD_SHEAP_MEMORY_ALLOCATION_TLSF
+	int32_t fl, sl;
+	mappingInsert(block->size, &fl, &sl);
+	memory_freeLink_t* link = GET_FREE_LINK(block);
+	if(!isFreeLinkValid(sheap, link->next) || !isFreeLinkValid(sheap, link->prev)){
+		// the block stays in its bin and must not be used
+		SHEAPERD_ASSERT("MEMORY ERROR: Free list link of a free block is not valid. It may have been altered.", false, SHEAP_ERROR_INVALID_BLOCK);
+		return false;
+	}
+	if(link->next != FREE_LIST_NULL){
+		GET_FREE_LINK((memory_blockInfo_t*)(sheap->heap.heapMin + link->next))->prev = link->prev;
+	}
+	if(link->prev != FREE_LIST_NULL){
+		GET_FREE_LINK((memory_blockInfo_t*)(sheap->heap.heapMin + link->prev))->next = link->next;
+	}else{
+		sheap->freeBins[fl][sl] = link->next;
+		if(link->next == FREE_LIST_NULL){
+			sheap->slBitmap[fl] &= ~(1ul << sl);
+			if(sheap->slBitmap[fl] == 0){
+				sheap->flBitmap &= ~(1ul << fl);
+			}
+		}
+	}
+	// the links are not part of the payload of an allocated block, restore the overwrite pattern for the illegal write check
+	clearMemory((uint8_t*)link, sizeof(memory_freeLink_t));
+#endif
+	sheap->heap.freeBlocks--;
+#if SHEAPERD_SHEAP_MEMORY_ALLOCATION_STRATEGY != SHEAPERD_SHEAP_MEMORY_ALLOCATION_TLSF
+	if(!sheap->largestFreeBlockStale && block->size == sheap->heap.largestFreeBlock){
+		sheap->largestFreeBlockCount--;
+		if(sheap->largestFreeBlockCount == 0){
+			// the remainder of a split or a merged block inserted next may be larger than the bound again
+			sheap->largestFreeBlockStale = true;
+		}
+	}
+#endif
+	return true;
+}
+
+uint32_t getLargestFreeBlock(sheap_t* sheap){
+#if SHEAPERD_SHEAP_MEMORY_ALLOCATION_STRATEGY == SHEAPERD_SHEAP_MEMORY_ALLOCATION_TLSF
+	// the largest free block is within the highest bin, the blocks of one bin are not sorted by size
+	uint32_t largest = 0;
+	if(sheap->flBitmap != 0){
+		int32_t fl = util_fls(sheap->flBitmap);
+		int32_t sl = util_fls(sheap->slBitmap[fl]);
+		uint32_t offset = sheap->freeBins[fl][sl];
+		while(offset != FREE_LIST_NULL && isFreeLinkValid(sheap, offset)){
+			memory_blockInfo_t* block = (memory_blockInfo_t*)(sheap->heap.heapMin + offset);
+			if(block->size > largest){
+				largest = block->size;
+			}
+			offset = GET_FREE_LINK(block)->next;
+		}
+	}
+	return largest;
+#else
+	if(sheap->largestFreeBlockStale){
+		// only walks the heap if the largest free block cannot be known from the blocks inserted since it was removed
+		uint32_t largest = 0;
+		uint32_t count = 0;
+		uint32_t bound = 0;
+		memory_blockInfo_t* current = sheap->startBlock;
+		while(((uint8_t*)current) < sheap->heap.heapMax){
+			if(!current->isAllocated){
+				if(current->size > largest){
+					bound = largest;
+					largest = current->size;
+					count = 1;
+				}else if(current->size == largest){
+					count++;
+				}else if(current->size > bound){
+					bound = current->size;
+				}
+			}
+			current = GET_NEXT_MEMORY_BLOCK(current);
+		}
+		sheap->heap.largestFreeBlock = largest;
+		sheap->largestFreeBlockCount = count;
+		sheap->otherFreeBlocksBound = bound;
+		sheap->largestFreeBlockStale = false;
+	}
+	return sheap->heap.largestFreeBlock;
+#endif
+}
+
+#if SHEAPERD_SHEAP_MEMORY_ALLOCATION_STRATEGY == SHEAPERD_SHEAP_MEMORY_ALLOCATION_TLSF
+void mappingInsert(size_t size, int32_t* fl, int32_t* sl){
+	if(size < TLSF_SMALL_BLOCK_SIZE){
+		*fl = 0;
+		*sl = (int32_t)size / (TLSF_SMALL_BLOCK_SIZE / TLSF_SL_INDEX_COUNT);
+	}else{
+		int32_t bit = util_fls((uint32_t)size);
+		*sl = (int32_t)(size >> (bit - SHEAPERD_SHEAP_TLSF_SL_INDEX_COUNT_LOG2)) ^ TLSF_SL_INDEX_COUNT;
+		*fl = bit - (TLSF_FL_INDEX_SHIFT - 1);
+	}
+}
+
+void mappingSearch(size_t size, int32_t* fl, int32_t* sl){
+	if(size >= TLSF_SMALL_BLOCK_SIZE){
+		// round up to the next size class so that every block of the resulting class is big enough
+		size += (1ul << (util_fls((uint32_t)size) - SHEAPERD_SHEAP_TLSF_SL_INDEX_COUNT_LOG2)) - 1;
+	}
+	mappingInsert(size, fl, sl);
+}
+
+memory_blockInfo_t* searchSuitableBlock(sheap_t* sheap, int32_t* fl, int32_t* sl){
+	if(*fl >= TLSF_FL_INDEX_COUNT){
+		return NULL;
+	}
+	uint32_t slMap = sheap->slBitmap[*fl] & (~0ul << *sl);
+	if(slMap == 0){
+		uint32_t flMap = (*fl + 1) < 32 ? sheap->flBitmap & (~0ul << (*fl + 1)) : 0;
+		if(flMap == 0){
+			return NULL;
+		}
+		*fl = util_ffs(flMap);
+		slMap = sheap->slBitmap[*fl];
+	}
+	*sl = util_ffs(slMap);
+	return (memory_blockInfo_t*)(sheap->heap.heapMin + sheap->freeBins[*fl][*sl]);
+}
+
+bool isFreeLinkValid(sheap_t* sheap, uint32_t link){
+	return link == FREE_LIST_NULL || (link <= sheap->heap.size - GET_BLOCK_OVERHEAD_SIZE(MINIMUM_BLOCK_PAYLOAD_SIZE) && (link & 0x3) == 0);
+}
+#endif
+
+void clearMemory(uint8_t* ptr, size_t size){
+	util_fillMemory(ptr, SHEAPERD_SHEAP_OVERWRITE_VALUE, size);
+}
+
+void updateHeapStatistics(sheap_t* sheap, memory_operation_t op, uint32_t allocations, uint32_t sizeAligned, uint32_t size, uint32_t blockSize){
 	switch(op){
-		case MEMORY_OP_ALLOC:
-			gHeap.currentAllocations += allocations;
-			gHeap.userDataAllocatedAlligned += sizeAligned;
-			gHeap.userDataAllocated += size;
-			gHeap.totalBytesAllocated += blockSize;
+		case MEMORY_OP_ALLOC:{
+			sheap->heap.currentAllocations += allocations;
+			sheap->heap.userDataAllocatedAlligned += sizeAligned;
+			sheap->heap.userDataAllocated += size;
+			sheap->heap.totalBytesAllocated += blockSize;
+			if(sheap->heap.totalBytesAllocated > sheap->heap.peakTotalBytesAllocated){
+				sheap->heap.peakTotalBytesAllocated = sheap->heap.totalBytesAllocated;
+			}
+			if(sheap->heap.currentAllocations > sheap->heap.peakAllocations){
+				sheap->heap.peakAllocations = sheap->heap.currentAllocations;
+			}
+			int32_t sizeClass = util_fls(size / SHEAPERD_SHEAP_MINIMUM_MALLOC_SIZE);
+			if(sizeClass < 0){
+				sizeClass = 0;
+			} else if(sizeClass >= SHEAPERD_SHEAP_STAT_SIZE_CLASSES){
+				sizeClass = SHEAPERD_SHEAP_STAT_SIZE_CLASSES - 1;
+			}
+			sheap->heap.allocationsPerSizeClass[sizeClass] += allocations;
 			break;
+		}
 		case MEMORY_OP_FREE:
-			gHeap.currentAllocations -= allocations;
-			gHeap.userDataAllocatedAlligned -= sizeAligned;
-			gHeap.userDataAllocated -= size;
-			gHeap.totalBytesAllocated -= blockSize;
+			sheap->heap.currentAllocations -= allocations;
+			sheap->heap.userDataAllocatedAlligned -= sizeAligned;
+			sheap->heap.userDataAllocated -= size;
+			sheap->heap.totalBytesAllocated -= blockSize;
 			break;
 	}
 }
 
-void sheap_initMutex(){
+void sheap_initMutex(sheap_t* sheap){
 #if SHEAPERD_SHEAP_DISABLE_IRQS == 1 || SHEAPERD_NO_OS == 1
+	(void)sheap;
     util_error_t error = ERROR_NO_ERROR;
+#elif SHEAPERD_USE_LOCK_PORT == 1
+	util_error_t error = sheaperd_port_lockInit(&sheap->lock, "sheap_mutex") ? ERROR_NO_ERROR : ERROR_MUTEX_CREATION_FAILED;
 #elif SHEAPERD_CMSIS_1 == 1
-	util_error_t error = util_initMutex(osMutex(sheap_mutex), &gMemMutex_id);
+	util_error_t error = util_initInstanceMutex(&sheap->mutexDef, &sheap->mutexId);
 #elif SHEAPERD_CMSIS_2 == 1
-	util_error_t error = util_initMutex(&gMemMutex_id, &memMutex_attr);
+	util_error_t error = util_initMutex(&sheap->mutexId, &memMutex_attr);
 #endif
 	if(error == ERROR_MUTEX_DELETION_FAILED){
 		SHEAPERD_ASSERT("Mutex deletion failed.", false, SHEAPERD_ERROR_MUTEX_DELETION_FAILED);
@@ -584,11 +2245,16 @@ void sheap_initMutex(){
 	}
 }
 
-bool sheap_acquireMutex(){
+bool sheap_acquireMutex(sheap_t* sheap){
 	#if SHEAPERD_NO_OS == 1 || SHEAPERD_SHEAP_DISABLE_IRQS == 1
+		(void)sheap;
 		return true;
+	#elif SHEAPERD_USE_LOCK_PORT == 1
+	bool acquired = sheaperd_port_lockAcquire(&sheap->lock, SHEAPERD_DEFAULT_MUTEX_WAIT_TICKS);
+	SHEAPERD_ASSERT("Could not acquire mutex.", acquired, SHEAPERD_ERROR_MUTEX_ACQUIRE_FAILED);
+	return acquired;
 	#else
-	util_error_t error = util_acquireMutex(gMemMutex_id, SHEAPERD_DEFAULT_MUTEX_WAIT_TICKS);
+	util_error_t error = util_acquireMutex(sheap->mutexId, SHEAPERD_DEFAULT_MUTEX_WAIT_TICKS);
 	switch (error){
 		case ERROR_MUTEX_IS_NULL:
 			SHEAPERD_ASSERT("No mutex available. Consider undefining 'SHEAPERD_CMSIS_2' if no mutex is needed.", false, SHEAPERD_ERROR_MUTEX_IS_NULL);
@@ -602,11 +2268,15 @@ bool sheap_acquireMutex(){
 	#endif
 }
 
-bool sheap_releaseMutex(){
+bool sheap_releaseMutex(sheap_t* sheap){
 	#if SHEAPERD_NO_OS == 1 || SHEAPERD_SHEAP_DISABLE_IRQS == 1
+		(void)sheap;
 		return true;
+	#elif SHEAPERD_USE_LOCK_PORT == 1
+	sheaperd_port_lockRelease(&sheap->lock);
+	return true;
 	#else
-	util_error_t error = util_releaseMutex(gMemMutex_id);
+	util_error_t error = util_releaseMutex(sheap->mutexId);
 	switch(error){
 		case ERROR_MUTEX_IS_NULL:
 			SHEAPERD_ASSERT("No mutex available. Consider removing the 'SHEAPERD_CMSIS_2' define if no mutex is needed.", false, SHEAPERD_ERROR_MUTEX_IS_NULL);
@@ -620,24 +2290,495 @@ bool sheap_releaseMutex(){
 #endif
 }
 
-void sheap_getHeapStatistic(sheap_heapStat_t* heap){
-	if(heap != NULL){
-		heap->currentAllocations = gHeap.currentAllocations;
-		heap->heapMax = gHeap.heapMax;
-		heap->heapMin = gHeap.heapMin;
-		heap->size = gHeap.size;
-		heap->totalBytesAllocated = gHeap.totalBytesAllocated;
-		heap->userDataAllocated = gHeap.userDataAllocated;
-		heap->userDataAllocatedAlligned = gHeap.userDataAllocatedAlligned;
+memory_lock_t sheap_lock(sheap_t* sheap, uint32_t busyFlags){
+	busyFlags |= MEMORY_BUSY_HEAP;
+	disableIRQs();
+	// the mutex is acquired first, so a task preempted within a sheap call blocks the other tasks instead of failing them as overlap
+#if SHEAPERD_SHEAP_ISR_SAFE == 1
+	bool useMutex = !SHEAPERD_IS_ISR_CONTEXT();
+#else
+	bool useMutex = true;
+#endif
+	if(useMutex && !sheap_acquireMutex(sheap)){
+		enableIRQs();
+		return MEMORY_LOCK_FAILED;
+	}
+#if SHEAPERD_SHEAP_ISR_SAFE == 1 && SHEAPERD_USE_LOCK_PORT == 1 && SHEAPERD_SHEAP_DISABLE_IRQS == 0
+	// an interrupt handler does not wait, a lock held by a task is reported like an overlapping call
+	if(!useMutex && !sheaperd_port_lockTryAcquireFromISR(&sheap->lock)){
+		enableIRQs();
+		return MEMORY_LOCK_BUSY;
+	}
+#endif
+#if SHEAPERD_SHEAP_ATOMIC_BUSY_FLAGS == 1
+	bool claimed = util_claimFlags(&sheap->busy, busyFlags);
+#else
+	bool claimed = (sheap->busy & busyFlags) == 0;
+	if(claimed){
+		sheap->busy |= busyFlags;
+	}
+#endif
+	if(!claimed){
+		if(useMutex){
+			sheap_releaseMutex(sheap);
+		}
+#if SHEAPERD_SHEAP_ISR_SAFE == 1 && SHEAPERD_USE_LOCK_PORT == 1 && SHEAPERD_SHEAP_DISABLE_IRQS == 0
+		else {
+			sheaperd_port_lockReleaseFromISR(&sheap->lock);
+		}
+#endif
+		enableIRQs();
+		return MEMORY_LOCK_BUSY;
+	}
+	return MEMORY_LOCK_ACQUIRED;
+}
+
+void sheap_unlock(sheap_t* sheap, uint32_t busyFlags){
+	if((busyFlags & (MEMORY_BUSY_ALLOC | MEMORY_BUSY_FREE)) != 0 && (busyFlags & MEMORY_BUSY_READ_ONLY) == 0){
+		sheap->generation++;
+	}
+	busyFlags |= MEMORY_BUSY_HEAP;
+#if SHEAPERD_SHEAP_ATOMIC_BUSY_FLAGS == 1
+	util_releaseFlags(&sheap->busy, busyFlags);
+#else
+	sheap->busy &= ~busyFlags;
+#endif
+#if SHEAPERD_SHEAP_ISR_SAFE == 1
+	if(SHEAPERD_IS_ISR_CONTEXT()){
+#if SHEAPERD_USE_LOCK_PORT == 1 && SHEAPERD_SHEAP_DISABLE_IRQS == 0
+		sheaperd_port_lockReleaseFromISR(&sheap->lock);
+#endif
+	} else
+#endif
+	{
+		sheap_releaseMutex(sheap);
+	}
+	enableIRQs();
+}
+
+#if SHEAPERD_SHEAP_LATENCY_STATISTIC == 1
+void recordLatency(sheap_t* sheap, memory_latencyOp_t op, uint32_t cycles, size_t size, uint32_t id){
+	memory_latency_t* latency = &sheap->latency[op];
+	sheap_latencyStat_t* stat = &latency->stat;
+	if(stat->count == 0 || cycles < stat->minCycles){
+		stat->minCycles = cycles;
+	}
+	if(stat->count == 0 || cycles > stat->maxCycles){
+		stat->maxCycles = cycles;
+		stat->worstCaseSize = size;
+		stat->worstCaseId = id;
+	}
+	int32_t bin = util_fls(cycles);
+	if(bin < 0){
+		bin = 0;
+	} else if(bin >= SHEAPERD_SHEAP_LATENCY_HISTOGRAM_BINS){
+		bin = SHEAPERD_SHEAP_LATENCY_HISTOGRAM_BINS - 1;
+	}
+	stat->histogram[bin]++;
+	if(sheap->blocksVisited > stat->maxBlocksVisited){
+		stat->maxBlocksVisited = sheap->blocksVisited;
+	}
+	stat->count++;
+	latency->totalCycles += cycles;
+	latency->totalBlocksVisited += sheap->blocksVisited;
+}
+
+void getLatencyStat(memory_latency_t* latency, sheap_latencyStat_t* stat){
+	*stat = latency->stat;
+	if(stat->count > 0){
+		stat->meanCycles = (uint32_t)(latency->totalCycles / stat->count);
+		stat->meanBlocksVisited = (uint32_t)(latency->totalBlocksVisited / stat->count);
+	}
+}
+
+void resetLatencyStatistic(sheap_t* sheap){
+	for(int32_t i = 0; i < MEMORY_LATENCY_COUNT; i++){
+		sheap->latency[i] = (memory_latency_t){ 0 };
+	}
+}
+
+void sheap_getLatencyStatistic_instance(sheap_t* sheap, sheap_latencyStatistic_t* latencyStat){
+	if(latencyStat == NULL || sheap_lock(sheap, 0) != MEMORY_LOCK_ACQUIRED){
+		return;
+	}
+	getLatencyStat(&sheap->latency[MEMORY_LATENCY_MALLOC], &latencyStat->malloc);
+	getLatencyStat(&sheap->latency[MEMORY_LATENCY_CALLOC], &latencyStat->calloc);
+	getLatencyStat(&sheap->latency[MEMORY_LATENCY_FREE], &latencyStat->free);
+	sheap_unlock(sheap, 0);
+}
+
+void sheap_resetLatencyStatistic_instance(sheap_t* sheap){
+	if(sheap_lock(sheap, 0) != MEMORY_LOCK_ACQUIRED){
+		return;
+	}
+	resetLatencyStatistic(sheap);
+	sheap_unlock(sheap, 0);
+}
+#endif
+
+#if SHEAPERD_SHEAP_TRACE == 1
+void traceEvent(sheap_t* sheap, sheap_traceOp_t op, uint32_t id, size_t size, void* address){
+	memory_trace_t* trace = &sheap->trace;
+	uint16_t sequence = trace->sequence++;
+	uint32_t head = trace->head;
+	if(head - trace->tail >= SHEAPERD_SHEAP_TRACE_EVENTS){
+		trace->dropped++;
+		return;
+	}
+	sheap_traceEvent_t* event = &trace->events[head & (SHEAPERD_SHEAP_TRACE_EVENTS - 1)];
+	event->magic = SHEAP_TRACE_MAGIC;
+	event->op = (uint8_t)op;
+	event->sequence = sequence;
+	event->id = id;
+	event->size = (uint32_t)size;
+	event->address = (uint32_t)(uintptr_t)address;
+	event->timestamp = SHEAPERD_GET_CYCLE_COUNT();
+	// the event has to be complete before the drain can see it
+	util_dataMemoryBarrier();
+	trace->head = head + 1;
+}
+
+uint32_t sheap_trace_drain_instance(sheap_t* sheap, uint32_t maxEvents){
+	memory_trace_t* trace = &sheap->trace;
+	uint32_t drained = 0;
+	while(drained < maxEvents && trace->tail != trace->head){
+		util_dataMemoryBarrier();
+		const sheap_traceEvent_t* event = &trace->events[trace->tail & (SHEAPERD_SHEAP_TRACE_EVENTS - 1)];
+		sheap_traceSink_cb sink = gTraceSink;
+		if(sink != NULL){
+			sink(event);
+		}
+#if SHEAPERD_SHEAP_TRACE_USE_ITM == 1
+		else {
+			util_itmWrite(SHEAPERD_SHEAP_TRACE_ITM_PORT, (const uint32_t*)event, sizeof(sheap_traceEvent_t) / sizeof(uint32_t));
+		}
+#endif
+		// the slot may only be reused after the event was read
+		util_dataMemoryBarrier();
+		trace->tail++;
+		drained++;
+	}
+	return drained;
+}
+
+uint32_t sheap_trace_getDropped_instance(sheap_t* sheap){
+	return sheap->trace.dropped;
+}
+
+void sheap_trace_setSink(sheap_traceSink_cb sink){
+	gTraceSink = sink;
+}
+#endif
+
+void sheap_getHeapStatistic_instance(sheap_t* sheap, sheap_heapStat_t* heapStat){
+	if(heapStat != NULL && sheap_lock(sheap, 0) == MEMORY_LOCK_ACQUIRED){
+		heapStat->currentAllocations = sheap->heap.currentAllocations;
+		heapStat->heapMax = sheap->heap.heapMax;
+		heapStat->heapMin = sheap->heap.heapMin;
+		heapStat->size = sheap->heap.size;
+		heapStat->totalBytesAllocated = sheap->heap.totalBytesAllocated;
+		heapStat->userDataAllocated = sheap->heap.userDataAllocated;
+		heapStat->userDataAllocatedAlligned = sheap->heap.userDataAllocatedAlligned;
+		heapStat->peakTotalBytesAllocated = sheap->heap.peakTotalBytesAllocated;
+		heapStat->peakAllocations = sheap->heap.peakAllocations;
+		heapStat->freeBlocks = sheap->heap.freeBlocks;
+		heapStat->largestFreeBlock = getLargestFreeBlock(sheap);
+		for(int i = 0; i < SHEAPERD_SHEAP_STAT_SIZE_CLASSES; i++){
+			heapStat->allocationsPerSizeClass[i] = sheap->heap.allocationsPerSizeClass[i];
+		}
+		sheap_unlock(sheap, 0);
 	}
 }
 
+size_t sheap_getAllocatedBytesAligned_instance(sheap_t* sheap){
+	return sheap->heap.userDataAllocatedAlligned;
+}
+
+size_t sheap_getAllocatedBytes_instance(sheap_t* sheap){
+	return sheap->heap.userDataAllocated;
+}
+
+void* sheap_malloc(size_t size, uint32_t id) {
+#if SHEAPERD_SHEAP_GUARDED_ALLOCATIONS == 1
+    if(isGuardRequested(id)) {
+        void* guarded = allocateGuarded(&gDefaultSheap, size, id, false);
+        if(guarded != NULL) {
+            return guarded;
+        }
+    }
+#endif
+    return sheap_malloc_instance(&gDefaultSheap, size, id);
+}
+
+void* sheap_calloc(size_t num, size_t size, uint32_t id) {
+    return sheap_calloc_instance(&gDefaultSheap, num, size, id);
+}
+
+void* sheap_memalign(size_t alignment, size_t size, uint32_t id) {
+    return sheap_memalign_instance(&gDefaultSheap, alignment, size, id);
+}
+
+void* sheap_realloc(void* ptr, size_t size, uint32_t id){
+#if SHEAPERD_SHEAP_GUARDED_ALLOCATIONS == 1
+	size_t guardedSize;
+	if(ptr != NULL && size != 0 && getGuardedSize(&gDefaultSheap, ptr, &guardedSize)){
+		// a guarded allocation is not resized in place, the new memory is not guarded
+		uint8_t* reallocated = sheap_malloc_instance(&gDefaultSheap, size, id);
+		if(reallocated != NULL){
+			for(size_t i = 0; i < size && i < guardedSize; i++){
+				reallocated[i] = ((uint8_t*)ptr)[i];
+			}
+			sheap_free(ptr, id);
+		}
+		return reallocated;
+	}
+#endif
+	return sheap_realloc_instance(&gDefaultSheap, ptr, size, id);
+}
+
+void sheap_free(void* ptr, uint32_t id){
+#if SHEAPERD_SHEAP_GUARDED_ALLOCATIONS == 1
+	if(freeGuarded(&gDefaultSheap, ptr, id)){
+		return;
+	}
+#endif
+	sheap_free_instance(&gDefaultSheap, ptr, id);
+}
+
+sheap_status_t sheap_malloc_batch(const size_t sizes[], void* allocated[], size_t n, uint32_t id){
+	return sheap_malloc_batch_instance(&gDefaultSheap, sizes, allocated, n, id);
+}
+
+void sheap_free_batch(void* ptrs[], size_t n, uint32_t id){
+#if SHEAPERD_SHEAP_GUARDED_ALLOCATIONS == 1
+	// a guarded payload is not the payload of its block, it is freed with its guard slot
+	for(size_t i = 0; ptrs != NULL && i < n; i++){
+		if(freeGuarded(&gDefaultSheap, ptrs[i], id)){
+			ptrs[i] = NULL;
+		}
+	}
+#endif
+	sheap_free_batch_instance(&gDefaultSheap, ptrs, n, id);
+}
+
+#if SHEAPERD_SHEAP_LATENCY_STATISTIC == 1
+void sheap_getLatencyStatistic(sheap_latencyStatistic_t* latencyStat){
+	sheap_getLatencyStatistic_instance(&gDefaultSheap, latencyStat);
+}
+
+void sheap_resetLatencyStatistic(){
+	sheap_resetLatencyStatistic_instance(&gDefaultSheap);
+}
+#endif
+
+#if SHEAPERD_SHEAP_TRACE == 1
+uint32_t sheap_trace_drain(uint32_t maxEvents){
+	return sheap_trace_drain_instance(&gDefaultSheap, maxEvents);
+}
+
+uint32_t sheap_trace_getDropped(){
+	return sheap_trace_getDropped_instance(&gDefaultSheap);
+}
+#endif
+
+#if SHEAPERD_SHEAP_TASK_CACHE == 1
+void sheap_cache_flush(){
+	sheap_cache_flush_instance(&gDefaultSheap);
+}
+#endif
+
+sheap_status_t sheap_scrub_step(uint32_t maxBlocks){
+	return sheap_scrub_step_instance(&gDefaultSheap, maxBlocks);
+}
+
+uint32_t sheap_scrub_getCompletedPasses(){
+	return sheap_scrub_getCompletedPasses_instance(&gDefaultSheap);
+}
+
+void sheap_walk_begin(sheap_walk_t* walk){
+	sheap_walk_begin_instance(&gDefaultSheap, walk);
+}
+
+void sheap_snapshot_begin(sheap_snapshot_t* snapshot, sheap_snapshotSink_cb sink){
+	sheap_snapshot_begin_instance(&gDefaultSheap, snapshot, sink);
+}
+
+size_t sheap_getHeapSize(){
+	return sheap_getHeapSize_instance(&gDefaultSheap);
+}
+
+void sheap_getHeapStatistic(sheap_heapStat_t* heapStat){
+	sheap_getHeapStatistic_instance(&gDefaultSheap, heapStat);
+}
+
 size_t sheap_getAllocatedBytesAligned(){
-	return gHeap.userDataAllocatedAlligned;
+	return sheap_getAllocatedBytesAligned_instance(&gDefaultSheap);
 }
 
 size_t sheap_getAllocatedBytes(){
-	return gHeap.userDataAllocated;
+	return sheap_getAllocatedBytes_instance(&gDefaultSheap);
+}
+
+#if SHEAPERD_SHEAP_GUARDED_ALLOCATIONS == 1
+void* sheap_malloc_guarded(size_t size, uint32_t id){
+	return allocateGuarded(&gDefaultSheap, size, id, true);
+}
+
+void sheap_guard_setSuspectId(uint32_t id){
+	gGuardSuspectId = id;
+}
+
+sheap_status_t sheap_guard_findOverflow(uint32_t faultAddress, void** allocation, uint32_t* id){
+	for(uint32_t i = 0; i < SHEAPERD_SHEAP_GUARD_SLOTS; i++){
+		memory_guardSlot_t slot = gGuardSlots[i];
+		if(slot.block == NULL){
+			continue;
+		}
+		uint32_t guard = (uint32_t)(uintptr_t)(slot.payload + sheap_align(slot.size));
+		if(faultAddress >= guard && faultAddress < guard + GUARD_SIZE){
+			*allocation = slot.payload;
+			*id = slot.id;
+			return SHEAP_OK;
+		}
+	}
+	return SHEAP_INVALID_POINTER;
+}
+
+bool isGuardRequested(uint32_t id){
+	if(gGuardedCount >= SHEAPERD_SHEAP_GUARD_SLOTS){
+		return false;
+	}
+	if(id != 0 && id == gGuardSuspectId){
+		return true;
+	}
+#if SHEAPERD_SHEAP_GUARD_SAMPLE_INTERVAL > 0
+	return ++gGuardSampleCount % SHEAPERD_SHEAP_GUARD_SAMPLE_INTERVAL == 0;
+#else
+	return false;
+#endif
 }
 
+void* allocateGuarded(sheap_t* sheap, size_t size, uint32_t id, bool reportErrors){
+	if(sheap->heap.heapMin == NULL || size == 0){
+		// a sampled allocation reports these errors with the regular allocation
+		SHEAPERD_ASSERT("\"SHEAP_MALLOC\" must not be used before the initialization (\"sheap_init\").", !reportErrors || sheap->heap.heapMin != NULL, SHEAP_NOT_INITIALIZED);
+		SHEAPERD_ASSERT("Cannot allocate size of 0. Is this call intentional?", !reportErrors || size > 0, SHEAP_SIZE_ZERO_ALLOC);
+		return NULL;
+	}
+	memory_lock_t lock = sheap_lock(sheap, MEMORY_BUSY_ALLOC);
+	if(lock != MEMORY_LOCK_ACQUIRED) {
+		SHEAPERD_ASSERT("Overlapping call to allocation functions 'sheap_malloc/sheap_alloc' detected. Returning without allocation.",
+				lock != MEMORY_LOCK_BUSY || IS_OVERLAP_EXPECTED(), SHEAP_MALLOC_CALL_OVERLAP);
+		return NULL;
+	}
+	if(id != 0){
+		sheap_logAccess(sheap, id);
+	}
+	uint8_t* allocated = NULL;
+	int32_t slot = findGuardSlot(NULL);
+	if(slot != -1){
+		// the requested size rounded up to the guard size, followed by the guard
+		size_t areaSize = (size + GUARD_SIZE - 1) & ~(GUARD_SIZE - 1);
+		uint8_t* block = allocateAlignedBlock(sheap, areaSize + GUARD_SIZE, GUARD_SIZE, id, reportErrors);
+		if(block != NULL){
+			uint8_t* guard = block + areaSize;
+			allocated = guard - sheap_align(size);
+			// the bytes up to the guard are checked by the free
+			clearMemory(allocated + size, guard - (allocated + size));
+			gGuardSlots[slot].payload = allocated;
+			gGuardSlots[slot].size = size;
+			gGuardSlots[slot].id = id;
+			gGuardSlots[slot].block = block;
+			gGuardedCount++;
+			writeGuardRegion(slot, guard, true);
+		}
+	}
+	TRACE_EVENT(sheap, SHEAP_TRACE_MALLOC, id, size, allocated);
+	sheap_unlock(sheap, MEMORY_BUSY_ALLOC);
+	return allocated;
+}
+
+bool freeGuarded(sheap_t* sheap, void* ptr, uint32_t id){
+	if(gGuardedCount == 0 || ptr == NULL){
+		return false;
+	}
+	memory_lock_t lock = sheap_lock(sheap, MEMORY_BUSY_FREE);
+	if(lock != MEMORY_LOCK_ACQUIRED) {
+		SHEAPERD_ASSERT("Overlapping call to 'sheap_free' detected. Returning without freeing memory.",
+				lock != MEMORY_LOCK_BUSY || IS_OVERLAP_EXPECTED(), SHEAP_FREE_CALL_OVERLAP);
+		return true;
+	}
+	int32_t slot = findGuardSlot(ptr);
+	if(slot != -1){
+		if(id != 0){
+			sheap_logAccess(sheap, id);
+		}
+		memory_guardSlot_t* guarded = &gGuardSlots[slot];
+		uint8_t* guard = guarded->payload + sheap_align(guarded->size);
+		writeGuardRegion(slot, guard, false);
+		for(uint8_t* p = guarded->payload + guarded->size; p < guard; p++){
+			if(*p != SHEAPERD_SHEAP_OVERWRITE_VALUE){
+				SHEAPERD_ASSERT("Write out of bound of a guarded allocation detected.", false, SHEAP_ERROR_OUT_OF_BOUND_WRITE);
+				break;
+			}
+		}
+		freeBlock(sheap, guarded->block, id);
+		guarded->block = NULL;
+		gGuardedCount--;
+		TRACE_EVENT(sheap, SHEAP_TRACE_FREE, id, 0, ptr);
+	}
+	sheap_unlock(sheap, MEMORY_BUSY_FREE);
+	return slot != -1;
+}
+
+bool getGuardedSize(sheap_t* sheap, void* ptr, size_t* size){
+	if(gGuardedCount == 0 || sheap_lock(sheap, 0) != MEMORY_LOCK_ACQUIRED){
+		return false;
+	}
+	int32_t slot = findGuardSlot(ptr);
+	if(slot != -1){
+		*size = gGuardSlots[slot].size;
+	}
+	sheap_unlock(sheap, 0);
+	return slot != -1;
+}
+
+int32_t findGuardSlot(const void* payload){
+	// NULL: an unused slot
+	for(int32_t i = 0; i < SHEAPERD_SHEAP_GUARD_SLOTS; i++){
+		if(payload == NULL ? gGuardSlots[i].block == NULL : (gGuardSlots[i].block != NULL && gGuardSlots[i].payload == payload)){
+			return i;
+		}
+	}
+	return -1;
+}
+
+void writeGuardRegion(uint32_t slot, const uint8_t* guard, bool enabled){
+	mpu_region_t region = {
+			.address = (uint32_t)(uintptr_t)guard,
+			.enabled = enabled,
+			.number = SHEAPERD_SHEAP_GUARD_FIRST_MPU_REGION + slot,
+			.srd = 0,
+			.size = REGIONSIZE_32B,
+			.ap = MPU_REGION_ALL_ACCESS_DENIED,
+			.cachable = true,
+			.bufferable = false,
+			.shareable = true,
+			.tex = MPU_DEFAULT_TEX,
+			.xn = true,
+#if SHEAPERD_ARMV8
+			.limit = (uint32_t)(uintptr_t)guard + GUARD_SIZE - 1,
+			.attributeIndex = SHEAPERD_SHEAP_GUARD_MPU_ATTRIBUTE_INDEX
+#endif
+	};
+	mpu_regionRegisters_t registers;
+	if(memory_protection_encodeRegion(&region, &registers) == NO_ERROR){
+		// the region number and the region registers must not be changed in between (e.g. by a task switch of the stackguard)
+		util_enterCriticalSection();
+		memory_protection_writeRegion(&registers);
+		util_exitCriticalSection();
+	}
+}
+#endif
+
 #endif
@@ -0,0 +1,213 @@
+/** @file sheap_arena.c
+ *  @brief Provides arenas (bump allocators) which are carved out of the secure heap (sheap).
+ *
+ *  Arena layout (one sheap block, growth chunks are separate sheap blocks):
+ *  +------------------------+---------------------------------------------+--------+
+ *  |                        |                                             |        |
+ *  |     arena control      |  object 0 | object 1 | ... |  (available)  | canary |
+ *  |                        |                                             |        |
+ *  +------------------------+---------------------------------------------+--------+
+ *                           ^-- aligned            ^-- cursor             ^-- capacity
+ *
+ *  +------------------------+---------------------------------------------+--------+
+ *  |     chunk control      |                object memory                | canary |
+ *  +------------------------+---------------------------------------------+--------+
+ *
+ *  An allocation only increments the cursor of the current chunk (the arena block or the last growth chunk), no per object header is
+ *  written. The objects are released with 'sheap_arena_reset', which frees the growth chunks and sets the cursor to the first object.
+ *  The sheap header and boundary of the arena block and of the chunks are checked by the sheap with each free.
+ *
+ *  Error detection:
+ *  	+ out of bound write: the canary after the object memory is checked by reset and destroy. The canary is combined with the address
+ *  	  of the arena, a canary copied from a different arena is therefore not valid
+ *  	+ altered arena: the capacity and the id are protected by a CRC16 which is checked by reset and destroy, the cursor is range checked
+ *  	  on each allocation
+ *
+ *  @author JK
+ *  @bug No known bugs.
+ */
+
+#include "internal/opt.h"
+#include "sheap_arena.h"
+
+// don't build the arenas if sheap is not enabled via options
+#if SHEAPERD_SHEAP
+
+#define ARENA_CANARY					0xA4E4AC4Eul
+#define ARENA_CANARY_SIZE				sizeof(uint32_t)
+
+#define GET_ARENA_OBJECTS(arena)		(((uint8_t*)(arena)) + sheap_align(sizeof(sheap_arena_t)))
+#define GET_CHUNK_OBJECTS(chunk)		(((uint8_t*)(chunk)) + sheap_align(sizeof(arena_chunk_t)))
+#define CANARY(arena)					(ARENA_CANARY ^ (uint32_t)(uintptr_t)(arena))
+
+typedef struct arena_chunk_t{
+	struct arena_chunk_t*	next;
+	// end of the object memory, followed by the canary
+	uint8_t*				end;
+} arena_chunk_t;
+
+struct sheap_arena_t {
+	uint32_t			capacity;
+	uint32_t			id;
+	// next free byte and end of the object memory of the current chunk
+	uint8_t*			cursor;
+	uint8_t*			limit;
+	// growth chunks, the current chunk first
+	arena_chunk_t*		chunks;
+	uint16_t			reserved;
+	uint16_t			crc;
+};
+
+static uint16_t calculateArenaCRC(sheap_arena_t* arena);
+static bool isArenaValid(sheap_arena_t* arena);
+static bool growArena(sheap_arena_t* arena, size_t size);
+static void writeCanary(sheap_arena_t* arena, uint8_t* end);
+static void checkCanary(sheap_arena_t* arena, uint8_t* end);
+static void freeChunks(sheap_arena_t* arena);
+
+sheap_arena_t* sheap_arena_create(size_t capacity, uint32_t id){
+	if(capacity == 0){
+		SHEAPERD_ASSERT("Cannot create an arena with a capacity of 0.", false, SHEAP_ARENA_INVALID_SIZE);
+		return NULL;
+	}
+	size_t capacityAligned = sheap_align(capacity);
+	if(capacityAligned < capacity || capacityAligned > UINT32_MAX - sheap_align(sizeof(sheap_arena_t)) - ARENA_CANARY_SIZE){
+		SHEAPERD_ASSERT("Arena size exceeds the addressable memory.", false, SHEAP_ARENA_INVALID_SIZE);
+		return NULL;
+	}
+	sheap_arena_t* arena = (sheap_arena_t*) sheap_malloc(sheap_align(sizeof(sheap_arena_t)) + capacityAligned + ARENA_CANARY_SIZE, id);
+	if(arena == NULL){
+		return NULL;
+	}
+	arena->capacity = capacityAligned;
+	arena->id = id;
+	arena->cursor = GET_ARENA_OBJECTS(arena);
+	arena->limit = arena->cursor + capacityAligned;
+	arena->chunks = NULL;
+	arena->reserved = 0;
+	arena->crc = calculateArenaCRC(arena);
+	writeCanary(arena, arena->limit);
+	return arena;
+}
+
+void sheap_arena_destroy(sheap_arena_t* arena){
+	if(arena == NULL || !isArenaValid(arena)){
+		SHEAPERD_ASSERT("Cannot destroy an invalid arena.", false, SHEAP_ARENA_ERROR_INVALID_ARENA);
+		return;
+	}
+	freeChunks(arena);
+	checkCanary(arena, GET_ARENA_OBJECTS(arena) + arena->capacity);
+	sheap_free(arena, arena->id);
+}
+
+void* sheap_arena_alloc(sheap_arena_t* arena, size_t size){
+	if(arena == NULL){
+		SHEAPERD_ASSERT("Cannot allocate from an arena which is NULL.", false, SHEAP_ARENA_ERROR_INVALID_ARENA);
+		return NULL;
+	}
+	if(size == 0){
+		SHEAPERD_ASSERT("Cannot allocate size of 0. Is this call intentional?", false, SHEAP_SIZE_ZERO_ALLOC);
+		return NULL;
+	}
+	size_t sizeAligned = sheap_align(size);
+	if(sizeAligned < size){
+		SHEAPERD_ASSERT("Arena allocation exceeds the addressable memory.", false, SHEAP_ARENA_INVALID_SIZE);
+		return NULL;
+	}
+	if(arena->cursor > arena->limit){
+		SHEAPERD_ASSERT("MEMORY ERROR: Arena is not valid. It may have been altered.", false, SHEAP_ARENA_ERROR_INVALID_ARENA);
+		return NULL;
+	}
+	if((size_t)(arena->limit - arena->cursor) < sizeAligned && !growArena(arena, sizeAligned)){
+		return NULL;
+	}
+	void* allocated = arena->cursor;
+	arena->cursor += sizeAligned;
+	return allocated;
+}
+
+void sheap_arena_reset(sheap_arena_t* arena){
+	if(arena == NULL || !isArenaValid(arena)){
+		SHEAPERD_ASSERT("Cannot reset an invalid arena.", false, SHEAP_ARENA_ERROR_INVALID_ARENA);
+		return;
+	}
+	uint8_t* objects = GET_ARENA_OBJECTS(arena);
+#ifdef SHEAPERD_SHEAP_OVERWRITE_ON_FREE
+	// the used memory of the arena block, the chunks are overwritten by the sheap
+	uint8_t* used = arena->chunks == NULL ? arena->cursor : objects + arena->capacity;
+#endif
+	freeChunks(arena);
+	checkCanary(arena, objects + arena->capacity);
+#ifdef SHEAPERD_SHEAP_OVERWRITE_ON_FREE
+	if(used >= objects && used <= objects + arena->capacity){
+		util_fillMemory(objects, SHEAPERD_SHEAP_OVERWRITE_VALUE, used - objects);
+	}
+#endif
+	arena->cursor = objects;
+	arena->limit = objects + arena->capacity;
+}
+
+size_t sheap_arena_getAvailableBytes(sheap_arena_t* arena){
+	return arena != NULL && arena->cursor <= arena->limit ? (size_t)(arena->limit - arena->cursor) : 0;
+}
+
+size_t sheap_arena_getCapacity(sheap_arena_t* arena){
+	return arena != NULL ? arena->capacity : 0;
+}
+
+static bool growArena(sheap_arena_t* arena, size_t size){
+#if SHEAPERD_SHEAP_ARENA_GROWTH == 1
+	size_t chunkCapacity = size > arena->capacity ? size : arena->capacity;
+	if(chunkCapacity > SIZE_MAX - sheap_align(sizeof(arena_chunk_t)) - ARENA_CANARY_SIZE){
+		SHEAPERD_ASSERT("Arena size exceeds the addressable memory.", false, SHEAP_ARENA_INVALID_SIZE);
+		return false;
+	}
+	arena_chunk_t* chunk = (arena_chunk_t*) sheap_malloc(sheap_align(sizeof(arena_chunk_t)) + chunkCapacity + ARENA_CANARY_SIZE, arena->id);
+	if(chunk == NULL){
+		return false;
+	}
+	chunk->end = GET_CHUNK_OBJECTS(chunk) + chunkCapacity;
+	chunk->next = arena->chunks;
+	writeCanary(arena, chunk->end);
+	arena->chunks = chunk;
+	arena->cursor = GET_CHUNK_OBJECTS(chunk);
+	arena->limit = chunk->end;
+	return true;
+#else
+	SHEAPERD_ASSERT("MEMORY Information: Arena is exhausted.", false, SHEAP_ARENA_EXHAUSTED);
+	return false;
+#endif
+}
+
+static void freeChunks(sheap_arena_t* arena){
+	while(arena->chunks != NULL){
+		arena_chunk_t* chunk = arena->chunks;
+		arena->chunks = chunk->next;
+		checkCanary(arena, chunk->end);
+		sheap_free(chunk, arena->id);
+	}
+}
+
+static void writeCanary(sheap_arena_t* arena, uint8_t* end){
+#if SHEAPERD_SHEAP_ARENA_CANARY == 1
+	*((uint32_t*)end) = CANARY(arena);
+#endif
+}
+
+static void checkCanary(sheap_arena_t* arena, uint8_t* end){
+#if SHEAPERD_SHEAP_ARENA_CANARY == 1
+	SHEAPERD_ASSERT("MEMORY ERROR: Out of bound write of the last arena object detected.", *((uint32_t*)end) == CANARY(arena),
+			SHEAP_ARENA_ERROR_OUT_OF_BOUND_WRITE);
+#endif
+}
+
+static uint16_t calculateArenaCRC(sheap_arena_t* arena){
+	// capacity and id never change after the creation
+	return util_crc16_calculate((const uint8_t*)arena, 2 * sizeof(uint32_t));
+}
+
+static bool isArenaValid(sheap_arena_t* arena){
+	return arena->crc == calculateArenaCRC(arena);
+}
+
+#endif
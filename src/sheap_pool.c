@@ -0,0 +1,293 @@
+/** @file sheap_pool.c
+ *  @brief Provides fixed size block pools which are carved out of the secure heap (sheap).
+ *
+ *  Pool layout (one sheap block):
+ *  +------------------------+--------+-----------------+--------+-----------------+-----+--------+-----------------+
+ *  |                        |        |                 |        |                 |     |        |                 |
+ *  |      pool control      |  tag   |     block 0     |  tag   |     block 1     | ... |  tag   |  block count-1  |
+ *  |                        |        |                 |        |                 |     |        |                 |
+ *  +------------------------+--------+-----------------+--------+-----------------+-----+--------+-----------------+
+ *                           ^-- 4 bytes ^-- aligned block size
+ *
+ *  Each block is preceded by a 4 byte tag. The tag is a magic value for the allocated/free state combined with the index of the block,
+ *  a tag copied from a different block is therefore not valid. Free blocks are kept in an intrusive single linked list, the index of the
+ *  next free block is stored in the first 4 bytes of the free block. Allocation and free take constant time.
+ *
+ *  Error detection:
+ *  	+ double free: the tag of the freed block is the free tag
+ *  	+ out of bound write: the tag of the freed block or the tag of the following block is neither a valid allocated nor a free tag
+ *  	+ invalid pointer: the pointer is outside of the pool or does not point to the start of a block
+ *  	+ altered pool: the geometry (slot size and count) is protected by a CRC16, the free list index is range checked before it is used.
+ *  	  The free list head and the free count change with every call and are not covered, the free count is not checked
+ *
+ *  @author JK
+ *  @bug No known bugs.
+ */
+
+#include "internal/opt.h"
+#include "sheap_pool.h"
+
+// don't build the pools if sheap is not enabled via options
+#if SHEAPERD_SHEAP
+
+#define POOL_SLOT_TAG_ALLOCATED			0xA110CA7Eul
+#define POOL_SLOT_TAG_FREE				0xF4EEB10Cul
+#define POOL_FREE_LIST_END				0xFFFFFFFFul
+#define POOL_SLOT_TAG_SIZE				sizeof(uint32_t)
+
+#define GET_SLOT_TAG(pool, index)		((uint32_t*)(((uint8_t*)((pool) + 1)) + (index) * (pool)->slotSize))
+#define GET_SLOT_PAYLOAD(pool, index)	((uint8_t*)(GET_SLOT_TAG(pool, index) + 1))
+#define ALLOCATED_TAG(index)			(POOL_SLOT_TAG_ALLOCATED ^ (uint32_t)(index))
+#define FREE_TAG(index)					(POOL_SLOT_TAG_FREE ^ (uint32_t)(index))
+
+#define REPORT_ERROR_RELEASE_MUTEX_ENABLE_IRQS_AND_RETURN(pool, assertMsg, assertionType)	\
+do{																							\
+	SHEAPERD_ASSERT(assertMsg, false, assertionType);										\
+	pool_releaseMutex(pool);																\
+	enableIRQs();																			\
+	return;																					\
+}while(0)
+
+#define REPORT_ERROR_RELEASE_MUTEX_ENABLE_IRQS_AND_RETURN_NULL(pool, assertMsg, assertionType)	\
+do{																								\
+	SHEAPERD_ASSERT(assertMsg, false, assertionType);											\
+	pool_releaseMutex(pool);																	\
+	enableIRQs();																				\
+	return NULL;																				\
+}while(0)
+
+struct sheap_pool_t {
+	uint32_t			slotSize;
+	uint32_t			count;
+	uint32_t			freeHead;
+	uint32_t			freeCount;
+#if SHEAPERD_SHEAP_DISABLE_IRQS == 0 && SHEAPERD_USE_LOCK_PORT == 1
+	sheaperd_portLock_t	lock;
+#elif SHEAPERD_SHEAP_DISABLE_IRQS == 0 && SHEAPERD_CMSIS_1 == 1
+	osMutexId			mutexId;
+	util_mutexDef_t		mutexDef;
+#elif SHEAPERD_SHEAP_DISABLE_IRQS == 0 && SHEAPERD_CMSIS_2 == 1
+	osMutexId_t			mutexId;
+#endif
+	uint16_t			crc;
+};
+
+#if SHEAPERD_SHEAP_DISABLE_IRQS == 0 && SHEAPERD_USE_LOCK_PORT == 0 && SHEAPERD_CMSIS_2 == 1
+static const osMutexAttr_t poolMutex_attr = {
+	  "sheap_pool_mutex",
+	  0U,
+	  NULL,
+	  0U
+};
+#endif
+
+static uint16_t calculatePoolCRC(sheap_pool_t* pool);
+static bool isPoolValid(sheap_pool_t* pool);
+static bool pool_initMutex(sheap_pool_t* pool);
+static void pool_deleteMutex(sheap_pool_t* pool);
+static bool pool_acquireMutex(sheap_pool_t* pool);
+static bool pool_releaseMutex(sheap_pool_t* pool);
+
+sheap_pool_t* sheap_pool_create(size_t blockSize, uint32_t count){
+	if(blockSize == 0 || count == 0){
+		SHEAPERD_ASSERT("Cannot create a pool with a block size or count of 0.", false, SHEAP_POOL_INVALID_SIZE);
+		return NULL;
+	}
+	size_t slotSize = POOL_SLOT_TAG_SIZE + sheap_align(blockSize);
+	if(count > (SIZE_MAX - sizeof(sheap_pool_t)) / slotSize){
+		SHEAPERD_ASSERT("Pool size exceeds the addressable memory.", false, SHEAP_POOL_INVALID_SIZE);
+		return NULL;
+	}
+	sheap_pool_t* pool = (sheap_pool_t*) sheap_malloc(sizeof(sheap_pool_t) + count * slotSize, 0);
+	if(pool == NULL){
+		return NULL;
+	}
+	pool->slotSize = slotSize;
+	pool->count = count;
+	pool->freeHead = 0;
+	pool->freeCount = count;
+	pool->crc = calculatePoolCRC(pool);
+	for(uint32_t i = 0; i < count; i++){
+		*GET_SLOT_TAG(pool, i) = FREE_TAG(i);
+		*((uint32_t*)GET_SLOT_PAYLOAD(pool, i)) = (i + 1 < count) ? i + 1 : POOL_FREE_LIST_END;
+	}
+	if(!pool_initMutex(pool)){
+		sheap_free(pool, 0);
+		return NULL;
+	}
+	return pool;
+}
+
+void sheap_pool_destroy(sheap_pool_t* pool){
+	if(pool == NULL || !isPoolValid(pool)){
+		SHEAPERD_ASSERT("Cannot destroy an invalid pool.", false, SHEAP_POOL_ERROR_INVALID_POOL);
+		return;
+	}
+	pool_deleteMutex(pool);
+	sheap_free(pool, 0);
+}
+
+void* sheap_pool_alloc(sheap_pool_t* pool){
+	disableIRQs();
+	if(pool == NULL || !isPoolValid(pool)){
+		SHEAPERD_ASSERT("Pool is not valid. It may have been altered.", false, SHEAP_POOL_ERROR_INVALID_POOL);
+		enableIRQs();
+		return NULL;
+	}
+	if(!pool_acquireMutex(pool)){
+		enableIRQs();
+		return NULL;
+	}
+	uint32_t index = pool->freeHead;
+	if(index == POOL_FREE_LIST_END){
+		REPORT_ERROR_RELEASE_MUTEX_ENABLE_IRQS_AND_RETURN_NULL(pool, "MEMORY Information: No pool block available.", SHEAP_POOL_EXHAUSTED);
+	}
+	if(index >= pool->count || *GET_SLOT_TAG(pool, index) != FREE_TAG(index)){
+		REPORT_ERROR_RELEASE_MUTEX_ENABLE_IRQS_AND_RETURN_NULL(pool,
+				"MEMORY ERROR: Pool free list is not valid. It may have been altered.", SHEAP_POOL_ERROR_CORRUPTED_FREE_LIST);
+	}
+	uint32_t* payload = (uint32_t*) GET_SLOT_PAYLOAD(pool, index);
+	uint32_t next = *payload;
+	if(next != POOL_FREE_LIST_END && next >= pool->count){
+		REPORT_ERROR_RELEASE_MUTEX_ENABLE_IRQS_AND_RETURN_NULL(pool,
+				"MEMORY ERROR: Pool free list is not valid. It may have been altered.", SHEAP_POOL_ERROR_CORRUPTED_FREE_LIST);
+	}
+	pool->freeHead = next;
+	pool->freeCount--;
+	*GET_SLOT_TAG(pool, index) = ALLOCATED_TAG(index);
+	pool_releaseMutex(pool);
+	enableIRQs();
+	return payload;
+}
+
+void sheap_pool_free(sheap_pool_t* pool, void* ptr){
+	disableIRQs();
+	if(pool == NULL || !isPoolValid(pool)){
+		SHEAPERD_ASSERT("Pool is not valid. It may have been altered.", false, SHEAP_POOL_ERROR_INVALID_POOL);
+		enableIRQs();
+		return;
+	}
+	if(!pool_acquireMutex(pool)){
+		enableIRQs();
+		return;
+	}
+	uint8_t* first = GET_SLOT_PAYLOAD(pool, 0);
+	if(ptr == NULL || (uint8_t*)ptr < first || (uint8_t*)ptr >= first + pool->count * pool->slotSize
+			|| (((uint8_t*)ptr) - first) % pool->slotSize != 0){
+		REPORT_ERROR_RELEASE_MUTEX_ENABLE_IRQS_AND_RETURN(pool, "Cannot free pointer which is not a block of the pool.", SHEAP_POOL_ERROR_INVALID_POINTER);
+	}
+	uint32_t index = (((uint8_t*)ptr) - first) / pool->slotSize;
+	uint32_t tag = *GET_SLOT_TAG(pool, index);
+	if(tag == FREE_TAG(index)){
+		REPORT_ERROR_RELEASE_MUTEX_ENABLE_IRQS_AND_RETURN(pool, "MEMORY ERROR: Pool double free detected.", SHEAP_POOL_ERROR_DOUBLE_FREE);
+	}
+	if(tag != ALLOCATED_TAG(index)){
+		REPORT_ERROR_RELEASE_MUTEX_ENABLE_IRQS_AND_RETURN(pool,
+				"MEMORY ERROR: Pool block tag is not valid. The previous block may have been written out of bound.", SHEAP_POOL_ERROR_OUT_OF_BOUND_WRITE);
+	}
+	if(index + 1 < pool->count){
+		uint32_t nextTag = *GET_SLOT_TAG(pool, index + 1);
+		if(nextTag != ALLOCATED_TAG(index + 1) && nextTag != FREE_TAG(index + 1)){
+			REPORT_ERROR_RELEASE_MUTEX_ENABLE_IRQS_AND_RETURN(pool,
+					"MEMORY ERROR: Out of bound write detected. Pool free operation aborted", SHEAP_POOL_ERROR_OUT_OF_BOUND_WRITE);
+		}
+	}
+#ifdef SHEAPERD_SHEAP_OVERWRITE_ON_FREE
+	util_fillMemory(ptr, SHEAPERD_SHEAP_OVERWRITE_VALUE, pool->slotSize - POOL_SLOT_TAG_SIZE);
+#endif
+	*((uint32_t*)ptr) = pool->freeHead;
+	*GET_SLOT_TAG(pool, index) = FREE_TAG(index);
+	pool->freeHead = index;
+	pool->freeCount++;
+	pool_releaseMutex(pool);
+	enableIRQs();
+}
+
+uint32_t sheap_pool_getNumberOfFreeBlocks(sheap_pool_t* pool){
+	return pool != NULL ? pool->freeCount : 0;
+}
+
+uint32_t sheap_pool_getNumberOfBlocks(sheap_pool_t* pool){
+	return pool != NULL ? pool->count : 0;
+}
+
+size_t sheap_pool_getBlockSize(sheap_pool_t* pool){
+	return pool != NULL ? pool->slotSize - POOL_SLOT_TAG_SIZE : 0;
+}
+
+bool sheap_pool_contains(sheap_pool_t* pool, const void* ptr){
+	if(pool == NULL){
+		return false;
+	}
+	const uint8_t* first = GET_SLOT_PAYLOAD(pool, 0);
+	return (const uint8_t*)ptr >= first && (const uint8_t*)ptr < first + pool->count * pool->slotSize;
+}
+
+static uint16_t calculatePoolCRC(sheap_pool_t* pool){
+	// slot size and count never change after the creation
+	return util_crc16_calculate((const uint8_t*)pool, 2 * sizeof(uint32_t));
+}
+
+static bool isPoolValid(sheap_pool_t* pool){
+	return pool->crc == calculatePoolCRC(pool);
+}
+
+static bool pool_initMutex(sheap_pool_t* pool){
+#if SHEAPERD_SHEAP_DISABLE_IRQS == 1 || SHEAPERD_NO_OS == 1
+	(void)pool;
+	util_error_t error = ERROR_NO_ERROR;
+#elif SHEAPERD_USE_LOCK_PORT == 1
+	pool->lock.handle = NULL;
+	util_error_t error = sheaperd_port_lockInit(&pool->lock, "sheap_pool_mutex") ? ERROR_NO_ERROR : ERROR_MUTEX_CREATION_FAILED;
+#elif SHEAPERD_CMSIS_1 == 1
+	pool->mutexId = 0;
+	util_error_t error = util_initInstanceMutex(&pool->mutexDef, &pool->mutexId);
+#elif SHEAPERD_CMSIS_2 == 1
+	pool->mutexId = NULL;
+	util_error_t error = util_initMutex(&pool->mutexId, &poolMutex_attr);
+#endif
+	SHEAPERD_ASSERT("Mutex creation failed.", error == ERROR_NO_ERROR, SHEAPERD_ERROR_MUTEX_CREATION_FAILED);
+	return error == ERROR_NO_ERROR;
+}
+
+static void pool_deleteMutex(sheap_pool_t* pool){
+#if SHEAPERD_SHEAP_DISABLE_IRQS == 1 || SHEAPERD_NO_OS == 1
+	(void)pool;
+#elif SHEAPERD_USE_LOCK_PORT == 1
+	sheaperd_port_lockDelete(&pool->lock);
+#else
+	util_error_t error = util_deleteMutex(&pool->mutexId);
+	SHEAPERD_ASSERT("Mutex deletion failed.", error == ERROR_NO_ERROR, SHEAPERD_ERROR_MUTEX_DELETION_FAILED);
+#endif
+}
+
+static bool pool_acquireMutex(sheap_pool_t* pool){
+#if SHEAPERD_SHEAP_DISABLE_IRQS == 1 || SHEAPERD_NO_OS == 1
+	(void)pool;
+	return true;
+#elif SHEAPERD_USE_LOCK_PORT == 1
+	bool acquired = sheaperd_port_lockAcquire(&pool->lock, SHEAPERD_DEFAULT_MUTEX_WAIT_TICKS);
+	SHEAPERD_ASSERT("Mutex acquire failed.", acquired, SHEAPERD_ERROR_MUTEX_ACQUIRE_FAILED);
+	return acquired;
+#else
+	util_error_t error = util_acquireMutex(pool->mutexId, SHEAPERD_DEFAULT_MUTEX_WAIT_TICKS);
+	SHEAPERD_ASSERT("Mutex acquire failed.", error == ERROR_NO_ERROR, SHEAPERD_ERROR_MUTEX_ACQUIRE_FAILED);
+	return error == ERROR_NO_ERROR;
+#endif
+}
+
+static bool pool_releaseMutex(sheap_pool_t* pool){
+#if SHEAPERD_SHEAP_DISABLE_IRQS == 1 || SHEAPERD_NO_OS == 1
+	(void)pool;
+	return true;
+#elif SHEAPERD_USE_LOCK_PORT == 1
+	sheaperd_port_lockRelease(&pool->lock);
+	return true;
+#else
+	util_error_t error = util_releaseMutex(pool->mutexId);
+	SHEAPERD_ASSERT("Mutex release failed.", error == ERROR_NO_ERROR, SHEAPERD_ERROR_MUTEX_RELEASE_FAILED);
+	return error == ERROR_NO_ERROR;
+#endif
+}
+
+#endif
@@ -14,7 +14,9 @@
 #endif
 #include "stackguard.h"
 
-#if SHEAPERD_CMSIS_2 == 1
+#if SHEAPERD_USE_LOCK_PORT == 1
+static sheaperd_portLock_t gStackLock;
+#elif SHEAPERD_CMSIS_2 == 1
 static osMutexId_t gStackMutex_id;
 static const osMutexAttr_t stackMutex_attr = {
 	  "stackguard_mutex",
@@ -24,7 +26,7 @@ static const osMutexAttr_t stackMutex_attr = {
 };
 #endif
 
-#if SHEAPERD_CMSIS_1 == 1
+#if SHEAPERD_USE_LOCK_PORT == 0 && SHEAPERD_CMSIS_1 == 1
 osMutexDef(stackguard_mutex);
 osMutexId gStackMutex_id;
 #endif
@@ -35,20 +37,53 @@ osMutexId gStackMutex_id;
 #define SCB_CFSR_MEMFAULTSR_Msk	0xFF
 #define SCB_CFSR_DACCVIOL_Msk	1 << 1
 
+#define STACKGUARD_ARMV8_REGION_GRANULARITY_MASK	0x1F
+// Armv7: regions of 256 bytes and larger have eight sub-regions which can be disabled
+#define STACKGUARD_SUBREGION_COUNT					8
+#define STACKGUARD_SUBREGION_MIN_REGION_EXP			8
+#define STACKGUARD_MIN_REGION_EXP					5
+
 typedef struct{
-	int32_t taskId;
-	mpu_region_t mpuRegion;
-} stackguard_mpuRegion_t;
+	// index of the mapped task descriptor, -1 if the region is unused
+	int32_t task;
+	// index of the mapped region of the task (stacks spanning two regions)
+	uint32_t part;
+	// switch count of the last switch in of the mapped task, the least recently used region is reassigned
+	uint32_t lastUse;
+	// register values of the unused (disabled) region
+	mpu_regionRegisters_t disabled;
+} stackguard_region_t;
 
 static uint8_t gNumberOfRegions = 0;
-static uint8_t gNextUnusedRegion = 0;
-static stackguard_mpuRegion_t gTasksRegions[STACKGUARD_NUMBER_OF_MPU_REGIONS] = { 0 };
+static stackguard_region_t gRegions[STACKGUARD_NUMBER_OF_MPU_REGIONS];
+static stackguard_task_t gDefaultTasks[STACKGUARD_NUMBER_OF_MPU_REGIONS];
+static stackguard_task_t* gTasks = gDefaultTasks;
+static uint32_t gTaskTableSize = STACKGUARD_NUMBER_OF_MPU_REGIONS;
+static uint32_t gSwitchCount = 0;
+// task which is currently switched in (-1: none), only its region and the region of the next task are changed on a switch
+static int32_t gSwitchedInTask = -1;
+// set if tasks have been added or removed, the next switch writes all regions
+static volatile bool gIsRegionUpdateRequired = true;
 static stackguarg_memFault_cb gMemFault_cb = NULL;
 
 static bool isPowerOfTwo(uint32_t value);
 static mpu_region_t createDefaultRegion(uint32_t number);
+static stackguard_error_t addTaskRegion(uint32_t taskId, const mpu_region_t stack[], uint32_t regionCount, uint32_t stackBase, uint32_t stackSize,
+		mpu_access_permission_t initialAP);
 static stackguard_error_t removeRegion(uint32_t taskId);
+static void clearTaskTable();
+static int32_t findTask(uint32_t taskId);
+static int32_t findFreeTask();
+static void mapTask(int32_t task);
+static uint32_t findRegionToMap(int32_t task);
+static mpu_regionRegisters_t getRegisters(uint32_t region, bool isSwitchedIn);
 static void fillRegionDefaults(mpu_region_t* region);
+static void paintStack(stackguard_task_t* task);
+static void scanStack(stackguard_task_t* task, stackguard_stackUsage_t* usage);
+#if !SHEAPERD_ARMV8
+static uint32_t ceilLog2(uint32_t value);
+static uint32_t alignUp(uint32_t value, uint32_t exp);
+#endif
 
 static bool stackguard_acquireMutex();
 static bool stackguard_releaseMutex();
@@ -95,15 +130,37 @@ void MemManage_Handler(void) {
 stackguard_error_t stackguard_init(stackguarg_memFault_cb memFaultCallback){
 	gMemFault_cb = memFaultCallback;
 	memory_protection_disableMPU();
-	gNumberOfRegions = 0;
-	for(uint32_t i = 0; i < STACKGUARD_NUMBER_OF_MPU_REGIONS; i++){
-		gTasksRegions[i].taskId = -1;
-		gTasksRegions[i].mpuRegion = createDefaultRegion(i);
-	}
 	gNumberOfRegions = memory_protection_getNumberOfMPURegions();
+	if(gNumberOfRegions > STACKGUARD_NUMBER_OF_MPU_REGIONS){
+		gNumberOfRegions = STACKGUARD_NUMBER_OF_MPU_REGIONS;
+	}
+#if SHEAPERD_ARMV8
+	memory_protection_setMemoryAttributes(STACKGUARD_MPU_ATTRIBUTE_INDEX, STACKGUARD_MPU_ATTRIBUTES);
+#endif
+	// disables all regions used by the stackguard
+	mpu_region_t regions[STACKGUARD_NUMBER_OF_MPU_REGIONS];
+	for(uint32_t i = 0; i < gNumberOfRegions; i++){
+		regions[i] = createDefaultRegion(i);
+		regions[i].enabled = false;
+		gRegions[i].task = -1;
+		gRegions[i].part = 0;
+		gRegions[i].lastUse = 0;
+		memory_protection_encodeRegion(&regions[i], &gRegions[i].disabled);
+	}
+	if(gNumberOfRegions > 0){
+		memory_protection_configureRegions(regions, gNumberOfRegions, false);
+	}
+	gTasks = gDefaultTasks;
+	gTaskTableSize = STACKGUARD_NUMBER_OF_MPU_REGIONS;
+	clearTaskTable();
+	gSwitchCount = 0;
+	gSwitchedInTask = -1;
+	gIsRegionUpdateRequired = false;
 
 #if SHEAPERD_NO_OS == 1
 	util_error_t error = ERROR_NO_ERROR;
+#elif SHEAPERD_USE_LOCK_PORT == 1
+	util_error_t error = sheaperd_port_lockInit(&gStackLock, "stackguard_mutex") ? ERROR_NO_ERROR : ERROR_MUTEX_CREATION_FAILED;
 #elif SHEAPERD_CMSIS_1 == 1
 	util_error_t error = util_initMutex(osMutex(stackguard_mutex), &gStackMutex_id);
 #elif SHEAPERD_CMSIS_2 == 1
@@ -115,8 +172,32 @@ stackguard_error_t stackguard_init(stackguarg_memFault_cb memFaultCallback){
 }
 
 stackguard_error_t stackguard_addTaskByteSize(uint32_t taskId, uint32_t* sp, uint32_t stackSize, mpu_access_permission_t initialAP, bool xn) {
+#if SHEAPERD_ARMV8
+	// base/limit regions: any multiple of 32 bytes
+	if(stackSize == 0 || (stackSize & STACKGUARD_ARMV8_REGION_GRANULARITY_MASK) != 0) {
+		return STACKGUARD_MPU_INVALID_REGION_SIZE;
+	}
+	mpu_region_t stack;
+	stack.address = (uint32_t)sp;
+	stack.limit = stack.address + stackSize - 1;
+	stack.xn = xn;
+	stack.srd = 0;
+	return addTaskRegion(taskId, &stack, 1, stack.address, stackSize, initialAP);
+#else
     if(!isPowerOfTwo(stackSize)) {
-        return STACKGUARD_MPU_INVALID_REGION_SIZE;
+        // sub-region fitted stack, has to be placed where 'stackguard_fitStack' puts it
+        stackguard_stackFit_t fit;
+        stackguard_error_t error = stackguard_fitStack((uint32_t)sp, stackSize, true, &fit);
+        if(error != STACKGUARD_NO_ERROR) {
+            return error;
+        }
+        if(fit.base != (uint32_t)sp) {
+            return STACKGUARD_INVALID_STACK_ALIGNMENT;
+        }
+        if(fit.size != stackSize) {
+            return STACKGUARD_MPU_INVALID_REGION_SIZE;
+        }
+        return stackguard_addTaskFitted(taskId, &fit, initialAP, xn);
     }
     uint32_t exp = 0;
     size_t size = stackSize;
@@ -124,46 +205,110 @@ stackguard_error_t stackguard_addTaskByteSize(uint32_t taskId, uint32_t* sp, uin
         exp++;
     }
     return stackguard_addTask(taskId, sp, (mpu_regionSize_t) (exp - 1), initialAP, xn);
+#endif
 }
 
-stackguard_error_t stackguard_addTask(uint32_t taskId, uint32_t* sp, mpu_regionSize_t stackSize, mpu_access_permission_t initialAP, bool xn){
-	if(gNextUnusedRegion >= gNumberOfRegions){
-		return STACKGUARD_NO_MPU_REGION_LEFT;
-	}
+stackguard_error_t stackguard_setTaskTable(stackguard_task_t tasks[], uint32_t size){
 	if(!stackguard_acquireMutex()){
 		return STACKGUARD_MUTEX_ACQUIRE_FAILED;
 	}
-	stackguard_mpuRegion_t region;
-	region.taskId = taskId;
-	region.mpuRegion.address = (uint32_t)sp;
-	region.mpuRegion.number = gNextUnusedRegion;
-	region.mpuRegion.size = stackSize;
-	region.mpuRegion.ap = initialAP;
-	fillRegionDefaults(&region.mpuRegion);
-	region.mpuRegion.xn = xn;
-
-	mpu_error_t error = memory_protection_configureRegion(&region.mpuRegion, false);
-	switch (error){
-		case INVALID_REGION_ADDRESS:
-			stackguard_releaseMutex();
-			return STACKGUARD_INVALID_MPU_ADDRESS;
-		case INVALID_REGION_ADDRESS_ALIGNMENT:
+	for(uint32_t i = 0; i < gTaskTableSize; i++){
+		if(gTasks[i].taskId != -1){
 			stackguard_releaseMutex();
-			return STACKGUARD_INVALID_STACK_ALIGNMENT;
-		case INVALID_REGION_NUMBER:
-			stackguard_releaseMutex();
-			return STACKGUARD_INVALID_REGION_NUMBER;
-		default:
-			break;
-	}
-	gTasksRegions[gNextUnusedRegion] = region;
-	while (gNextUnusedRegion < gNumberOfRegions && gTasksRegions[gNextUnusedRegion].taskId != -1) {
-		gNextUnusedRegion++;
+			return STACKGUARD_TASK_TABLE_IN_USE;
+		}
 	}
+	util_enterCriticalSection();
+	gTasks = tasks;
+	gTaskTableSize = size;
+	clearTaskTable();
+	util_exitCriticalSection();
 	stackguard_releaseMutex();
 	return STACKGUARD_NO_ERROR;
 }
 
+stackguard_error_t stackguard_addTask(uint32_t taskId, uint32_t* sp, mpu_regionSize_t stackSize, mpu_access_permission_t initialAP, bool xn){
+	mpu_region_t stack;
+	stack.address = (uint32_t)sp;
+	stack.size = stackSize;
+#if SHEAPERD_ARMV8
+	stack.limit = stack.address + (2ul << stackSize) - 1;
+#endif
+	stack.xn = xn;
+	stack.srd = 0;
+	return addTaskRegion(taskId, &stack, 1, stack.address, 2ul << stackSize, initialAP);
+}
+
+stackguard_error_t stackguard_fitStack(uint32_t address, uint32_t stackSize, bool allowTwoRegions, stackguard_stackFit_t* fit){
+	if(stackSize == 0 || stackSize > 0x80000000ul){
+		return STACKGUARD_MPU_INVALID_REGION_SIZE;
+	}
+	for(uint32_t i = 0; i < STACKGUARD_MAX_REGIONS_PER_TASK; i++){
+		fit->regions[i].number = 0;
+		fit->regions[i].srd = 0;
+	}
+	fit->regionCount = 1;
+#if SHEAPERD_ARMV8
+	// a single region fits any stack with the 32 byte granularity
+	(void)allowTwoRegions;
+	fit->base = (address + STACKGUARD_ARMV8_REGION_GRANULARITY_MASK) & ~STACKGUARD_ARMV8_REGION_GRANULARITY_MASK;
+	fit->size = (stackSize + STACKGUARD_ARMV8_REGION_GRANULARITY_MASK) & ~STACKGUARD_ARMV8_REGION_GRANULARITY_MASK;
+	if(fit->base < address || fit->base + (fit->size - 1) < fit->base){
+		return STACKGUARD_INVALID_MPU_ADDRESS;
+	}
+	fit->regions[0].address = fit->base;
+	fit->regions[0].limit = fit->base + fit->size - 1;
+#else
+	// smallest region covering the stack with its sub-regions
+	uint32_t exp = ceilLog2(stackSize);
+	if(exp < STACKGUARD_MIN_REGION_EXP){
+		exp = STACKGUARD_MIN_REGION_EXP;
+	}
+	uint32_t regionSize = 1ul << exp;
+	if(exp < STACKGUARD_SUBREGION_MIN_REGION_EXP){
+		fit->base = alignUp(address, exp);
+		fit->size = regionSize;
+	} else {
+		uint32_t subregionExp = exp - 3;
+		uint32_t subregions = (stackSize + (1ul << subregionExp) - 1) >> subregionExp;
+		fit->base = alignUp(address, subregionExp);
+		fit->size = subregions << subregionExp;
+		uint32_t first = (fit->base >> subregionExp) & (STACKGUARD_SUBREGION_COUNT - 1);
+		if(first + subregions > STACKGUARD_SUBREGION_COUNT && !allowTwoRegions){
+			fit->base = alignUp(address, exp);
+			first = 0;
+		}
+		uint32_t enabled = ((1ul << subregions) - 1) << first;
+		fit->regions[0].srd = (uint8_t)~enabled;
+		if(first + subregions > STACKGUARD_SUBREGION_COUNT){
+			// the upper sub-regions of the first and the lower sub-regions of the next region
+			fit->regionCount = 2;
+			fit->regions[1].address = (fit->base & ~(regionSize - 1)) + regionSize;
+			fit->regions[1].size = (mpu_regionSize_t)(exp - 1);
+			fit->regions[1].srd = (uint8_t)~(enabled >> STACKGUARD_SUBREGION_COUNT);
+		}
+	}
+	if(fit->base < address || fit->base + (fit->size - 1) < fit->base){
+		return STACKGUARD_INVALID_MPU_ADDRESS;
+	}
+	fit->regions[0].address = fit->base & ~(regionSize - 1);
+	fit->regions[0].size = (mpu_regionSize_t)(exp - 1);
+#endif
+	return STACKGUARD_NO_ERROR;
+}
+
+stackguard_error_t stackguard_addTaskFitted(uint32_t taskId, const stackguard_stackFit_t* fit, mpu_access_permission_t initialAP, bool xn){
+	if(fit->regionCount == 0 || fit->regionCount > STACKGUARD_MAX_REGIONS_PER_TASK){
+		return STACKGUARD_INVALID_REGION_NUMBER;
+	}
+	mpu_region_t stack[STACKGUARD_MAX_REGIONS_PER_TASK];
+	for(uint32_t i = 0; i < fit->regionCount; i++){
+		stack[i] = fit->regions[i];
+		stack[i].xn = xn;
+	}
+	return addTaskRegion(taskId, stack, fit->regionCount, fit->base, fit->size, initialAP);
+}
+
 stackguard_error_t stackguard_removeTask(uint32_t taskId){
 	if(!stackguard_acquireMutex()){
 		return STACKGUARD_MUTEX_ACQUIRE_FAILED;
@@ -173,24 +318,136 @@ stackguard_error_t stackguard_removeTask(uint32_t taskId){
 	return error;
 }
 
+// maps the next task and writes the changed regions, returns true if all regions were written with the MPU disabled
+static bool switchIn(int32_t switchedIn){
+	bool isFullUpdate = false;
+	gSwitchCount++;
+	// the parts of the next task which are mapped to a region of another (or no) task by this switch
+	bool isReassigned[STACKGUARD_MAX_REGIONS_PER_TASK];
+	if(switchedIn != -1){
+		for(uint32_t i = 0; i < gTasks[switchedIn].regionCount; i++){
+			isReassigned[i] = gTasks[switchedIn].region[i] == -1;
+		}
+		mapTask(switchedIn);
+	}
+	if(gIsRegionUpdateRequired){
+		gIsRegionUpdateRequired = false;
+		mpu_regionRegisters_t registers[STACKGUARD_NUMBER_OF_MPU_REGIONS];
+		for(int32_t i = 0; i < gNumberOfRegions; i++){
+			registers[i] = getRegisters(i, gRegions[i].task != -1 && gRegions[i].task == switchedIn);
+		}
+		memory_protection_disableMPU();
+		memory_protection_writeRegions(registers, gNumberOfRegions);
+		isFullUpdate = true;
+	} else if(switchedIn != gSwitchedInTask){
+		// only the permission of the previous task changes. The region of the next task either changes its permission or is reassigned
+		// from the least recently used task (whose part is unmapped, so each region is written once). A reassigned region gets another
+		// address and size, it is disabled before its new registers are written as they are written with two stores and the MPU enabled
+		mpu_regionRegisters_t registers[2 * STACKGUARD_MAX_REGIONS_PER_TASK];
+		uint32_t count = 0;
+		if(gSwitchedInTask != -1){
+			for(uint32_t i = 0; i < gTasks[gSwitchedInTask].regionCount; i++){
+				if(gTasks[gSwitchedInTask].region[i] != -1){
+					registers[count++] = getRegisters(gTasks[gSwitchedInTask].region[i], false);
+				}
+			}
+		}
+		if(switchedIn != -1){
+			for(uint32_t i = 0; i < gTasks[switchedIn].regionCount; i++){
+				if(isReassigned[i]){
+					memory_protection_disableRegion(gTasks[switchedIn].region[i]);
+				}
+				registers[count++] = getRegisters(gTasks[switchedIn].region[i], true);
+			}
+		}
+		memory_protection_writeRegions(registers, count);
+	}
+	if(switchedIn != -1){
+		for(uint32_t i = 0; i < gTasks[switchedIn].regionCount; i++){
+			gRegions[gTasks[switchedIn].region[i]].lastUse = gSwitchCount;
+		}
+	}
+	gSwitchedInTask = switchedIn;
+	return isFullUpdate;
+}
+
 void stackguard_taskSwitchIn(uint32_t taskId, bool enableMPU){
 	if(!memory_protection_isMPUEnabled()){
 		SHEAPERD_ASSERT("Stackguard task switch in: MPU is not enabled.", false, STACKGUARD_MPU_NOT_ENABLED);
 	}
-	memory_protection_disableMPU();
-	for(int i = 0; i < gNumberOfRegions; i++){
-		stackguard_mpuRegion_t region = gTasksRegions[i];
-		if(region.taskId != -1){
-			region.mpuRegion.ap = region.taskId == taskId ? MPU_REGION_ALL_ACCESS_ALLOWED : STACKGUARD_DEFAULT_TASK_SWITCH_OUT_PERMISSION;
-			region.mpuRegion.number = i;
-			memory_protection_configureRegion(&region.mpuRegion, false);
-		}
-	}
+	switchIn(findTask(taskId));
 	if(enableMPU) {
 	    memory_protection_enableMPU();
+	} else {
+		memory_protection_disableMPU();
+	}
+}
+
+stackguard_task_t* stackguard_getTaskHandle(uint32_t taskId){
+	if(!stackguard_acquireMutex()){
+		return NULL;
+	}
+	int32_t index = findTask(taskId);
+	stackguard_releaseMutex();
+	return index == -1 ? NULL : &gTasks[index];
+}
+
+void stackguard_taskSwitchInHandle(stackguard_task_t* task){
+	// a handle of a removed task (or of a replaced task table) switches in no guarded task
+	int32_t switchedIn = -1;
+	if(task != NULL && task >= gTasks && task < &gTasks[gTaskTableSize] && task->taskId != -1){
+		switchedIn = (int32_t)(task - gTasks);
+	}
+	// the MPU is only disabled by a full update, read the control register only then
+	bool isEnabled = gIsRegionUpdateRequired && memory_protection_isMPUEnabled();
+	if(switchIn(switchedIn) && isEnabled){
+		memory_protection_enableMPU();
 	}
 }
 
+stackguard_error_t stackguard_paintStack(uint32_t taskId){
+	if(!stackguard_acquireMutex()){
+		return STACKGUARD_MUTEX_ACQUIRE_FAILED;
+	}
+	int32_t task = findTask(taskId);
+	if(task != -1){
+		paintStack(&gTasks[task]);
+	}
+	stackguard_releaseMutex();
+	return task == -1 ? STACKGUARD_TASK_NOT_FOUND : STACKGUARD_NO_ERROR;
+}
+
+stackguard_error_t stackguard_getHighWatermark(uint32_t taskId, stackguard_stackUsage_t* usage){
+	if(!stackguard_acquireMutex()){
+		return STACKGUARD_MUTEX_ACQUIRE_FAILED;
+	}
+	stackguard_error_t error = STACKGUARD_NO_ERROR;
+	int32_t task = findTask(taskId);
+	if(task == -1){
+		error = STACKGUARD_TASK_NOT_FOUND;
+	} else if(!gTasks[task].isPainted){
+		error = STACKGUARD_STACK_NOT_PAINTED;
+	} else {
+		scanStack(&gTasks[task], usage);
+	}
+	stackguard_releaseMutex();
+	return error;
+}
+
+stackguard_error_t stackguard_getStackUsage(stackguard_stackUsage_t usage[], uint32_t size, uint32_t* count){
+	*count = 0;
+	if(!stackguard_acquireMutex()){
+		return STACKGUARD_MUTEX_ACQUIRE_FAILED;
+	}
+	for(uint32_t i = 0; i < gTaskTableSize && *count < size; i++){
+		if(gTasks[i].taskId != -1 && gTasks[i].isPainted){
+			scanStack(&gTasks[i], &usage[(*count)++]);
+		}
+	}
+	stackguard_releaseMutex();
+	return STACKGUARD_NO_ERROR;
+}
+
 stackguard_error_t stackguard_guard(){
 	return memory_protection_enableMPU() == NO_MPU_AVAILABLE ? STACKGUARD_NO_MPU_AVAILABLE : STACKGUARD_NO_ERROR;
 }
@@ -199,18 +456,181 @@ static bool isPowerOfTwo(uint32_t value) {
     return (value != 0) && ((value & (value - 1)) == 0);
 }
 
+static stackguard_error_t addTaskRegion(uint32_t taskId, const mpu_region_t stack[], uint32_t regionCount, uint32_t stackBase, uint32_t stackSize,
+		mpu_access_permission_t initialAP){
+	if(gNumberOfRegions < regionCount){
+		return STACKGUARD_NO_MPU_REGION_LEFT;
+	}
+	if(!stackguard_acquireMutex()){
+		return STACKGUARD_MUTEX_ACQUIRE_FAILED;
+	}
+	int32_t index = findFreeTask();
+	if(index == -1){
+		stackguard_releaseMutex();
+		return STACKGUARD_TASK_TABLE_FULL;
+	}
+	stackguard_task_t task;
+	mpu_region_t regions[STACKGUARD_MAX_REGIONS_PER_TASK];
+	task.taskId = taskId;
+	task.stackBase = stackBase;
+	task.stackSize = stackSize;
+	task.regionCount = regionCount;
+	for(uint32_t i = 0; i < regionCount; i++){
+		task.region[i] = -1;
+		regions[i] = stack[i];
+		// the region number is set when the task is mapped to a region
+		regions[i].number = 0;
+		regions[i].ap = STACKGUARD_DEFAULT_TASK_SWITCH_OUT_PERMISSION;
+		fillRegionDefaults(&regions[i]);
+		regions[i].xn = stack[i].xn;
+		regions[i].srd = stack[i].srd;
+
+		mpu_error_t error = memory_protection_encodeRegion(&regions[i], &task.switchedOut[i]);
+		switch (error){
+			case INVALID_REGION_ADDRESS:
+				stackguard_releaseMutex();
+				return STACKGUARD_INVALID_MPU_ADDRESS;
+			case INVALID_REGION_ADDRESS_ALIGNMENT:
+				stackguard_releaseMutex();
+				return STACKGUARD_INVALID_STACK_ALIGNMENT;
+			case INVALID_REGION_LIMIT:
+				stackguard_releaseMutex();
+				return STACKGUARD_MPU_INVALID_REGION_SIZE;
+			case INVALID_REGION_NUMBER:
+				stackguard_releaseMutex();
+				return STACKGUARD_INVALID_REGION_NUMBER;
+			default:
+				break;
+		}
+		regions[i].ap = MPU_REGION_ALL_ACCESS_ALLOWED;
+		memory_protection_encodeRegion(&regions[i], &task.switchedIn[i]);
+	}
+#if STACKGUARD_PAINT_STACK_ON_ADD == 1
+	// before the initial permission is applied
+	paintStack(&task);
+#else
+	task.isPainted = false;
+#endif
+	// the task switch hook remaps the regions and writes the MPU (also RNR) from the switch handler
+	util_enterCriticalSection();
+	gTasks[index] = task;
+
+	// unused regions guard the stack immediately with the initial permission until the first task switch
+	uint32_t part = 0;
+	for(uint32_t i = 0; i < gNumberOfRegions && part < regionCount; i++){
+		if(gRegions[i].task == -1){
+			gRegions[i].task = index;
+			gRegions[i].part = part;
+			gTasks[index].region[part] = i;
+			mpu_region_t initial = regions[part];
+			mpu_regionRegisters_t registers;
+			initial.ap = initialAP;
+			initial.number = i;
+			memory_protection_encodeRegion(&initial, &registers);
+			memory_protection_writeRegion(&registers);
+			part++;
+		}
+	}
+	gIsRegionUpdateRequired = true;
+	util_exitCriticalSection();
+	stackguard_releaseMutex();
+	return STACKGUARD_NO_ERROR;
+}
+
 static stackguard_error_t removeRegion(uint32_t taskId){
+	int32_t task = findTask(taskId);
+	if(task == -1){
+		return STACKGUARD_TASK_NOT_FOUND;
+	}
+	util_enterCriticalSection();
+	for(uint32_t i = 0; i < gTasks[task].regionCount; i++){
+		if(gTasks[task].region[i] != -1){
+			gRegions[gTasks[task].region[i]].task = -1;
+		}
+		gTasks[task].region[i] = -1;
+	}
+	if(gSwitchedInTask == task){
+		gSwitchedInTask = -1;
+	}
+	gTasks[task].taskId = -1;
+	gTasks[task].regionCount = 0;
+	gIsRegionUpdateRequired = true;
+	util_exitCriticalSection();
+	return STACKGUARD_NO_ERROR;
+}
+
+static void clearTaskTable(){
+	for(uint32_t i = 0; i < gTaskTableSize; i++){
+		gTasks[i].taskId = -1;
+		gTasks[i].regionCount = 0;
+		gTasks[i].isPainted = false;
+		for(uint32_t part = 0; part < STACKGUARD_MAX_REGIONS_PER_TASK; part++){
+			gTasks[i].region[part] = -1;
+		}
+	}
 	for(uint32_t i = 0; i < gNumberOfRegions; i++){
-		if (gTasksRegions[i].taskId == taskId) {
-			gTasksRegions[i].taskId = -1;
-			gTasksRegions[i].mpuRegion = createDefaultRegion(0);
-			if(i < gNextUnusedRegion){
-				gNextUnusedRegion = i;
-			}
-			return STACKGUARD_NO_ERROR;
+		gRegions[i].task = -1;
+	}
+}
+
+static int32_t findTask(uint32_t taskId){
+	for(uint32_t i = 0; i < gTaskTableSize; i++){
+		if(gTasks[i].taskId == taskId){
+			return (int32_t)i;
+		}
+	}
+	return -1;
+}
+
+static int32_t findFreeTask(){
+	for(uint32_t i = 0; i < gTaskTableSize; i++){
+		if(gTasks[i].taskId == -1){
+			return (int32_t)i;
 		}
 	}
-	return STACKGUARD_TASK_NOT_FOUND;
+	return -1;
+}
+
+static void mapTask(int32_t task){
+	for(uint32_t part = 0; part < gTasks[task].regionCount; part++){
+		if(gTasks[task].region[part] != -1){
+			continue;
+		}
+		uint32_t region = findRegionToMap(task);
+		if(gRegions[region].task != -1){
+			gTasks[gRegions[region].task].region[gRegions[region].part] = -1;
+		}
+		gRegions[region].task = task;
+		gRegions[region].part = part;
+		// marked as used, the other region of the task is not reassigned to its second part
+		gRegions[region].lastUse = gSwitchCount;
+		gTasks[task].region[part] = region;
+	}
+}
+
+static uint32_t findRegionToMap(int32_t task){
+	// an unused region or the region of the least recently switched in task, the regions of the task itself are kept
+	int32_t region = -1;
+	for(uint32_t i = 0; i < gNumberOfRegions; i++){
+		if(gRegions[i].task == -1){
+			return i;
+		}
+		if(gRegions[i].task != task && (region == -1 || gSwitchCount - gRegions[i].lastUse > gSwitchCount - gRegions[region].lastUse)){
+			region = i;
+		}
+	}
+	return region;
+}
+
+static mpu_regionRegisters_t getRegisters(uint32_t region, bool isSwitchedIn){
+	int32_t task = gRegions[region].task;
+	if(task == -1){
+		return gRegions[region].disabled;
+	}
+	uint32_t part = gRegions[region].part;
+	mpu_regionRegisters_t registers = isSwitchedIn ? gTasks[task].switchedIn[part] : gTasks[task].switchedOut[part];
+	memory_protection_setRegisterNumber(&registers, region);
+	return registers;
 }
 
 static void fillRegionDefaults(mpu_region_t* region){
@@ -221,6 +641,9 @@ static void fillRegionDefaults(mpu_region_t* region){
 	region->tex = MPU_DEFAULT_TEX;
 	region->xn = false;
 	region->srd = 0;
+#if SHEAPERD_ARMV8
+	region->attributeIndex = STACKGUARD_MPU_ATTRIBUTE_INDEX;
+#endif
 }
 
 static mpu_region_t createDefaultRegion(uint32_t number){
@@ -228,15 +651,73 @@ static mpu_region_t createDefaultRegion(uint32_t number){
 			.address = 0,
 			.number = number,
 			.size = REGIONSIZE_32B,
+#if SHEAPERD_ARMV8
+			.limit = 31,
+#endif
 			.ap = MPU_REGION_ALL_ACCESS_DENIED
 	};
 	fillRegionDefaults(&region);
 	return region;
 }
 
+static void paintStack(stackguard_task_t* task){
+	volatile uint32_t* stack = (volatile uint32_t*)task->stackBase;
+	uint32_t words = task->stackSize / sizeof(uint32_t);
+	for(uint32_t i = 0; i < words; i++){
+		stack[i] = STACKGUARD_STACK_PAINT_PATTERN;
+	}
+	task->freeWords = words;
+	task->isPainted = true;
+}
+
+static void scanStack(stackguard_task_t* task, stackguard_stackUsage_t* usage){
+	const volatile uint32_t* stack = (const volatile uint32_t*)task->stackBase;
+	// words below low are taken as unused, the word at high is used: a painted probe moves low behind the probe, a used word of the
+	// probe moves high to the used word. Probes next to high are moved down to keep their size, a shorter hole in the used stack below
+	// high is not taken as unused
+	uint32_t low = 0;
+	uint32_t high = task->freeWords;
+	while(low < high){
+		uint32_t probe = low + (high - low) / 2;
+		if(probe + STACKGUARD_WATERMARK_PROBE_WORDS > high){
+			probe = high > STACKGUARD_WATERMARK_PROBE_WORDS ? high - STACKGUARD_WATERMARK_PROBE_WORDS : 0;
+		}
+		uint32_t end = probe + STACKGUARD_WATERMARK_PROBE_WORDS < high ? probe + STACKGUARD_WATERMARK_PROBE_WORDS : high;
+		uint32_t i = probe;
+		while(i < end && stack[i] == STACKGUARD_STACK_PAINT_PATTERN){
+			i++;
+		}
+		if(i == end){
+			low = end;
+		} else {
+			high = i;
+		}
+	}
+	task->freeWords = high;
+	usage->taskId = task->taskId;
+	usage->size = task->stackSize;
+	usage->free = high * sizeof(uint32_t);
+	usage->used = task->stackSize - usage->free;
+}
+
+#if !SHEAPERD_ARMV8
+static uint32_t ceilLog2(uint32_t value){
+	return value <= 1 ? 0 : util_fls(value - 1) + 1;
+}
+
+static uint32_t alignUp(uint32_t value, uint32_t exp){
+	uint32_t mask = (1ul << exp) - 1;
+	return (value + mask) & ~mask;
+}
+#endif
+
 static bool stackguard_acquireMutex(){
 	#if SHEAPERD_NO_OS == 1
 		return true;
+	#elif SHEAPERD_USE_LOCK_PORT == 1
+        bool acquired = sheaperd_port_lockAcquire(&gStackLock, SHEAPERD_DEFAULT_MUTEX_WAIT_TICKS);
+        SHEAPERD_ASSERT("Mutex acquire failed.", acquired, SHEAPERD_ERROR_MUTEX_ACQUIRE_FAILED);
+        return acquired;
 	#else
         util_error_t error = util_acquireMutex(gStackMutex_id, SHEAPERD_DEFAULT_MUTEX_WAIT_TICKS);
         SHEAPERD_ASSERT("Mutex acquire failed.", error == ERROR_NO_ERROR, SHEAPERD_ERROR_MUTEX_ACQUIRE_FAILED);
@@ -247,6 +728,9 @@ static bool stackguard_acquireMutex(){
 static bool stackguard_releaseMutex(){
 	#if SHEAPERD_NO_OS == 1
 		return true;
+	#elif SHEAPERD_USE_LOCK_PORT == 1
+        sheaperd_port_lockRelease(&gStackLock);
+        return true;
     #else
         util_error_t error = util_releaseMutex(gStackMutex_id);
         SHEAPERD_ASSERT("Mutex release failed.", error == ERROR_NO_ERROR, SHEAPERD_ERROR_MUTEX_RELEASE_FAILED);
@@ -0,0 +1,235 @@
+/** @file sheap_snapshot_decode.c
+ *  @brief Host decoder of the sheap heap snapshot ('sheap_snapshot_step', see README.md).
+ *
+ *  Reads the words written to the snapshot sink, rebuilds the block addresses from the sizes and prints the heap map, a summary of
+ *  the free memory and the allocated bytes per call site (id). Block records before a repeated begin record (restart of the walk)
+ *  are discarded.
+ *
+ *  @author JK
+ *  @bug No known bugs.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* equal to the snapshot format of sheap.c */
+#define SNAPSHOT_MAGIC			0x504D4853u
+#define SNAPSHOT_VERSION		1u
+#define SNAPSHOT_HEADER_WORDS	6
+#define SNAPSHOT_INVALID_FLAG	0x40000000u
+#define SNAPSHOT_ALLOCATED_FLAG	0x80000000u
+#define SNAPSHOT_SIZE_MASK		0x3FFFFFFFu
+
+#define MAX_BLOCKS				65536
+#define MAX_CALL_SITES			1024
+
+typedef struct{
+	uint32_t	size;
+	uint32_t	id;
+	bool		isAllocated;
+	bool		isValid;
+} block_t;
+
+typedef struct{
+	uint32_t	id;
+	uint32_t	blocks;
+	uint64_t	bytes;
+} callSite_t;
+
+typedef struct{
+	uint32_t	metaSize;
+	uint32_t	headerSize;
+	uint32_t	heapStart;
+	uint32_t	heapSize;
+	uint32_t	generation;
+} snapshotHeader_t;
+
+static block_t gBlocks[MAX_BLOCKS];
+static uint32_t gBlockCount;
+static callSite_t gSites[MAX_CALL_SITES];
+static uint32_t gSiteCount;
+
+static snapshotHeader_t gHeader;
+static bool gHaveHeader;
+static uint32_t gRestarts;
+static uint32_t gDroppedBlocks;
+
+static bool readWord(FILE* in, uint32_t* word){
+	uint8_t p[4];
+	if(fread(p, 1, 4, in) != 4){
+		return false;
+	}
+	*word = (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+	return true;
+}
+
+static callSite_t* findSite(uint32_t id){
+	for(uint32_t i = 0; i < gSiteCount; i++){
+		if(gSites[i].id == id){
+			return &gSites[i];
+		}
+	}
+	if(gSiteCount == MAX_CALL_SITES){
+		// all further ids are accounted to the last entry
+		return &gSites[MAX_CALL_SITES - 1];
+	}
+	gSites[gSiteCount].id = id;
+	return &gSites[gSiteCount++];
+}
+
+static int compareBytes(const void* a, const void* b){
+	const callSite_t* siteA = a;
+	const callSite_t* siteB = b;
+	return siteA->bytes > siteB->bytes ? -1 : siteA->bytes < siteB->bytes;
+}
+
+static void printReport(bool printMap, uint32_t endCount){
+	printf("heap 0x%08x size %u, generation %u, restarts %u, blocks %u", gHeader.heapStart, gHeader.heapSize, gHeader.generation,
+			gRestarts, gBlockCount);
+	if(endCount != gBlockCount){
+		printf(" (end record: %u)", endCount);
+	}
+	printf("\n");
+	if(gDroppedBlocks > 0){
+		printf("%u blocks did not fit into the map\n", gDroppedBlocks);
+	}
+
+	uint64_t allocatedBytes = 0;
+	uint64_t freeBytes = 0;
+	uint32_t largestFree = 0;
+	uint32_t freeBlocks = 0;
+	uint32_t invalidBlocks = 0;
+	uint32_t address = gHeader.heapStart;
+	if(printMap){
+		printf("\n%-10s %-10s %10s %-5s %-10s\n", "block", "payload", "size", "state", "id");
+	}
+	for(uint32_t i = 0; i < gBlockCount; i++){
+		block_t* block = &gBlocks[i];
+		if(printMap){
+			printf("0x%08x 0x%08x %10u %-5s 0x%08x%s\n", address, address + gHeader.headerSize, block->size,
+					block->isAllocated ? "used" : "free", block->id, block->isValid ? "" : " INVALID");
+		}
+		if(!block->isValid){
+			invalidBlocks++;
+		}
+		if(block->isAllocated){
+			allocatedBytes += block->size;
+			callSite_t* site = findSite(block->id);
+			site->blocks++;
+			site->bytes += block->size;
+		} else {
+			freeBytes += block->size;
+			freeBlocks++;
+			if(block->size > largestFree){
+				largestFree = block->size;
+			}
+		}
+		address += gHeader.metaSize + block->size;
+	}
+
+	printf("\nallocated %llu bytes in %u blocks, free %llu bytes in %u blocks, largest free block %u, fragmentation %.1f%%\n",
+			(unsigned long long)allocatedBytes, gBlockCount - freeBlocks, (unsigned long long)freeBytes, freeBlocks, largestFree,
+			freeBytes == 0 ? 0.0 : 100.0 * (1.0 - (double)largestFree / (double)freeBytes));
+	if(invalidBlocks > 0){
+		printf("%u invalid blocks, the blocks after an invalid header are missing\n", invalidBlocks);
+	}
+
+	qsort(gSites, gSiteCount, sizeof(callSite_t), compareBytes);
+	printf("\ncall sites: %u\n%-10s %8s %12s\n", gSiteCount, "id", "blocks", "bytes");
+	for(uint32_t i = 0; i < gSiteCount; i++){
+		printf("0x%08x %8u %12llu\n", gSites[i].id, gSites[i].blocks, (unsigned long long)gSites[i].bytes);
+	}
+}
+
+static void usage(const char* name){
+	fprintf(stderr, "usage: %s [-s] snapshot.bin\n"
+			"  -s        print the summary only (no heap map)\n", name);
+}
+
+int main(int argc, char* argv[]){
+	bool printMap = true;
+	const char* input = NULL;
+	for(int i = 1; i < argc; i++){
+		if(strcmp(argv[i], "-s") == 0){
+			printMap = false;
+		} else if(input == NULL && argv[i][0] != '-'){
+			input = argv[i];
+		} else {
+			usage(argv[0]);
+			return 1;
+		}
+	}
+	if(input == NULL){
+		usage(argv[0]);
+		return 1;
+	}
+	FILE* in = fopen(input, "rb");
+	if(in == NULL){
+		perror(input);
+		return 1;
+	}
+	uint32_t word;
+	while(readWord(in, &word)){
+		if(word == SNAPSHOT_MAGIC){
+			uint32_t header[SNAPSHOT_HEADER_WORDS - 1];
+			for(uint32_t i = 0; i < SNAPSHOT_HEADER_WORDS - 1; i++){
+				if(!readWord(in, &header[i])){
+					fprintf(stderr, "incomplete begin record\n");
+					fclose(in);
+					return 1;
+				}
+			}
+			if((header[0] >> 16) != SNAPSHOT_VERSION){
+				fprintf(stderr, "unsupported snapshot version %u\n", header[0] >> 16);
+				fclose(in);
+				return 1;
+			}
+			if(gHaveHeader){
+				// the walk restarted, the heap was modified
+				gRestarts++;
+			}
+			gHeader.metaSize = header[0] & 0xFFFFu;
+			gHeader.headerSize = header[1];
+			gHeader.heapStart = header[2];
+			gHeader.heapSize = header[3];
+			gHeader.generation = header[4];
+			gHaveHeader = true;
+			gBlockCount = 0;
+			gDroppedBlocks = 0;
+			continue;
+		}
+		uint32_t id;
+		if(!readWord(in, &id)){
+			break;
+		}
+		if(!gHaveHeader){
+			// records of a snapshot whose begin record is missing
+			continue;
+		}
+		if(word == 0){
+			fclose(in);
+			printReport(printMap, id);
+			return 0;
+		}
+		if(gBlockCount == MAX_BLOCKS){
+			gDroppedBlocks++;
+			continue;
+		}
+		block_t* block = &gBlocks[gBlockCount++];
+		block->size = word & SNAPSHOT_SIZE_MASK;
+		block->id = id;
+		block->isAllocated = (word & SNAPSHOT_ALLOCATED_FLAG) != 0;
+		block->isValid = (word & SNAPSHOT_INVALID_FLAG) == 0;
+	}
+	fclose(in);
+	if(!gHaveHeader){
+		fprintf(stderr, "no begin record found\n");
+		return 1;
+	}
+	fprintf(stderr, "no end record, the snapshot is incomplete\n");
+	printReport(printMap, gBlockCount);
+	return 0;
+}
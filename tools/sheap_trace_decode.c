@@ -0,0 +1,364 @@
+/** @file sheap_trace_decode.c
+ *  @brief Host decoder of the sheap allocation trace (SHEAPERD_SHEAP_TRACE, see README.md).
+ *
+ *  Reads the events written by 'sheap_trace_drain', either as raw event words (output of a sink) or as SWO capture with ITM
+ *  packets of the trace stimulus port. The allocations are replayed into a map of the live blocks, which is printed at the end
+ *  together with the usage per call site (id). The events can be converted into a trace of the host benchmark (bench/).
+ *
+ *  @author JK
+ *  @bug No known bugs.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* equal to sheap_traceEvent_t / sheap_traceOp_t of sheap.h */
+#define TRACE_MAGIC				0xA5
+#define TRACE_EVENT_SIZE		20
+
+#define TRACE_MALLOC			1
+#define TRACE_CALLOC			2
+#define TRACE_MEMALIGN			3
+#define TRACE_REALLOC			4
+#define TRACE_FREE				5
+
+#define MAX_LIVE_BLOCKS			65536
+#define MAX_CALL_SITES			1024
+#define REPLAY_SLOTS			4096
+
+typedef struct{
+	uint8_t		op;
+	uint16_t	sequence;
+	uint32_t	id;
+	uint32_t	size;
+	uint32_t	address;
+	uint32_t	timestamp;
+} event_t;
+
+typedef struct{
+	uint32_t	address;
+	uint32_t	size;
+	uint32_t	id;
+	uint16_t	slot;
+	bool		used;
+} liveBlock_t;
+
+typedef struct{
+	uint32_t	id;
+	uint32_t	allocations;
+	uint32_t	frees;
+	uint32_t	failed;
+	uint32_t	liveBlocks;
+	uint64_t	liveBytes;
+	uint64_t	peakLiveBytes;
+	uint64_t	totalBytes;
+} callSite_t;
+
+static const char* gOpNames[] = { "?", "malloc", "calloc", "memalign", "realloc", "free" };
+
+static liveBlock_t gLive[MAX_LIVE_BLOCKS];
+static uint32_t gLiveCount;
+static callSite_t gSites[MAX_CALL_SITES];
+static uint32_t gSiteCount;
+
+static bool gSlotUsed[REPLAY_SLOTS];
+static FILE* gReplay;
+static bool gVerbose;
+
+static uint32_t gEvents;
+static uint32_t gLostEvents;
+static uint32_t gSkippedBytes;
+static uint32_t gUnknownFrees;
+static uint32_t gMapOverflows;
+static bool gHaveSequence;
+static uint16_t gNextSequence;
+
+static uint8_t gPending[TRACE_EVENT_SIZE];
+static uint32_t gPendingCount;
+
+static uint32_t readWord(const uint8_t* p){
+	return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static liveBlock_t* findLive(uint32_t address, bool insert){
+	// open addressing, the payloads are at least 8 byte aligned
+	uint32_t index = (address >> 3) * 2654435761u % MAX_LIVE_BLOCKS;
+	liveBlock_t* released = NULL;
+	for(uint32_t i = 0; i < MAX_LIVE_BLOCKS; i++){
+		liveBlock_t* block = &gLive[(index + i) % MAX_LIVE_BLOCKS];
+		if(block->used && block->address == address){
+			return block;
+		}
+		if(!block->used && block->address == 0){
+			// never used entry, the address is not in the map
+			return !insert ? NULL : (released != NULL ? released : block);
+		}
+		if(!block->used && released == NULL){
+			released = block;
+		}
+	}
+	return insert ? released : NULL;
+}
+
+static callSite_t* findSite(uint32_t id){
+	for(uint32_t i = 0; i < gSiteCount; i++){
+		if(gSites[i].id == id){
+			return &gSites[i];
+		}
+	}
+	if(gSiteCount == MAX_CALL_SITES){
+		// all further ids are accounted to the last entry
+		return &gSites[MAX_CALL_SITES - 1];
+	}
+	gSites[gSiteCount].id = id;
+	return &gSites[gSiteCount++];
+}
+
+static int32_t claimSlot(){
+	for(int32_t slot = 0; slot < REPLAY_SLOTS; slot++){
+		if(!gSlotUsed[slot]){
+			gSlotUsed[slot] = true;
+			return slot;
+		}
+	}
+	return -1;
+}
+
+static void traceAllocation(const event_t* event){
+	callSite_t* site = findSite(event->id);
+	if(event->address == 0){
+		site->failed++;
+		return;
+	}
+	liveBlock_t* block = findLive(event->address, true);
+	if(block == NULL){
+		gMapOverflows++;
+		return;
+	}
+	if(block->used){
+		// the free of the previous block at this address was lost
+		callSite_t* owner = findSite(block->id);
+		owner->liveBlocks--;
+		owner->liveBytes -= block->size;
+		gLiveCount--;
+		if(gReplay != NULL){
+			fprintf(gReplay, "f %u\n", block->slot);
+			gSlotUsed[block->slot] = false;
+		}
+	}
+	block->address = event->address;
+	block->size = event->size;
+	block->id = event->id;
+	block->used = true;
+	gLiveCount++;
+	site->allocations++;
+	site->liveBlocks++;
+	site->liveBytes += event->size;
+	site->totalBytes += event->size;
+	if(site->liveBytes > site->peakLiveBytes){
+		site->peakLiveBytes = site->liveBytes;
+	}
+	if(gReplay != NULL){
+		int32_t slot = claimSlot();
+		if(slot < 0){
+			fprintf(stderr, "more than %d live blocks, the replay trace is incomplete\n", REPLAY_SLOTS);
+			fclose(gReplay);
+			gReplay = NULL;
+			return;
+		}
+		block->slot = (uint16_t)slot;
+		fprintf(gReplay, "a %d %u\n", slot, event->size);
+	}
+}
+
+static void traceFree(const event_t* event){
+	findSite(event->id)->frees++;
+	liveBlock_t* block = event->address != 0 ? findLive(event->address, false) : NULL;
+	if(block == NULL){
+		gUnknownFrees++;
+		return;
+	}
+	callSite_t* owner = findSite(block->id);
+	owner->liveBlocks--;
+	owner->liveBytes -= block->size;
+	block->used = false;
+	gLiveCount--;
+	if(gReplay != NULL){
+		fprintf(gReplay, "f %u\n", block->slot);
+		gSlotUsed[block->slot] = false;
+	}
+}
+
+static void processEvent(const event_t* event){
+	gEvents++;
+	if(gHaveSequence && event->sequence != gNextSequence){
+		gLostEvents += (uint16_t)(event->sequence - gNextSequence);
+	}
+	gHaveSequence = true;
+	gNextSequence = event->sequence + 1;
+	if(gVerbose){
+		printf("%5u %10u %-8s id 0x%08x size %8u address 0x%08x\n", event->sequence, event->timestamp, gOpNames[event->op],
+				event->id, event->size, event->address);
+	}
+	if(event->op == TRACE_FREE){
+		traceFree(event);
+	} else {
+		traceAllocation(event);
+	}
+}
+
+static void addEventByte(uint8_t byte){
+	gPending[gPendingCount++] = byte;
+	while(gPendingCount > 0){
+		if(gPending[0] != TRACE_MAGIC || (gPendingCount > 1 && (gPending[1] < TRACE_MALLOC || gPending[1] > TRACE_FREE))){
+			// not the start of an event, resynchronize at the next byte
+			memmove(gPending, gPending + 1, --gPendingCount);
+			gSkippedBytes++;
+			continue;
+		}
+		if(gPendingCount < TRACE_EVENT_SIZE){
+			return;
+		}
+		event_t event;
+		event.op = gPending[1];
+		event.sequence = (uint16_t)(gPending[2] | (gPending[3] << 8));
+		event.id = readWord(gPending + 4);
+		event.size = readWord(gPending + 8);
+		event.address = readWord(gPending + 12);
+		event.timestamp = readWord(gPending + 16);
+		gPendingCount = 0;
+		processEvent(&event);
+	}
+}
+
+static void decodeItm(FILE* in, uint32_t port){
+	int header;
+	while((header = fgetc(in)) != EOF){
+		if((header & 0x03) != 0){
+			// source packet, 1, 2 or 4 payload bytes
+			uint32_t size = (header & 0x03) == 3 ? 4 : (uint32_t)(header & 0x03);
+			bool stimulus = (header & 0x04) == 0 && (uint32_t)(header >> 3) == port;
+			for(uint32_t i = 0; i < size; i++){
+				int byte = fgetc(in);
+				if(byte == EOF){
+					return;
+				}
+				if(stimulus){
+					addEventByte((uint8_t)byte);
+				}
+			}
+		} else if(header != 0x00 && header != 0x70 && header != 0x80 && (header & 0x80) != 0){
+			// timestamp or extension packet, continued while bit 7 is set (sync, overflow: no payload)
+			int byte;
+			do{
+				byte = fgetc(in);
+			}while(byte != EOF && (byte & 0x80) != 0);
+		}
+	}
+}
+
+static void decodeRaw(FILE* in){
+	int byte;
+	while((byte = fgetc(in)) != EOF){
+		addEventByte((uint8_t)byte);
+	}
+}
+
+static int compareAddress(const void* a, const void* b){
+	const liveBlock_t* blockA = a;
+	const liveBlock_t* blockB = b;
+	return blockA->address < blockB->address ? -1 : blockA->address > blockB->address;
+}
+
+static int compareLiveBytes(const void* a, const void* b){
+	const callSite_t* siteA = a;
+	const callSite_t* siteB = b;
+	return siteA->liveBytes > siteB->liveBytes ? -1 : siteA->liveBytes < siteB->liveBytes;
+}
+
+static void printReport(){
+	printf("events %u, lost %u, skipped bytes %u, frees of unknown blocks %u\n", gEvents, gLostEvents, gSkippedBytes, gUnknownFrees);
+	if(gMapOverflows > 0){
+		printf("%u allocations did not fit into the map\n", gMapOverflows);
+	}
+	if(gLostEvents > 0){
+		printf("events were lost, the heap map may be incomplete\n");
+	}
+
+	liveBlock_t* live = malloc(sizeof(liveBlock_t) * (gLiveCount + 1));
+	uint32_t count = 0;
+	for(uint32_t i = 0; i < MAX_LIVE_BLOCKS && live != NULL; i++){
+		if(gLive[i].used){
+			live[count++] = gLive[i];
+		}
+	}
+	qsort(live, count, sizeof(liveBlock_t), compareAddress);
+	printf("\nlive blocks: %u\n%-10s %10s %10s\n", count, "address", "size", "id");
+	for(uint32_t i = 0; i < count; i++){
+		printf("0x%08x %10u 0x%08x\n", live[i].address, live[i].size, live[i].id);
+	}
+	free(live);
+
+	qsort(gSites, gSiteCount, sizeof(callSite_t), compareLiveBytes);
+	printf("\ncall sites: %u\n%-10s %8s %8s %8s %8s %10s %10s %12s\n", gSiteCount, "id", "allocs", "frees", "failed", "live",
+			"live bytes", "peak bytes", "total bytes");
+	for(uint32_t i = 0; i < gSiteCount; i++){
+		callSite_t* site = &gSites[i];
+		printf("0x%08x %8u %8u %8u %8u %10llu %10llu %12llu\n", site->id, site->allocations, site->frees, site->failed,
+				site->liveBlocks, (unsigned long long)site->liveBytes, (unsigned long long)site->peakLiveBytes,
+				(unsigned long long)site->totalBytes);
+	}
+}
+
+static void usage(const char* name){
+	fprintf(stderr, "usage: %s [-i port] [-v] [-r replay.txt] trace.bin\n"
+			"  -i port   input is a SWO capture, the events are taken from the ITM stimulus port\n"
+			"  -v        print each event\n"
+			"  -r file   write the allocations as trace of the host benchmark (bench/sheap_bench)\n", name);
+}
+
+int main(int argc, char* argv[]){
+	int32_t itmPort = -1;
+	const char* input = NULL;
+	for(int i = 1; i < argc; i++){
+		if(strcmp(argv[i], "-i") == 0 && i + 1 < argc){
+			itmPort = atoi(argv[++i]);
+		} else if(strcmp(argv[i], "-v") == 0){
+			gVerbose = true;
+		} else if(strcmp(argv[i], "-r") == 0 && i + 1 < argc){
+			gReplay = fopen(argv[++i], "w");
+			if(gReplay == NULL){
+				perror(argv[i]);
+				return 1;
+			}
+		} else if(input == NULL && argv[i][0] != '-'){
+			input = argv[i];
+		} else {
+			usage(argv[0]);
+			return 1;
+		}
+	}
+	if(input == NULL || itmPort > 31){
+		usage(argv[0]);
+		return 1;
+	}
+	FILE* in = fopen(input, "rb");
+	if(in == NULL){
+		perror(input);
+		return 1;
+	}
+	if(itmPort >= 0){
+		decodeItm(in, (uint32_t)itmPort);
+	} else {
+		decodeRaw(in);
+	}
+	fclose(in);
+	if(gReplay != NULL){
+		fclose(gReplay);
+	}
+	printReport();
+	return 0;
+}